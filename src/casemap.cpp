@@ -0,0 +1,203 @@
+// casemap.cpp
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include "casemap.h"
+
+
+using namespace stenosys;
+
+namespace stenosys
+{
+
+#define ONES      0x0101010101010101ULL
+#define HIGH_BITS 0x8080808080808080ULL
+
+// Upper case ranges and the offset to their lower case equivalents. Each range maps onto a
+// range of the same encoded length.
+const C_case_map::S_case_range C_case_map::case_ranges[] =
+{
+    { 0x00c0, 0x00d6,   32, 1 },    // Latin-1: À-Ö
+    { 0x00d8, 0x00de,   32, 1 },    //          Ø-Þ
+    { 0x0100, 0x012f,    1, 2 },    // Latin Extended-A: Ā-į
+    { 0x0132, 0x0137,    1, 2 },    //                   Ĳ-ķ
+    { 0x0139, 0x0148,    1, 2 },    //                   Ĺ-ň
+    { 0x014a, 0x0177,    1, 2 },    //                   Ŋ-ŷ
+    { 0x0178, 0x0178, -121, 1 },    //                   Ÿ -> ÿ
+    { 0x0179, 0x017e,    1, 2 },    //                   Ź-ž
+    { 0x01cd, 0x01dc,    1, 2 },    // Latin Extended-B: Ǎ-ǜ
+    { 0x01de, 0x01ef,    1, 2 },    //                   Ǟ-ǯ
+    { 0x01f8, 0x021f,    1, 2 },    //                   Ǹ-ȟ
+    { 0x0222, 0x0233,    1, 2 },    //                   Ȣ-ȳ
+    { 0x0246, 0x024f,    1, 2 },    //                   Ɇ-ɏ
+    { 0x0386, 0x0386,   38, 1 },    // Greek: Ά
+    { 0x0388, 0x038a,   37, 1 },    //        Έ-Ί
+    { 0x038c, 0x038c,   64, 1 },    //        Ό
+    { 0x038e, 0x038f,   63, 1 },    //        Ύ-Ώ
+    { 0x0391, 0x03a1,   32, 1 },    //        Α-Ρ
+    { 0x03a3, 0x03ab,   32, 1 },    //        Σ-Ϋ
+    { 0x03d8, 0x03ef,    1, 2 },    //        Ϙ-ϯ
+    { 0x0400, 0x040f,   80, 1 },    // Cyrillic: Ѐ-Џ
+    { 0x0410, 0x042f,   32, 1 },    //           А-Я
+    { 0x0460, 0x0481,    1, 2 },    //           Ѡ-ҁ
+    { 0x048a, 0x04bf,    1, 2 },    //           Ҋ-ҿ
+    { 0x04c0, 0x04c0,   15, 1 },    //           Ӏ
+    { 0x04c1, 0x04ce,    1, 2 },    //           Ӂ-ӎ
+    { 0x04d0, 0x04ff,    1, 2 },    //           Ӑ-ӿ
+    { 0x0500, 0x052f,    1, 2 },    //           Ԁ-ԯ
+    { 0x0531, 0x0556,   48, 1 },    // Armenian: Ա-Ֆ
+    { 0x1e00, 0x1e95,    1, 2 },    // Latin Extended Additional: Ḁ-ẕ
+    { 0x1ea0, 0x1eff,    1, 2 },    //                            Ạ-ỿ
+    { 0, 0, 0, 0 }
+};
+
+void
+C_case_map::upper( std::string & text, size_t begin, size_t end )
+{
+    convert( text, begin, end, true, false );
+}
+
+void
+C_case_map::lower( std::string & text, size_t begin, size_t end )
+{
+    convert( text, begin, end, false, false );
+}
+
+// Convert the first character only
+void
+C_case_map::upper_first( std::string & text, size_t begin )
+{
+    convert( text, begin, text.length(), true, true );
+}
+
+void
+C_case_map::lower_first( std::string & text, size_t begin )
+{
+    convert( text, begin, text.length(), false, true );
+}
+
+void
+C_case_map::convert( std::string & text, size_t begin, size_t end, bool upper, bool first_only )
+{
+    if ( end > text.length() )
+    {
+        end = text.length();
+    }
+
+    char * data = &text[ 0 ];
+
+    // Bytes from the first letter to be converted: 'a' or 'A'. Adding 0x80 - first sets
+    // the top bit of each byte at or above it; adding 0x80 - ( last + 1 ) sets it for those
+    // past the end of the alphabet.
+    uint64_t from_first = ONES * ( 0x80 - ( upper ? 'a' : 'A' ) );
+    uint64_t from_last  = ONES * ( 0x80 - ( upper ? 'z' : 'Z' ) - 1 );
+
+    size_t ii = begin;
+
+    while ( ii < end )
+    {
+        // Eight ASCII bytes at a time
+        if ( ( ! first_only ) && ( ( end - ii ) >= 8 ) )
+        {
+            uint64_t word;
+
+            memcpy( &word, data + ii, sizeof( word ) );
+
+            if ( ( word & HIGH_BITS ) == 0 )
+            {
+                uint64_t letters = ( ( word + from_first ) ^ ( word + from_last ) ) & HIGH_BITS;
+
+                // Flip the 0x20 bit of each letter
+                word ^= letters >> 2;
+
+                memcpy( data + ii, &word, sizeof( word ) );
+
+                ii += sizeof( word );
+                continue;
+            }
+        }
+
+        uint8_t byte = ( uint8_t ) data[ ii ];
+
+        if ( byte < 0x80 )
+        {
+            if ( upper && ( byte >= 'a' ) && ( byte <= 'z' ) )
+            {
+                data[ ii ] = byte - 0x20;
+            }
+            else if ( ( ! upper ) && ( byte >= 'A' ) && ( byte <= 'Z' ) )
+            {
+                data[ ii ] = byte + 0x20;
+            }
+
+            ii++;
+        }
+        else if ( ( byte >= 0xc2 ) && ( byte <= 0xdf ) && ( ( end - ii ) >= 2 )
+                                   && ( ( data[ ii + 1 ] & 0xc0 ) == 0x80 ) )
+        {
+            uint32_t code   = ( ( byte & 0x1f ) << 6 ) | ( data[ ii + 1 ] & 0x3f );
+            uint32_t mapped = map( code, upper );
+
+            data[ ii ]     = ( char ) ( 0xc0 | ( mapped >> 6 ) );
+            data[ ii + 1 ] = ( char ) ( 0x80 | ( mapped & 0x3f ) );
+
+            ii += 2;
+        }
+        else if ( ( byte >= 0xe0 ) && ( byte <= 0xef ) && ( ( end - ii ) >= 3 )
+                                   && ( ( data[ ii + 1 ] & 0xc0 ) == 0x80 )
+                                   && ( ( data[ ii + 2 ] & 0xc0 ) == 0x80 ) )
+        {
+            uint32_t code   = ( ( byte & 0x0f ) << 12 ) | ( ( data[ ii + 1 ] & 0x3f ) << 6 ) | ( data[ ii + 2 ] & 0x3f );
+            uint32_t mapped = map( code, upper );
+
+            data[ ii ]     = ( char ) ( 0xe0 | ( mapped >> 12 ) );
+            data[ ii + 1 ] = ( char ) ( 0x80 | ( ( mapped >> 6 ) & 0x3f ) );
+            data[ ii + 2 ] = ( char ) ( 0x80 | ( mapped & 0x3f ) );
+
+            ii += 3;
+        }
+        else
+        {
+            // Four-byte characters (e.g. Shavian, which has no case), and invalid UTF-8
+            ii++;
+
+            while ( ( ii < end ) && ( ( data[ ii ] & 0xc0 ) == 0x80 ) )
+            {
+                ii++;
+            }
+        }
+
+        if ( first_only )
+        {
+            break;
+        }
+    }
+}
+
+uint32_t
+C_case_map::map( uint32_t code, bool upper )
+{
+    if ( code < 0xc0 )
+    {
+        return code;
+    }
+
+    for ( const S_case_range * range = &case_ranges[ 0 ]; range->step != 0; range++ )
+    {
+        // Upper case ranges are searched when lowering, lower case ones when raising
+        int32_t  delta = upper ? range->delta : 0;
+        uint32_t first = range->first + delta;
+        uint32_t last  = range->last + delta;
+
+        if ( ( code >= first ) && ( code <= last ) && ( ( ( code - first ) % range->step ) == 0 ) )
+        {
+            return upper ? ( code - range->delta ) : ( code + range->delta );
+        }
+    }
+
+    return code;
+}
+
+}
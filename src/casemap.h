@@ -0,0 +1,50 @@
+// casemap.h
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace stenosys
+{
+
+// In-place case conversion of UTF-8 text. Runs of ASCII are converted eight bytes at a
+// time; other characters are mapped through a table of case ranges covering the Latin,
+// Greek, Cyrillic and Armenian alphabets. Only mappings which keep the encoded length are
+// made (so e.g. 'ß' is not expanded to "SS"), so the text never moves or reallocates.
+class C_case_map
+{
+
+public:
+
+    static void
+    upper( std::string & text, size_t begin, size_t end );
+
+    static void
+    lower( std::string & text, size_t begin, size_t end );
+
+    static void
+    upper_first( std::string & text, size_t begin );
+
+    static void
+    lower_first( std::string & text, size_t begin );
+
+private:
+
+    typedef struct
+    {
+        uint16_t first;             // First upper case character in the range
+        uint16_t last;
+        int16_t  delta;             // Offset of the lower case character
+        uint16_t step;              // 1: every character in the range; 2: every other one
+    } S_case_range;
+
+    static void
+    convert( std::string & text, size_t begin, size_t end, bool upper, bool first_only );
+
+    static uint32_t
+    map( uint32_t code, bool upper );
+
+    static const S_case_range case_ranges[];
+};
+
+}
@@ -0,0 +1,90 @@
+// chord.cpp
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include "chord.h"
+
+
+using namespace stenosys;
+
+namespace stenosys
+{
+
+#define FRAGMENT_MAX 10             // Longest fragment: all ten right-hand keys
+
+// The steno for one bank of keys
+typedef struct
+{
+    char    text[ FRAGMENT_MAX ];
+    uint8_t length;
+} S_chord_fragment;
+
+// The steno for each combination of the keys in a bank, in steno order. The banks are
+// # and the left-hand consonants (8 keys), the vowels and star (5), and the right-hand
+// consonants (10).
+template < int N >
+static constexpr std::array< S_chord_fragment, N >
+build_fragments( int first_key )
+{
+    std::array< S_chord_fragment, N > fragments {};
+
+    for ( int keys = 0; keys < N; keys++ )
+    {
+        S_chord_fragment & fragment = fragments[ keys ];
+
+        for ( int key = 0; ( 1 << key ) < N; key++ )
+        {
+            if ( keys & ( 1 << key ) )
+            {
+                fragment.text[ fragment.length++ ] = STENO_ORDER[ first_key + key ];
+            }
+        }
+    }
+
+    return fragments;
+}
+
+static constexpr std::array< S_chord_fragment, 1 << KEY_INDEX_VOWELS > left_fragments
+    = build_fragments< 1 << KEY_INDEX_VOWELS >( 0 );
+
+static constexpr std::array< S_chord_fragment, 1 << ( KEY_INDEX_RIGHT - KEY_INDEX_VOWELS ) > vowel_fragments
+    = build_fragments< 1 << ( KEY_INDEX_RIGHT - KEY_INDEX_VOWELS ) >( KEY_INDEX_VOWELS );
+
+static constexpr std::array< S_chord_fragment, 1 << FRAGMENT_MAX > right_fragments
+    = build_fragments< 1 << FRAGMENT_MAX >( KEY_INDEX_RIGHT );
+
+// Convert a chord to steno, e.g. "STKPWHR-FR". A hyphen separates the banks when there is
+// no vowel or star.
+std::string
+chord_steno( chord_type chord )
+{
+    const S_chord_fragment & left   = left_fragments[ chord & ( left_fragments.size() - 1 ) ];
+    const S_chord_fragment & vowels = vowel_fragments[ ( chord >> KEY_INDEX_VOWELS ) & ( vowel_fragments.size() - 1 ) ];
+    const S_chord_fragment & right  = right_fragments[ ( chord >> KEY_INDEX_RIGHT ) & ( right_fragments.size() - 1 ) ];
+
+    char   steno[ 2 * FRAGMENT_MAX + 4 ];
+    size_t length = 0;
+
+    memcpy( steno, left.text, left.length );
+    length += left.length;
+
+    if ( vowels.length > 0 )
+    {
+        memcpy( steno + length, vowels.text, vowels.length );
+        length += vowels.length;
+    }
+    else if ( right.length > 0 )
+    {
+        steno[ length++ ] = '-';
+    }
+
+    memcpy( steno + length, right.text, right.length );
+    length += right.length;
+
+    return std::string( steno, length );
+}
+
+}
@@ -0,0 +1,113 @@
+// chord.h
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace stenosys
+{
+
+// A steno chord as a bit mask, one bit per key in steno order
+typedef uint32_t chord_type;
+
+#define STENO_ORDER "#STKPWHRAO*EUFRPBLGTSDZ"
+
+// The vowels are named in full, as linux/input.h has macros KEY_A, KEY_O, etc.
+const chord_type KEY_NUM     = 1 << 0;
+const chord_type KEY_S_      = 1 << 1;
+const chord_type KEY_T_      = 1 << 2;
+const chord_type KEY_K_      = 1 << 3;
+const chord_type KEY_P_      = 1 << 4;
+const chord_type KEY_W_      = 1 << 5;
+const chord_type KEY_H_      = 1 << 6;
+const chord_type KEY_R_      = 1 << 7;
+const chord_type KEY_VOWEL_A = 1 << 8;
+const chord_type KEY_VOWEL_O = 1 << 9;
+const chord_type KEY_STAR    = 1 << 10;
+const chord_type KEY_VOWEL_E = 1 << 11;
+const chord_type KEY_VOWEL_U = 1 << 12;
+const chord_type KEY__F      = 1 << 13;
+const chord_type KEY__R      = 1 << 14;
+const chord_type KEY__P      = 1 << 15;
+const chord_type KEY__B      = 1 << 16;
+const chord_type KEY__L      = 1 << 17;
+const chord_type KEY__G      = 1 << 18;
+const chord_type KEY__T      = 1 << 19;
+const chord_type KEY__S      = 1 << 20;
+const chord_type KEY__D      = 1 << 21;
+const chord_type KEY__Z      = 1 << 22;
+
+const int KEY_COUNT        = 23;
+const int KEY_INDEX_VOWELS = 8;     // Bit of the first vowel key, A
+const int KEY_INDEX_RIGHT  = 13;    // Bit of the first right-hand key, -F
+
+// Chord bit of a key, numbering the keys in steno order with the number bar last (S- is
+// 0, # is 22), as TX Bolt and Plover HID machines send them
+constexpr chord_type
+chord_key_number_last( int index )
+{
+    return ( index < KEY_COUNT - 1 ) ? ( chord_type ) 1 << ( index + 1 )
+         : ( index == KEY_COUNT - 1 ) ? KEY_NUM
+         :                              0;
+}
+
+// Convert steno (e.g. "SKWH-FR", "#-6DZ") to a chord. Keys must be in steno order, with a
+// hyphen separating the banks where there is no vowel or star; digits stand for their
+// number key. Fails on anything else.
+constexpr bool
+chord_parse( const char * steno, chord_type & chord )
+{
+    // Bits of the keys for the digits 0 to 9: O, S-, T-, P-, H-, A, -F, -P, -L, -T
+    const int number_keys[] = { 9, 1, 2, 4, 6, 8, 13, 15, 17, 19 };
+
+    const char * order = STENO_ORDER;
+
+    int position = 0;
+
+    chord = 0;
+
+    for ( ; *steno != '\0'; steno++ )
+    {
+        char ch = *steno;
+        int  key = position;
+
+        if ( ch == '-' )
+        {
+            position = ( position > KEY_INDEX_RIGHT ) ? position : KEY_INDEX_RIGHT;
+            continue;
+        }
+
+        if ( ( ch >= '0' ) && ( ch <= '9' ) )
+        {
+            key    = number_keys[ ch - '0' ];
+            chord |= KEY_NUM;
+
+            if ( key < position )
+            {
+                return false;
+            }
+        }
+        else
+        {
+            while ( ( order[ key ] != '\0' ) && ( order[ key ] != ch ) )
+            {
+                key++;
+            }
+
+            if ( order[ key ] == '\0' )
+            {
+                return false;
+            }
+        }
+
+        chord   |= ( chord_type ) 1 << key;
+        position = key + 1;
+    }
+
+    return true;
+}
+
+std::string
+chord_steno( chord_type chord );
+
+}
@@ -0,0 +1,144 @@
+// chorder.cpp
+
+#include <array>
+#include <linux/input-event-codes.h>
+
+#include "chorder.h"
+
+
+using namespace stenosys;
+
+namespace stenosys
+{
+
+typedef struct
+{
+    uint16_t   code;
+    chord_type key;
+} S_layout_key;
+
+static constexpr S_layout_key qwerty_layout[] =
+{
+    { KEY_1, KEY_NUM }, { KEY_2, KEY_NUM }, { KEY_3, KEY_NUM }, { KEY_4, KEY_NUM }, { KEY_5, KEY_NUM }
+,   { KEY_6, KEY_NUM }, { KEY_7, KEY_NUM }, { KEY_8, KEY_NUM }, { KEY_9, KEY_NUM }, { KEY_0, KEY_NUM }
+,   { KEY_Q, KEY_S_ }, { KEY_W, KEY_T_ }, { KEY_E, KEY_P_ }, { KEY_R, KEY_H_ }
+,   { KEY_A, KEY_S_ }, { KEY_S, KEY_K_ }, { KEY_D, KEY_W_ }, { KEY_F, KEY_R_ }
+,   { KEY_T, KEY_STAR }, { KEY_Y, KEY_STAR }, { KEY_G, KEY_STAR }, { KEY_H, KEY_STAR }
+,   { KEY_C, KEY_VOWEL_A }, { KEY_V, KEY_VOWEL_O }, { KEY_N, KEY_VOWEL_E }, { KEY_M, KEY_VOWEL_U }
+,   { KEY_U, KEY__F }, { KEY_I, KEY__P }, { KEY_O, KEY__L }, { KEY_P, KEY__T }, { KEY_LEFTBRACE, KEY__D }
+,   { KEY_J, KEY__R }, { KEY_K, KEY__B }, { KEY_L, KEY__G }, { KEY_SEMICOLON, KEY__S }, { KEY_APOSTROPHE, KEY__Z }
+};
+
+// The steno key for each key code (0 if none)
+static constexpr std::array< chord_type, CHORDER_CODES >
+build_key_table()
+{
+    std::array< chord_type, CHORDER_CODES > table {};
+
+    for ( const S_layout_key & layout_key : qwerty_layout )
+    {
+        table[ layout_key.code ] = layout_key.key;
+    }
+
+    return table;
+}
+
+static constexpr std::array< chord_type, CHORDER_CODES > key_table = build_key_table();
+
+C_chorder::C_chorder()
+    : mode_( CM_OFF )
+{
+    reset();
+}
+
+void
+C_chorder::mode( chord_mode_t mode )
+{
+    mode_ = mode;
+
+    reset();
+}
+
+// returns: true if the key is part of the steno layout (and chording is on)
+bool
+C_chorder::steno_key( uint16_t code )
+{
+    return ( mode_ != CM_OFF ) && ( code < CHORDER_CODES ) && ( key_table[ code ] != 0 );
+}
+
+// Add a steno key event to the chord being built. Autorepeats are ignored.
+// returns: true if the event completes a chord, and chord is set to it
+bool
+C_chorder::key( key_event_t event, uint16_t code, chord_type & chord )
+{
+    chord_type key = key_table[ code ];
+
+    if ( event == KEY_EV_DOWN )
+    {
+        if ( sent_ )
+        {
+            // First-up: a new chord, starting with the keys still held
+            chord_ = held_;
+            sent_  = false;
+        }
+
+        codes_.set( code );
+
+        held_  |= key;
+        chord_ |= key;
+    }
+    else if ( event == KEY_EV_UP )
+    {
+        codes_.reset( code );
+
+        held_ = held_keys();
+
+        bool complete = ( mode_ == CM_FIRST_UP ) ? ( ! sent_ ) : ( held_ == 0 );
+
+        if ( complete && ( chord_ != 0 ) )
+        {
+            chord  = chord_;
+            chord_ = 0;
+            sent_  = ( held_ != 0 );
+
+            return true;
+        }
+
+        if ( held_ == 0 )
+        {
+            sent_ = false;
+        }
+    }
+
+    return false;
+}
+
+// The steno keys of the key codes held
+chord_type
+C_chorder::held_keys()
+{
+    chord_type held = 0;
+
+    for ( const S_layout_key & layout_key : qwerty_layout )
+    {
+        if ( codes_.test( layout_key.code ) )
+        {
+            held |= layout_key.key;
+        }
+    }
+
+    return held;
+}
+
+// Forget the keys held, e.g. when the keyboard has been lost or events have been dropped
+void
+C_chorder::reset()
+{
+    codes_.reset();
+
+    held_  = 0;
+    chord_ = 0;
+    sent_  = false;
+}
+
+}
@@ -0,0 +1,73 @@
+// chorder.h
+#pragma once
+
+#include <bitset>
+#include <cstdint>
+
+#include "chord.h"
+#include "keyevent.h"
+
+namespace stenosys
+{
+
+#define CHORDER_CODES 256       // Key codes which can be steno keys (evdev codes 0 to 255)
+
+// When a chord is complete
+enum chord_mode_t
+{
+    CM_OFF          // Keyboard not used for steno
+,   CM_FIRST_UP     // When the first key of the chord is released
+,   CM_ALL_UP       // When all the keys of the chord have been released
+};
+
+// Builds steno chords from key events on an ordinary keyboard. The keyboard must be able
+// to report all the keys of a chord held together (NKRO). The layout is the usual one for
+// steno on a QWERTY keyboard, with the number row as the number bar:
+//
+//      #  #  #  #  #  #  #  #  #  #
+//      S- T- P- H- *  *  -F -P -L -T -D
+//      S- K- W- R- *  *  -R -B -G -S -Z
+//            A- O-       -E -U
+//
+// In first-up mode, keys pressed after a chord has been sent start a new chord, which
+// also includes any keys of the last chord still held down.
+//
+// Several keys can be the same steno key (both S- keys, the four * keys, the number row),
+// so the keys held are tracked by key code: a steno key is up only once all its keys are.
+class C_chorder
+{
+
+public:
+
+    C_chorder();
+    ~C_chorder() {}
+
+    void
+    mode( chord_mode_t mode );
+
+    bool
+    steno_key( uint16_t code );
+
+    bool
+    key( key_event_t event, uint16_t code, chord_type & chord );
+
+    void
+    reset();
+
+private:
+
+    chord_type
+    held_keys();
+
+private:
+
+    chord_mode_t mode_;
+
+    std::bitset< CHORDER_CODES > codes_;    // Key codes of the steno layout keys down
+
+    chord_type   held_;         // Steno keys down
+    chord_type   chord_;        // Steno keys pressed since the last chord was sent
+    bool         sent_;         // First-up: the chord has been sent, but keys are still held
+};
+
+}
@@ -24,6 +24,7 @@ class C_cmd_parser
     friend class C_st_raw_command;
     friend class C_st_got_command;
     friend class C_st_got_command_2;
+    friend class C_st_got_command_last;
     friend class C_st_get_command_end;
     friend class C_st_end;
 
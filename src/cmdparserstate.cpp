@@ -92,6 +92,7 @@ STATE_DEFINITION( C_st_got_command, C_cmd_parser )
     std::string ch;
 
     bool two_char_cmd = false;
+    bool retroactive  = false;
 
     if ( p->input_.get_next( ch ) )
     {
@@ -168,6 +169,11 @@ STATE_DEFINITION( C_st_got_command, C_cmd_parser )
                 two_char_cmd = true;
                 break;
 
+            case '*':
+                // Retroactive command, applying to the previous word
+                retroactive = true;
+                break;
+
             default:
                 p->parsed_ok_ = false;
                 
@@ -179,6 +185,10 @@ STATE_DEFINITION( C_st_got_command, C_cmd_parser )
         {
             set_state( p, C_st_got_command_2::s.instance(), "C_st_got_command_2" );
         }
+        else if ( retroactive )
+        {
+            set_state( p, C_st_got_command_last::s.instance(), "C_st_got_command_last" );
+        }
         else if ( p->parsed_ok_ )
         {
             set_state( p, C_st_get_command_end::s.instance(), "C_st_get_command_end" );
@@ -231,6 +241,55 @@ STATE_DEFINITION( C_st_got_command_2, C_cmd_parser )
     }
 }
 
+// Retroactive commands:
+//   *-|  capitalise the previous word
+//   *-_  lowercase the first letter of the previous word
+//   *<   uppercase the previous word
+//   *>   lowercase the previous word
+STATE_DEFINITION( C_st_got_command_last, C_cmd_parser )
+{
+    std::string ch;
+
+    uint16_t flag = 0;
+
+    if ( p->input_.get_next( ch ) )
+    {
+        switch ( ch[ 0 ] )
+        {
+            case '<':
+                flag = UPPERCASE_LAST_WORD;
+                break;
+
+            case '>':
+                flag = LOWERCASE_LAST_WORD;
+                break;
+
+            case '-':
+                if ( p->input_.get_next( ch ) )
+                {
+                    flag = ( ch[ 0 ] == '|' ) ? CAPITALISE_LAST : ( ch[ 0 ] == '_' ) ? LOWERCASE_LAST : 0;
+                }
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    if ( flag != 0 )
+    {
+        p->flags_ |= flag;
+        set_state( p, C_st_get_command_end::s.instance(), "C_st_get_command_end" );
+    }
+    else
+    {
+        p->parsed_ok_ = false;
+
+        log_writeln_fmt( C_log::LL_INFO, "Invalid retroactive command: %s", p->input_.c_str() );
+        set_state( p, C_st_end::s.instance(), "C_st_end" );
+    }
+}
+
 STATE_DEFINITION( C_st_escaped_char, C_cmd_parser )
 {
     // Handle escape sequences
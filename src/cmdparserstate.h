@@ -18,6 +18,7 @@ STATE_DECLARATION( C_st_escaped_char,    C_cmd_parser );
 STATE_DECLARATION( C_st_raw_command,     C_cmd_parser );
 STATE_DECLARATION( C_st_got_command,     C_cmd_parser );
 STATE_DECLARATION( C_st_got_command_2,   C_cmd_parser );
+STATE_DECLARATION( C_st_got_command_last,C_cmd_parser );
 STATE_DECLARATION( C_st_get_command_end, C_cmd_parser );
 STATE_DECLARATION( C_st_end,             C_cmd_parser );
 
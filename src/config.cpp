@@ -26,6 +26,12 @@ extern C_log log;
 
 C_config::C_config()
 {
+    config_.jobs           = 0;
+    config_.low_latency    = true;
+    config_.raw_steno      = CM_OFF;
+    config_.stroke_port    = 0;
+    config_.stroke_address = DEF_STROKE_ADDRESS;
+    config_.key_delay      = 0;
 }
 
 C_config::~C_config()
@@ -50,6 +56,12 @@ C_config::read( int argc, char *argv[] )
         return false;
     }
 
+    // A transcript with no output file is written to stdout, so keep the log out of it
+    if ( ( config_.file_transcribe.length() > 0 ) && ( config_.file_output.length() == 0 ) )
+    {
+        log.stream( stderr );
+    }
+
     if ( ! directory_exists( config_dir_path ) )
     {
         if ( ! create_directory( config_dir_path ) )
@@ -131,7 +143,77 @@ C_config::read_config( const std::string & config_path )
             }
             else if ( param == OPT_STENO_DEVICE )
             {
-                config_.device_steno = value;
+                // A comma separated list, or one per line. Each device may be preceded by
+                // its protocol (e.g. txbolt:/dev/ttyUSB0), otherwise GeminiPR is assumed.
+                std::stringstream devices( value );
+                std::string       device;
+
+                while ( std::getline( devices, device, ',' ) )
+                {
+                    S_steno_device steno_device = { device, SP_GEMINI_PR };
+
+                    size_t colon = device.find( ':' );
+
+                    if ( colon != std::string::npos )
+                    {
+                        steno_device.path = device.substr( colon + 1 );
+
+                        if ( ! C_steno_protocol::parse( device.substr( 0, colon ), steno_device.protocol ) )
+                        {
+                            log_writeln_fmt( C_log::LL_INFO, "Invalid protocol in %s for %s (expected geminipr, txbolt or hid)", device.c_str(), param.c_str() );
+                            return false;
+                        }
+                    }
+
+                    if ( steno_device.path.length() > 0 )
+                    {
+                        config_.devices_steno.push_back( steno_device );
+                    }
+                }
+            }
+            else if ( param == OPT_LOW_LATENCY )
+            {
+                std::transform( value.begin(), value.end(), value.begin(), ::tolower );
+
+                config_.low_latency = ( value == "true" ) ? true : false;
+            }
+            else if ( param == OPT_RAW_STENO )
+            {
+                std::transform( value.begin(), value.end(), value.begin(), ::tolower );
+
+                if ( value == "firstup" )
+                {
+                    config_.raw_steno = CM_FIRST_UP;
+                }
+                else if ( value == "allup" )
+                {
+                    config_.raw_steno = CM_ALL_UP;
+                }
+                else if ( value == "off" )
+                {
+                    config_.raw_steno = CM_OFF;
+                }
+                else
+                {
+                    log_writeln_fmt( C_log::LL_INFO, "Invalid value %s for %s (expected off, firstup or allup)", value.c_str(), param.c_str() );
+                    return false;
+                }
+            }
+            else if ( param == OPT_STROKE_PORT )
+            {
+                config_.stroke_port = atoi( value.c_str() );
+            }
+            else if ( param == OPT_STROKE_ADDRESS )
+            {
+                config_.stroke_address = value;
+            }
+            else if ( param == OPT_STROKE_SOCKET )
+            {
+                config_.stroke_socket = value;
+            }
+            else if ( param == OPT_KEY_DELAY )
+            {
+                config_.key_delay = atoi( value.c_str() );
             }
             else
             {
@@ -156,6 +238,12 @@ C_config::create_default_config( const std::string & config_path )
         fprintf( output_stream, OPT_FILE_STENOFILE    "=%s\n", DEF_FILE_STENOFILE    );
         fprintf( output_stream, OPT_RAW_DEVICE        "=%s\n", "" );
         fprintf( output_stream, OPT_STENO_DEVICE      "=%s\n", DEF_STENO_DEVICE      );
+        fprintf( output_stream, OPT_LOW_LATENCY       "=%s\n", DEF_LOW_LATENCY       );
+        fprintf( output_stream, OPT_RAW_STENO         "=%s\n", DEF_RAW_STENO         );
+        fprintf( output_stream, OPT_STROKE_PORT       "=%s\n", DEF_STROKE_PORT       );
+        fprintf( output_stream, OPT_STROKE_ADDRESS    "=%s\n", DEF_STROKE_ADDRESS    );
+        fprintf( output_stream, OPT_STROKE_SOCKET     "=%s\n", ""                    );
+        fprintf( output_stream, OPT_KEY_DELAY         "=%s\n", DEF_KEY_DELAY         );
         fclose( output_stream );
         
         log_writeln_fmt( C_log::LL_ERROR, "Created default configuration file %s", config_path.c_str() );
@@ -169,16 +257,46 @@ C_config::create_default_config( const std::string & config_path )
 bool
 C_config::check_params( int argc, char *argv[], std::string & cfg_path )
 {
-    if ( argc > 1 )
+    for ( int ii = 1; ii < argc; ii++ )
     {
-        // Program takes no parameters; show usage if any are supplied
-        log_writeln( C_log::LL_INFO, "stenosys - stenographic utility" );
-        log_writeln_fmt( C_log::LL_INFO, "  Configuration path is: %s", cfg_path.c_str() );
+        std::string arg = argv[ ii ];
 
-        return false;
+        if ( ( arg == ARG_TRANSCRIBE ) && ( ( ii + 1 ) < argc ) )
+        {
+            config_.file_transcribe = argv[ ++ii ];
+        }
+        else if ( ( arg == ARG_OUTPUT ) && ( ( ii + 1 ) < argc ) )
+        {
+            config_.file_output = argv[ ++ii ];
+        }
+        else if ( ( arg == ARG_JOBS ) && ( ( ii + 1 ) < argc ) )
+        {
+            config_.jobs = atoi( argv[ ++ii ] );
+        }
+        else if ( ( arg == ARG_DEFINE ) && ( ( ii + 1 ) < argc ) )
+        {
+            config_.defines.push_back( argv[ ++ii ] );
+        }
+        else
+        {
+            usage( cfg_path );
+            return false;
+        }
     }
 
     return true;
 }
 
+void
+C_config::usage( const std::string & cfg_path )
+{
+    log_writeln( C_log::LL_INFO, "stenosys - stenographic utility" );
+    log_writeln( C_log::LL_INFO, "  Usage: stenosys [" ARG_TRANSCRIBE " <file.steno> [" ARG_OUTPUT " <file>] [" ARG_JOBS " <n>] [" ARG_DEFINE " <STENO=TEXT>]...]" );
+    log_writeln( C_log::LL_INFO, "    " ARG_TRANSCRIBE ": translate a stroke file at full speed and write the text" );
+    log_writeln( C_log::LL_INFO, "    " ARG_OUTPUT "    : transcription output file (default: stdout)" );
+    log_writeln( C_log::LL_INFO, "    " ARG_JOBS "      : transcription threads (default: one per CPU)" );
+    log_writeln( C_log::LL_INFO, "    " ARG_DEFINE "    : add a dictionary entry and update the transcript incrementally" );
+    log_writeln_fmt( C_log::LL_INFO, "  Configuration path is: %s", cfg_path.c_str() );
+}
+
 }
@@ -4,6 +4,8 @@
 #include <string>
 #include <vector>
 
+#include "chorder.h"
+#include "stenoprotocol.h"
 #include "textfile.h"
 
 namespace stenosys
@@ -18,6 +20,17 @@ namespace stenosys
 #define OPT_DICTIONARY        "dictionary"
 #define OPT_RAW_DEVICE        "rawdevice"
 #define OPT_STENO_DEVICE      "stenodevice"
+#define OPT_LOW_LATENCY       "lowlatency"
+#define OPT_RAW_STENO         "rawsteno"
+#define OPT_STROKE_PORT       "strokeport"
+#define OPT_STROKE_ADDRESS    "strokeaddress"
+#define OPT_STROKE_SOCKET     "strokesocket"
+#define OPT_KEY_DELAY         "keydelay"
+
+#define ARG_TRANSCRIBE        "--transcribe"
+#define ARG_OUTPUT            "--output"
+#define ARG_JOBS              "--jobs"
+#define ARG_DEFINE            "--define"
 
 #define DEF_DISPLAY_VERBOSITY "3"
 #define DEF_DISPLAY_DATETIME  "true"
@@ -25,6 +38,11 @@ namespace stenosys
 #define DEF_RAW_DEVICE        "/dev/input/event8"
 #define DEF_STENO_DEVICE      "/dev/ttyACM0"
 #define DEF_SERIAL_OUTPUT     "/dev/ttyAMA0"
+#define DEF_LOW_LATENCY       "true"
+#define DEF_RAW_STENO         "off"
+#define DEF_STROKE_PORT       "0"
+#define DEF_STROKE_ADDRESS    "127.0.0.1"
+#define DEF_KEY_DELAY         "0"
 
 struct S_config
 {
@@ -35,7 +53,19 @@ struct S_config
     std::string file_dict;
 
     std::string device_raw;
-    std::string device_steno;
+    std::vector< S_steno_device > devices_steno;   // Steno machines, all read at once (e.g. a primary and a backup)
+    bool        low_latency;        // Request low latency mode on the steno serial device
+    chord_mode_t raw_steno;         // Use the raw keyboard for steno: off, firstup or allup
+    int         stroke_port;        // TCP port for strokes from remote steno machines (0: none).
+                                    // Unauthenticated: anything which can connect can type
+    std::string stroke_address;     // Address the TCP port is bound to (IPv4)
+    std::string stroke_socket;      // Unix socket for them (empty: none)
+    unsigned int key_delay;         // Delay (ms) between the keys of a translation
+
+    std::string file_transcribe;    // Stroke file to transcribe (headless mode)
+    std::string file_output;        // Transcription output file (stdout if empty)
+    unsigned int jobs;              // Transcription threads (0: one per CPU)
+    std::vector< std::string > defines;  // Runtime definitions (STENO=TEXT) applied after transcription
 };
 
 
@@ -62,6 +92,9 @@ protected:
     bool
     check_params( int argc, char *argv[], std::string & cfg_path );
 
+    void
+    usage( const std::string & cfg_path );
+
 private:
 
     S_config  config_;
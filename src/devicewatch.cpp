@@ -0,0 +1,142 @@
+// devicewatch.cpp
+
+#include <cerrno>
+#include <cstring>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include "devicewatch.h"
+#include "log.h"
+#include "miscellaneous.h"
+
+
+using namespace stenosys;
+
+namespace stenosys
+{
+
+extern C_log log;
+
+C_device_watch::C_device_watch()
+    : inotify_fd_( -1 )
+    , watch_fd_( -1 )
+{
+}
+
+C_device_watch::~C_device_watch()
+{
+    if ( inotify_fd_ >= 0 )
+    {
+        close( inotify_fd_ );
+    }
+}
+
+// Failure isn't fatal: wait() then just waits for the timeout
+bool
+C_device_watch::initialise( const std::string & directory )
+{
+    directory_ = directory;
+
+    inotify_fd_ = inotify_init1( IN_NONBLOCK | IN_CLOEXEC );
+
+    if ( inotify_fd_ < 0 )
+    {
+        log_writeln_fmt( C_log::LL_ERROR, "inotify_init1() error: %s", strerror( errno ) );
+        return false;
+    }
+
+    watch_fd_ = inotify_add_watch( inotify_fd_, directory.c_str(), IN_CREATE | IN_MOVED_TO | IN_ATTRIB );
+
+    if ( watch_fd_ < 0 )
+    {
+        log_writeln_fmt( C_log::LL_ERROR, "Can't watch %s for devices: %s", directory.c_str(), strerror( errno ) );
+        return false;
+    }
+
+    log_writeln_fmt( C_log::LL_VERBOSE_1, "Watching %s for devices", directory.c_str() );
+
+    return true;
+}
+
+// Watch the directory containing path
+bool
+C_device_watch::initialise_for( const std::string & path )
+{
+    size_t slash = path.rfind( '/' );
+
+    return initialise( ( slash == std::string::npos ) ? "." : ( slash == 0 ) ? "/" : path.substr( 0, slash ) );
+}
+
+// Wait for nodes to appear in the directory, or for timeout_ms
+// returns: true if any have, and names is set to their names (without the directory). If
+//          events were lost, names may be incomplete or empty: rescan the directory.
+bool
+C_device_watch::wait( int timeout_ms, std::vector< std::string > & names )
+{
+    bool changed = false;
+
+    names.clear();
+
+    if ( watch_fd_ < 0 )
+    {
+        delay( timeout_ms );
+        return false;
+    }
+
+    struct pollfd poll_fd = { inotify_fd_, POLLIN, 0 };
+
+    if ( poll( &poll_fd, 1, timeout_ms ) <= 0 )
+    {
+        return false;
+    }
+
+    // Events are aligned for struct inotify_event
+    alignas( struct inotify_event ) char buffer[ DEVICE_WATCH_BUFFER ];
+
+    ssize_t length;
+
+    while ( ( length = read( inotify_fd_, buffer, sizeof( buffer ) ) ) > 0 )
+    {
+        for ( char * next = buffer; next < buffer + length; )
+        {
+            const struct inotify_event * event = ( const struct inotify_event * ) next;
+
+            if ( event->len > 0 )
+            {
+                names.push_back( event->name );
+            }
+
+            changed = true;
+
+            next += sizeof( struct inotify_event ) + event->len;
+        }
+    }
+
+    return changed;
+}
+
+// Wait for a node to appear, or for timeout_ms
+// returns: true if it may have (it has, or events were lost)
+bool
+C_device_watch::wait_for( int timeout_ms, const std::string & name )
+{
+    std::vector< std::string > names;
+
+    if ( ! wait( timeout_ms, names ) )
+    {
+        return false;
+    }
+
+    for ( const std::string & appeared : names )
+    {
+        if ( appeared == name )
+        {
+            return true;
+        }
+    }
+
+    return names.empty();
+}
+
+}
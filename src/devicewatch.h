@@ -0,0 +1,48 @@
+// devicewatch.h
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace stenosys
+{
+
+#define DEVICE_WATCH_BUFFER 4096    // Bytes of inotify events read at a time
+
+// Watches a directory (e.g. /dev or /dev/input) for device nodes appearing, using inotify,
+// so that a device which has been unplugged can be reopened as soon as it comes back.
+// Nodes are reported when they are created, renamed into the directory, or have their
+// attributes changed: udev sets a new node's permissions after creating it, so opening it
+// may only succeed after the second event.
+class C_device_watch
+{
+
+public:
+
+    C_device_watch();
+    ~C_device_watch();
+
+    bool
+    initialise( const std::string & directory );
+
+    bool
+    initialise_for( const std::string & path );
+
+    bool
+    watching() { return watch_fd_ >= 0; }
+
+    bool
+    wait( int timeout_ms, std::vector< std::string > & names );
+
+    bool
+    wait_for( int timeout_ms, const std::string & name );
+
+private:
+
+    int         inotify_fd_;
+    int         watch_fd_;
+
+    std::string directory_;
+};
+
+}
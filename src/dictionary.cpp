@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <cstdint>
 #include <exception>
 #include <fcntl.h>
@@ -11,6 +12,7 @@
 
 #include "cmdparser.h"
 #include "dictionary.h"
+#include "keystrokes.h"
 #include "log.h"
 #include "miscellaneous.h"
 #include "stenoflags.h"
@@ -38,6 +40,8 @@ C_dictionary::C_dictionary()
     , hash_wrap_count_( 0 )
     , hash_duplicate_count_( 0 )
     , hash_hit_capacity_count_( 0 )
+    , keystrokes_compiled_( 0 )
+    , keystrokes_not_compiled_( 0 )
 {
     parser_     = std::make_unique< C_cmd_parser >();
     symbols_    = std::make_unique< C_symbols >();
@@ -368,6 +372,18 @@ C_dictionary::write_cpp_top( FILE * output_stream )
     }
     
     fprintf( output_stream, "static uint32_t hash_table_length = %u;\n\n", hash_capacity_ );
+
+    // The most strokes in any entry bounds how far back translation needs to look
+    uint16_t strokes_max = 0;
+
+    for ( const STENO_ENTRY & entry : *dictionary_ )
+    {
+        uint16_t strokes = std::count( entry.steno.begin(), entry.steno.end(), '/' ) + 1;
+
+        strokes_max = std::max( strokes_max, strokes );
+    }
+
+    fprintf( output_stream, "extern const uint16_t dictionary_strokes_max = %u;\n\n", strokes_max );
     fflush( output_stream );
 }
 
@@ -402,15 +418,21 @@ C_dictionary::write_hash_table( FILE * output_stream )
 
                 if ( latin_ok && shavian_ok )
                 {
+                    // Compile the text as it will be output (before escaping it for the source file)
+                    std::string latin_keys   = keystrokes_literal( parsed_latin );
+                    std::string shavian_keys = keystrokes_literal( parsed_shavian );
+
                     escape_characters( parsed_latin );
                     escape_characters( parsed_shavian );
 
-                    fprintf( output_stream, "    { \"%s\", u8\"%s\", 0x%04x, u8\"%s\", 0x%04x },\n"
+                    fprintf( output_stream, "    { \"%s\", u8\"%s\", 0x%04x, u8\"%s\", 0x%04x, %s, %s },\n"
                                           , entry.steno.c_str()
                                           , parsed_latin.c_str()
                                           , latin_flags
                                           , parsed_shavian.c_str()
-                                          , shavian_flags );
+                                          , shavian_flags
+                                          , latin_keys.c_str()
+                                          , shavian_keys.c_str() );
                 }
                 else
                 {
@@ -422,7 +444,7 @@ C_dictionary::write_hash_table( FILE * output_stream )
         }
         else
         {
-            fprintf( output_stream, "    { nullptr, nullptr, 0x0000, nullptr, 0x0000 },\n" );
+            fprintf( output_stream, "    { nullptr, nullptr, 0x0000, nullptr, 0x0000, nullptr, nullptr },\n" );
         }
     }
 
@@ -430,6 +452,34 @@ C_dictionary::write_hash_table( FILE * output_stream )
     fflush( output_stream );
     
     log_writeln_fmt( C_log::LL_INFO, "%u entries written",  hash_capacity_ );
+    log_writeln_fmt( C_log::LL_INFO, "%u translations compiled to keystrokes, %u not (untypable characters)"
+                                   , keystrokes_compiled_
+                                   , keystrokes_not_compiled_ );
+}
+
+// The keystroke program for a translation, as a C++ literal. Translations with characters
+// that can't be typed have none, and are typed a character at a time.
+std::string
+C_dictionary::keystrokes_literal( const std::string & text )
+{
+    std::u16string keystrokes;
+
+    if ( ! C_keystrokes::compile( text, keystrokes ) )
+    {
+        keystrokes_not_compiled_++;
+        return "nullptr";
+    }
+
+    keystrokes_compiled_++;
+
+    std::string literal = "u\"";
+
+    for ( keystroke_t key : keystrokes )
+    {
+        literal += format_string( "\\x%04x", key );
+    }
+
+    return literal + "\"";
 }
 
 void
@@ -619,6 +669,8 @@ const char * C_dictionary::cpp_top[] =
     "    const uint16_t  latin_flags;" ,
     "    const char *    const shavian;",
     "    const uint16_t  shavian_flags;",
+    "    const char16_t * const latin_keys;     // Keystroke programs (see keystrokes.h)",
+    "    const char16_t * const shavian_keys;",
     "};",
     "",
     nullptr
@@ -648,7 +700,9 @@ const char * C_dictionary::cpp_tail[] =
     "                 , const char * &     latin",
     "                 , const uint16_t * & latin_flags",
     "                 , const char * &     shavian",
-    "                 , const uint16_t * & shavian_flags )",
+    "                 , const uint16_t * & shavian_flags",
+    "                 , const char16_t * & latin_keys",
+    "                 , const char16_t * & shavian_keys )",
     "{",
     "    // Apply hash function to find index for given key",
     "    uint32_t hash_index = generate_hash( key );",
@@ -670,6 +724,8 @@ const char * C_dictionary::cpp_tail[] =
     "            latin_flags   = &entry->latin_flags;",
     "            shavian       = entry->shavian;",
     "            shavian_flags = &entry->shavian_flags;",
+    "            latin_keys    = entry->latin_keys;",
+    "            shavian_keys  = entry->shavian_keys;",
     "", 
     "            return true;",
     "        }",
@@ -779,11 +835,16 @@ const char * C_dictionary::hdr[] =
     "                 , const char * &     latin",
     "                 , const uint16_t * & latin_flags",
     "                 , const char * &     shavian",
-    "                 , const uint16_t * & shavian_flags );",
+    "                 , const uint16_t * & shavian_flags",
+    "                 , const char16_t * & latin_keys",
+    "                 , const char16_t * & shavian_keys );",
 
     "void",
     "word_lookup( const std::string & word, unsigned int max_words, std::list< std::string > & results );",
     "",
+    "// Most strokes in any dictionary entry",
+    "extern const uint16_t dictionary_strokes_max;",
+    "",
     "}",
     nullptr
 };
@@ -97,6 +97,9 @@ private:
     void
     escape_characters( std::string & str );
 
+    std::string
+    keystrokes_literal( const std::string & text );
+
     std::string
     get_filename( const std::string & path );
 
@@ -129,6 +132,9 @@ private:
     uint32_t hash_duplicate_count_;
     uint32_t hash_hit_capacity_count_;
 
+    uint32_t keystrokes_compiled_;
+    uint32_t keystrokes_not_compiled_;
+
 
     static const char * cpp_top[];
     static const char * cpp_tail[];
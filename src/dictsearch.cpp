@@ -43,9 +43,10 @@ C_dictionary_search::start()
 void
 C_dictionary_search::stop()
 {
+    // Stopping the server wakes the thread if it is waiting for input
+    abort_ = true;
     tcpserver_->stop();
 
-    abort_ = true;
     thread_await_exit();
 }
 
@@ -58,7 +59,7 @@ C_dictionary_search::thread_handler()
 {
     std::list< std::string > search_results;
 
-    while ( ! abort_ )
+    while ( ( ! abort_ ) && tcpserver_->running() )
     {
         if ( ( ! sent_prompt_ ) || tcpserver_->new_connection() )
         {
@@ -116,9 +117,9 @@ C_dictionary_search::thread_handler()
                     break;
             }
         }
-        else
+        else if ( ! abort_ )
         {
-            delay( 1 );
+            tcpserver_->wait_input();
         }
     }
 }
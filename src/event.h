@@ -0,0 +1,60 @@
+// event.h
+#pragma once
+
+#include <cstdint>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+namespace stenosys
+{
+
+// A wakeup for a thread waiting in poll() or epoll_wait(). Once signalled, the file
+// descriptor stays readable until the event is cleared, so signals made before the
+// waiter gets round to waiting are not lost (several of them are seen as one).
+class C_event
+{
+public:
+
+    C_event()
+    {
+        fd_ = eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC );
+    }
+
+    virtual
+    ~C_event()
+    {
+        if ( fd_ >= 0 )
+        {
+            close( fd_ );
+        }
+    }
+
+    void
+    signal()
+    {
+        uint64_t count = 1;
+
+        ( void ) ::write( fd_, &count, sizeof( count ) );
+    }
+
+    void
+    clear()
+    {
+        uint64_t count = 0;
+
+        ( void ) ::read( fd_, &count, sizeof( count ) );
+    }
+
+    int
+    fd()
+    {
+        return fd_;
+    }
+
+private:
+
+    int fd_;
+
+};
+
+}
@@ -0,0 +1,125 @@
+// eventloop.cpp
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+#include "eventloop.h"
+#include "log.h"
+
+
+using namespace stenosys;
+
+namespace stenosys
+{
+
+extern C_log log;
+
+C_event_loop::C_event_loop()
+    : epoll_fd_( -1 )
+{
+}
+
+C_event_loop::~C_event_loop()
+{
+    if ( epoll_fd_ >= 0 )
+    {
+        close( epoll_fd_ );
+    }
+}
+
+bool
+C_event_loop::initialise()
+{
+    epoll_fd_ = epoll_create1( EPOLL_CLOEXEC );
+
+    if ( epoll_fd_ < 0 )
+    {
+        log_writeln_fmt( C_log::LL_ERROR, "epoll_create1() error: %s", strerror( errno ) );
+        return false;
+    }
+
+    return true;
+}
+
+// Fails if the descriptor can't be waited on (e.g. a regular file)
+bool
+C_event_loop::add( int fd, uint32_t id )
+{
+    return add_descriptor( fd, id );
+}
+
+// An eventfd (e.g. C_spsc_ring::event_fd()), which wait() clears before reporting it, so
+// that its consumer is woken once for each signal rather than until it clears it
+bool
+C_event_loop::add_event( int fd, uint32_t id )
+{
+    return add_descriptor( fd, ( ( uint64_t ) fd << 32 ) | EVENT_LOOP_CLEAR | id );
+}
+
+// data: the id in the low 32 bits, and for an event descriptor, EVENT_LOOP_CLEAR and the
+// descriptor above them
+bool
+C_event_loop::add_descriptor( int fd, uint64_t data )
+{
+    struct epoll_event event;
+
+    memset( &event, 0, sizeof( event ) );
+
+    event.events   = EPOLLIN;
+    event.data.u64 = data;
+
+    if ( epoll_ctl( epoll_fd_, EPOLL_CTL_ADD, fd, &event ) != 0 )
+    {
+        log_writeln_fmt( C_log::LL_VERBOSE_1, "epoll_ctl() error on descriptor %d: %s", fd, strerror( errno ) );
+        return false;
+    }
+
+    return true;
+}
+
+// Wait until at least one source is readable, or for timeout_ms (-1: no timeout).
+// returns: the number of ids set, 0 on a timeout or signal, -1 on an error
+int
+C_event_loop::wait( int timeout_ms, uint32_t * ids, int ids_max )
+{
+    struct epoll_event events[ EVENT_LOOP_SOURCES_MAX ];
+
+    if ( ids_max > EVENT_LOOP_SOURCES_MAX )
+    {
+        ids_max = EVENT_LOOP_SOURCES_MAX;
+    }
+
+    int count = epoll_wait( epoll_fd_, events, ids_max, timeout_ms );
+
+    if ( count < 0 )
+    {
+        if ( errno == EINTR )
+        {
+            return 0;
+        }
+
+        log_writeln_fmt( C_log::LL_ERROR, "epoll_wait() error: %s", strerror( errno ) );
+        return -1;
+    }
+
+    for ( int ii = 0; ii < count; ii++ )
+    {
+        uint64_t data = events[ ii ].data.u64;
+
+        if ( data & EVENT_LOOP_CLEAR )
+        {
+            uint64_t signals = 0;
+
+            ( void ) ::read( ( int ) ( data >> 32 ), &signals, sizeof( signals ) );
+        }
+
+        ids[ ii ] = ( uint32_t ) data & ( EVENT_LOOP_CLEAR - 1 );
+    }
+
+    return count;
+}
+
+}
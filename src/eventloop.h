@@ -0,0 +1,47 @@
+// eventloop.h
+#pragma once
+
+#include <cstdint>
+#include <sys/epoll.h>
+
+namespace stenosys
+{
+
+#define EVENT_LOOP_SOURCES_MAX 8            // Most sources reported by one wait()
+#define EVENT_LOOP_CLEAR       0x80000000u  // Flags an event descriptor's id (ids must be below it)
+
+// Waits on any number of file descriptors (input devices, C_event wakeups) with epoll.
+// Each descriptor is added with an id which wait() reports when it becomes readable.
+// Descriptors are level triggered: one that is still readable is reported again, except
+// for event descriptors, which wait() clears when it reports them.
+class C_event_loop
+{
+
+public:
+
+    C_event_loop();
+    ~C_event_loop();
+
+    bool
+    initialise();
+
+    bool
+    add( int fd, uint32_t id );
+
+    bool
+    add_event( int fd, uint32_t id );
+
+    int
+    wait( int timeout_ms, uint32_t * ids, int ids_max );
+
+private:
+
+    bool
+    add_descriptor( int fd, uint64_t data );
+
+private:
+
+    int epoll_fd_;
+};
+
+}
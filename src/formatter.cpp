@@ -5,6 +5,7 @@
 #include <iostream>
 #include <memory>
 
+#include "casemap.h"
 #include "formatter.h"
 #include "log.h"
 #include "miscellaneous.h"
@@ -27,51 +28,52 @@ C_formatter::~C_formatter()
 {
 }
 
-std::string
-C_formatter::format( alphabet_type     alphabet_mode
-                   , const std::string text
-                   , uint16_t          flags_curr
-                   , uint16_t          flags_prev 
-                   , bool              extends )
+// Format the text for a stroke into 'formatted', which is reused from call to call
+void
+C_formatter::format( alphabet_type       alphabet_mode
+                   , const std::string & text
+                   , uint16_t            flags_curr
+                   , uint16_t            flags_prev 
+                   , bool                extends
+                   , std::string &       formatted )
 {
-    std::string space_before;
-    std::string space_after;
+    formatted.clear();
 
-    std::string formatted = text;
-    
-    if ( formatted.length() > 0 )
+    if ( text.length() > 0 )
     {
         if ( ( space_mode_ == SP_BEFORE ) && ( ! attach( flags_prev, flags_curr ) ) )
         {
             // Insert a space
-            space_before = " ";
+            formatted += ' ';
+        }
+
+        if ( ( alphabet_mode == AT_SHAVIAN ) && ( flags_prev & NAMING_DOT ) )
+        {
+            // Prefix shavian with a naming dot
+            formatted += "·";
         }
 
+        size_t begin = formatted.length();
+
+        formatted += text;
+
         if ( alphabet_mode == AT_LATIN )
         {
             if ( flags_prev & CAPITALISE_NEXT )
             {
-                formatted[ 0 ] = toupper( formatted[ 0 ] );
+                C_case_map::upper_first( formatted, begin );
             }
             else if ( flags_prev & LOWERCASE_NEXT )
             {
-                formatted[ 0 ] = tolower( formatted[ 0 ] );
+                C_case_map::lower_first( formatted, begin );
             }
             else if ( flags_prev & LOWERCASE_NEXT_WORD )
             {
-                std::transform( formatted.begin(), formatted.end(), formatted.begin(), ::tolower );
+                C_case_map::lower( formatted, begin, formatted.length() );
             }
             else if ( flags_prev & UPPERCASE_NEXT_WORD )
             {
-                std::transform( formatted.begin(), formatted.end(), formatted.begin(), ::toupper );
-            }
-        }
-        else  // Shavian alphabet
-        {
-            if ( flags_prev & NAMING_DOT )
-            {
-                // Prefix shavian with a naming dot
-                formatted = std::string( "·" ) + formatted;
+                C_case_map::upper( formatted, begin, formatted.length() );
             }
         }
     
@@ -79,93 +81,44 @@ C_formatter::format( alphabet_type     alphabet_mode
         {
             // Always insert a space. If the following stroke turns out to be attached
             // to this one, the space will need to be removed (backspaced over).
-            space_after = " ";
+            formatted += ' ';
         }
     }
-    
-    return space_before + formatted + space_after;
 }
 
-std::string
-C_formatter::transition_to( const std::string & prev
-                          , const std::string & curr
-                          , uint16_t            flags_curr
-                          , uint16_t            flags_prev 
-                          , bool                extends
-                          , bool                undo )
+// In space-after mode, remove the trailing space left by the previous stroke if this one
+// attaches to it
+bool
+C_formatter::retract_space( uint16_t flags_prev, uint16_t flags_curr )
 {
-    std::string output;
-    std::string backspaces;
-    std::string difference;
-   
-    if ( extends )
-    {
-        // Minimise the number of characters required to move from one translation
-        // to the next. Check for text common to both.
-        int idx = C_utf8::differs_at( curr, prev );
-        
-        if ( idx >= 0 )
-        {
-            if ( undo )
-            {
-                C_utf8 utf8_curr( curr );
-                C_utf8 utf8_prev( prev );
-
-                backspaces.assign( utf8_curr.length() - idx, '\b' );
-
-                difference = utf8_prev.substr( idx );
-            }
-            else
-            {
-                C_utf8 utf8_curr( curr );
-                C_utf8 utf8_prev( prev );
-                
-                backspaces.assign( utf8_prev.length() - idx, '\b' );
-                
-                difference = utf8_curr.substr( idx );
-            }
-        }
-        else {
+    return ( space_mode_ == SP_AFTER ) && attach( flags_prev, flags_curr );
+}
 
-            if ( undo )
-            {
-                C_utf8 utf8_curr( curr );
+// Apply retroactive case flags to the word text[ begin, end )
+void
+C_formatter::format_last( uint16_t flags, std::string & text, size_t begin, size_t end )
+{
+    if ( begin >= end )
+    {
+        return;
+    }
 
-                backspaces.assign( utf8_curr.length(), '\b' );
-                difference = prev;
-            }
-            else
-            {
-                C_utf8 utf8_prev( prev );
-                
-                backspaces.assign( utf8_prev.length(), '\b' );
-                difference = curr;
-            }
-        }
+    if ( flags & UPPERCASE_LAST_WORD )
+    {
+        C_case_map::upper( text, begin, end );
     }
-    else // Not extending the previous chord
+    else if ( flags & LOWERCASE_LAST_WORD )
     {
-        if ( undo )
-        {
-            // Erase the current translation
-            C_utf8 utf8_curr( curr );
-
-            backspaces.assign( utf8_curr.length(), '\b' );
-        }
-        else
-        {
-            // Do we need to reverse out the trailing space from the previous stroke?
-            if ( ( space_mode_ == SP_AFTER ) && attach( flags_prev, flags_curr ) )
-            {
-                backspaces.assign( 1, '\b' );
-            }
-
-            // Send the current translation
-            difference = curr;
-        }
+        C_case_map::lower( text, begin, end );
+    }
+    else if ( flags & CAPITALISE_LAST )
+    {
+        C_case_map::upper_first( text, begin );
+    }
+    else
+    {
+        C_case_map::lower_first( text, begin );
     }
-
-    return backspaces + difference;  
 }
 
 int
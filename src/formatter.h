@@ -24,21 +24,19 @@ public:
     C_formatter();
     ~C_formatter();
 
-    std::string
-    format( alphabet_type     alphabet_mode
-          , const std::string text
-          , uint16_t          flags_curr
-          , uint16_t          flags_prev 
-          , bool              extends );
+    void
+    format( alphabet_type       alphabet_mode
+          , const std::string & text
+          , uint16_t            flags_curr
+          , uint16_t            flags_prev 
+          , bool                extends
+          , std::string &       formatted );
     
-    std::string
-    transition_to( const std::string & prev
-                 , const std::string & curr
-                 , uint16_t            flags_curr
-                 , uint16_t            flags_prev 
-                 , bool                extends
-                 , bool                undo );
+    bool
+    retract_space( uint16_t flags_prev, uint16_t flags_curr );
 
+    static void
+    format_last( uint16_t flags, std::string & text, size_t begin, size_t end );
 
     void
     space_mode( space_type space_mode );
@@ -1,11 +1,13 @@
 // geminipr.cpp
 
+#include <array>
 #include <assert.h>
 #include <cstdint>
 #include <errno.h>
 #include <stdio.h>
 #include <string.h>
 
+#include "chord.h"
 #include "geminipr.h"
 #include "log.h"
 #include "miscellaneous.h"
@@ -38,120 +40,192 @@ S_geminipr_packet::get()
     return this;
 }
 
-S_geminipr_packet *
-C_gemini_pr::encode( const std::string & stroke )
+// A packet is six bytes of seven key bits each (the top bit marks the first byte). Each
+// byte is converted to chord bits and paper tape text through a table indexed by its
+// seven key bits, built at compile time from the key chart.
+
+// When running the Steno layer in QMK, all '*' keys come through as left-hand keys
+static constexpr char steno_key_chart[] =
 {
-    //TODO (for unit test)
-    return new S_geminipr_packet();
-}
+    '?', '#', '#', '#', '#', '#', '#'   // Left hand keys
+,   'S', 'S', 'T', 'K', 'P', 'W', 'H'
+,   'R', 'A', 'O', '*', '*', '?', '?'
+,   '?', '*', '*', 'E', 'U', 'F', 'R'   // Right hand keys
+,   'P', 'B', 'L', 'G', 'T', 'S', 'D'
+,   '#', '#', '#', '#', '#', '#', 'Z'
+};
 
-std::string
-C_gemini_pr::decode( const S_geminipr_packet & packet )
+#define KEYS_PER_BYTE   7
+#define KEY_COMBINATIONS ( 1 << KEYS_PER_BYTE )
+
+typedef struct
 {
-    //log_writeln_fmt( C_log::LL_VERBOSE_3, "Stroke (binary): %02x %02x %02x %02x %02x %02x",
-    //                                      packet[ 0 ], packet[ 1 ], packet[ 2 ], packet[ 3 ], packet[ 4 ], packet[ 5 ] );
+    char text[ KEYS_PER_BYTE ];
+} S_paper_fragment;
+
+// Chord bit for the key at a position in the chart. Keys which appear twice in steno order
+// are taken from the left bank in the first three bytes and the right bank in the rest;
+// '#' and '*' are the same key wherever they appear. Unused ('?') keys have no bit.
+static constexpr chord_type
+chart_key( unsigned int position )
+{
+    const char * order = STENO_ORDER;
 
-    // Build up keystrokes from the bits set in the received data
-    std::string stroke_lhs;
-    std::string stroke_rhs;
+    char key = steno_key_chart[ position ];
+    int  bit = -1;
+
+    for ( int ii = 0; order[ ii ] != '\0'; ii++ )
+    {
+        if ( ( order[ ii ] == key ) && ( ( bit < 0 ) || ( position >= 3 * KEYS_PER_BYTE ) ) )
+        {
+            bit = ii;
+        }
+    }
+
+    return ( bit < 0 ) ? 0 : ( chord_type ) 1 << bit;
+}
+
+static constexpr std::array< std::array< chord_type, KEY_COMBINATIONS >, BYTES_PER_STROKE >
+build_chord_table()
+{
+    std::array< std::array< chord_type, KEY_COMBINATIONS >, BYTES_PER_STROKE > table {};
 
     for ( unsigned int byte_index = 0; byte_index < BYTES_PER_STROKE; byte_index++ )
     {
-        uint8_t byte = packet[ byte_index ];
-        
-        for ( unsigned int bit = 1; bit <= 7; bit++ )
+        for ( unsigned int keys = 0; keys < KEY_COMBINATIONS; keys++ )
         {
-            if ( ( byte << bit ) & 0x80 )
+            // The first key of the byte is bit 6
+            for ( unsigned int key = 0; key < KEYS_PER_BYTE; key++ )
             {
-                const char key = steno_key_chart[ ( byte_index * 7 ) + bit - 1 ];
-
-                if ( byte_index <= 2 )
+                if ( keys & ( 0x40 >> key ) )
                 {
-                    // LHS 'S' and '*' keys are effectively one ganged key, so suppress a second instance
-                    if ( ( key == 'S' ) || ( key == '*' ) )
-                    {
-                        if ( stroke_lhs.find( key ) == std::string::npos )
-                        {
-                            stroke_lhs+= key;
-                        }
-                    }
-                    else
-                    {
-                        stroke_lhs += key;
-                    }
-                }
-                else
-                {
-                    // RHS keys
-                    stroke_rhs += key;
+                    table[ byte_index ][ keys ] |= chart_key( ( byte_index * KEYS_PER_BYTE ) + key );
                 }
             }
         }
     }
 
-    if ( ! suppress_hyphen( stroke_lhs, stroke_rhs ) )
+    return table;
+}
+
+static constexpr std::array< std::array< S_paper_fragment, KEY_COMBINATIONS >, BYTES_PER_STROKE >
+build_paper_table()
+{
+    std::array< std::array< S_paper_fragment, KEY_COMBINATIONS >, BYTES_PER_STROKE > table {};
+
+    for ( unsigned int byte_index = 0; byte_index < BYTES_PER_STROKE; byte_index++ )
     {
-        stroke_lhs += "-";
+        for ( unsigned int keys = 0; keys < KEY_COMBINATIONS; keys++ )
+        {
+            for ( unsigned int key = 0; key < KEYS_PER_BYTE; key++ )
+            {
+                table[ byte_index ][ keys ].text[ key ] = ( keys & ( 0x40 >> key ) ) ? steno_key_chart[ ( byte_index * KEYS_PER_BYTE ) + key ] : ' ';
+            }
+        }
     }
 
-    return stroke_lhs + stroke_rhs;
+    return table;
 }
 
+// Where each chord key goes in a packet: the first position in the chart with that key
+typedef struct
+{
+    uint8_t byte_index;
+    uint8_t mask;
+} S_key_position;
 
-std::string
-C_gemini_pr::to_paper( const S_geminipr_packet & packet )
+static constexpr std::array< S_key_position, KEY_COUNT >
+build_key_positions()
 {
-    std::string paper;
+    std::array< S_key_position, KEY_COUNT > positions {};
 
-    for ( unsigned int byte_index = 0; byte_index < BYTES_PER_STROKE; byte_index++ )
+    for ( unsigned int position = BYTES_PER_STROKE * KEYS_PER_BYTE; position-- > 0; )
     {
-        uint8_t byte = packet[ byte_index ];
-        
-        for ( unsigned int bit = 1; bit <= 7; bit++ )
+        chord_type key = chart_key( position );
+
+        for ( int bit = 0; bit < KEY_COUNT; bit++ )
         {
-            if ( ( byte << bit ) & 0x80 )
+            if ( key == ( ( chord_type ) 1 << bit ) )
             {
-                paper += steno_key_chart[ ( byte_index * 7 ) + bit - 1 ];
-            }
-            else
-            {
-                paper += ' ';
+                positions[ bit ].byte_index = position / KEYS_PER_BYTE;
+                positions[ bit ].mask       = 0x40 >> ( position % KEYS_PER_BYTE );
             }
         }
     }
-    return paper;
+
+    return positions;
 }
 
+static constexpr std::array< std::array< chord_type, KEY_COMBINATIONS >, BYTES_PER_STROKE >       chord_table   = build_chord_table();
+static constexpr std::array< std::array< S_paper_fragment, KEY_COMBINATIONS >, BYTES_PER_STROKE > paper_table   = build_paper_table();
+static constexpr std::array< S_key_position, KEY_COUNT >                                          key_positions = build_key_positions();
+
+// The packet a steno machine sends for a stroke (a single chord, e.g. "KAT", "#-T")
+// returns: false if the steno isn't a valid chord
 bool
-C_gemini_pr::suppress_hyphen( const std::string & lhs, const std::string & rhs )
+C_gemini_pr::encode( const std::string & steno, S_geminipr_packet & packet )
 {
-    if ( lhs.find_first_of( "AO*", 0 ) != std::string::npos )
-    {
-        return true;
-    }
+    chord_type chord = 0;
 
-    if ( rhs.find_first_of( "EU", 0 ) != std::string::npos )
+    if ( ! chord_parse( steno.c_str(), chord ) )
     {
-        return true;
+        return false;
     }
 
-    if ( rhs.length() == 0 )
+    encode( chord, packet );
+
+    return true;
+}
+
+// The packet a steno machine sends for a chord
+void
+C_gemini_pr::encode( chord_type chord, S_geminipr_packet & packet )
+{
+    memset( packet.data, 0, sizeof( packet.data ) );
+
+    packet.data[ 0 ] = 0x80;
+
+    for ( int bit = 0; bit < KEY_COUNT; bit++ )
     {
-        return true;
+        if ( chord & ( ( chord_type ) 1 << bit ) )
+        {
+            packet.data[ key_positions[ bit ].byte_index ] |= key_positions[ bit ].mask;
+        }
     }
+}
 
-    return false;
+chord_type
+C_gemini_pr::chord( const S_geminipr_packet & packet )
+{
+    return chord_table[ 0 ][ packet.data[ 0 ] & 0x7f ]
+         | chord_table[ 1 ][ packet.data[ 1 ] & 0x7f ]
+         | chord_table[ 2 ][ packet.data[ 2 ] & 0x7f ]
+         | chord_table[ 3 ][ packet.data[ 3 ] & 0x7f ]
+         | chord_table[ 4 ][ packet.data[ 4 ] & 0x7f ]
+         | chord_table[ 5 ][ packet.data[ 5 ] & 0x7f ];
 }
 
-// When running the Steno layer in QMK, all '*' keys come through as left-hand keys
-const char C_gemini_pr::steno_key_chart[] =
+std::string
+C_gemini_pr::decode( const S_geminipr_packet & packet )
 {
-    '?', '#', '#', '#', '#', '#', '#'   // Left hand keys
-,   'S', 'S', 'T', 'K', 'P', 'W', 'H'
-,   'R', 'A', 'O', '*', '*', '?', '?'
-,   '?', '*', '*', 'E', 'U', 'F', 'R'   // Right hand keys
-,   'P', 'B', 'L', 'G', 'T', 'S', 'D'
-,   '#', '#', '#', '#', '#', '#', 'Z'
-};
+    //log_writeln_fmt( C_log::LL_VERBOSE_3, "Stroke (binary): %02x %02x %02x %02x %02x %02x",
+    //                                      packet[ 0 ], packet[ 1 ], packet[ 2 ], packet[ 3 ], packet[ 4 ], packet[ 5 ] );
+
+    return chord_steno( chord( packet ) );
+}
+
+// One column per key bit, in packet order
+std::string
+C_gemini_pr::to_paper( const S_geminipr_packet & packet )
+{
+    std::string paper( BYTES_PER_STROKE * KEYS_PER_BYTE, ' ' );
+
+    for ( unsigned int byte_index = 0; byte_index < BYTES_PER_STROKE; byte_index++ )
+    {
+        memcpy( &paper[ byte_index * KEYS_PER_BYTE ], paper_table[ byte_index ][ packet.data[ byte_index ] & 0x7f ].text, KEYS_PER_BYTE );
+    }
+
+    return paper;
+}
 
 }
@@ -4,6 +4,8 @@
 #include <string>
 #include <stdint.h>
 
+#include "chord.h"
+
 namespace stenosys
 {
 
@@ -26,11 +28,17 @@ class C_gemini_pr
 
 public:
     
+    static chord_type
+    chord( const S_geminipr_packet & packet );
+
     static std::string
     decode( const S_geminipr_packet & packet );
     
-    static S_geminipr_packet * 
-    encode( const std::string & stroke );
+    static bool
+    encode( const std::string & steno, S_geminipr_packet & packet );
+
+    static void
+    encode( chord_type chord, S_geminipr_packet & packet );
 
     static std::string
     to_paper( const S_geminipr_packet & packet );
@@ -39,11 +47,6 @@ private:
 
     C_gemini_pr() {}
     ~C_gemini_pr() {}
-
-    static bool
-    suppress_hyphen( const std::string & lhs, const std::string & rhs );
-    
-    static const char steno_key_chart[];
 };
 
 }
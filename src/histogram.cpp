@@ -0,0 +1,124 @@
+// histogram.cpp
+
+#include <cmath>
+#include <cstring>
+#include <stdio.h>
+
+#include "histogram.h"
+
+namespace stenosys
+{
+
+C_latency_histogram::C_latency_histogram( const char * title )
+    : title_( title )
+{
+    reset();
+}
+
+void
+C_latency_histogram::add( uint64_t value )
+{
+    buckets_[ bucket( value ) ]++;
+
+    count_++;
+    sum_ += value;
+
+    if ( value > max_ )
+    {
+        max_ = value;
+    }
+}
+
+void
+C_latency_histogram::reset()
+{
+    memset( buckets_, 0, sizeof( buckets_ ) );
+
+    count_ = 0;
+    sum_   = 0;
+    max_   = 0;
+}
+
+// returns: the value which percent of the values are less than or equal to, rounded up
+//          to the top of its bucket (but no higher than the maximum)
+uint64_t
+C_latency_histogram::percentile( double percent )
+{
+    uint64_t rank = ( uint64_t ) ceil( percent / 100.0 * count_ );
+    uint64_t seen = 0;
+
+    for ( uint32_t ii = 0; ii < HISTOGRAM_BUCKETS; ii++ )
+    {
+        seen += buckets_[ ii ];
+
+        if ( ( seen >= rank ) && ( seen > 0 ) )
+        {
+            return ( bucket_high( ii ) < max_ ) ? bucket_high( ii ) : max_;
+        }
+    }
+
+    return max_;
+}
+
+// One line of figures, in microseconds (values are in nanoseconds)
+std::string
+C_latency_histogram::report()
+{
+    char buffer[ 200 ];
+
+    snprintf( buffer
+            , sizeof( buffer )
+            , "%-12s %8lu %10.1f %10.1f %10.1f %10.1f %10.1f"
+            , title_.c_str()
+            , ( unsigned long ) count_
+            , ( count_ > 0 ) ? ( sum_ / 1e3 / count_ ) : 0.0
+            , percentile( 50.0 ) / 1e3
+            , percentile( 90.0 ) / 1e3
+            , percentile( 99.0 ) / 1e3
+            , max_ / 1e3 );
+
+    return std::string( buffer );
+}
+
+std::string
+C_latency_histogram::report_header()
+{
+    char buffer[ 200 ];
+
+    snprintf( buffer, sizeof( buffer ), "%-12s %8s %10s %10s %10s %10s %10s", "(us)", "count", "mean", "p50", "p90", "p99", "max" );
+
+    return std::string( buffer );
+}
+
+// Values below 16 have a bucket each. Above that, the top bit of the value selects a
+// group of 16 buckets and the next four bits the bucket within it.
+uint32_t
+C_latency_histogram::bucket( uint64_t value )
+{
+    if ( value < HISTOGRAM_SUB_BUCKETS )
+    {
+        return ( uint32_t ) value;
+    }
+
+    uint32_t top_bit = 63 - __builtin_clzll( value );
+    uint32_t shift   = top_bit - HISTOGRAM_SUB_BITS;
+
+    return ( ( shift + 1 ) * HISTOGRAM_SUB_BUCKETS ) + ( ( value >> shift ) & ( HISTOGRAM_SUB_BUCKETS - 1 ) );
+}
+
+// returns: the highest value counted in the bucket
+uint64_t
+C_latency_histogram::bucket_high( uint32_t bucket )
+{
+    if ( bucket < HISTOGRAM_SUB_BUCKETS )
+    {
+        return bucket;
+    }
+
+    uint32_t shift = ( bucket / HISTOGRAM_SUB_BUCKETS ) - 1;
+    uint64_t low   = ( uint64_t ) ( HISTOGRAM_SUB_BUCKETS + ( bucket % HISTOGRAM_SUB_BUCKETS ) ) << shift;
+
+    return low + ( ( ( uint64_t ) 1 << shift ) - 1 );
+}
+
+}
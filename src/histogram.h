@@ -0,0 +1,67 @@
+// histogram.h
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace stenosys
+{
+
+#define HISTOGRAM_SUB_BITS    4                                 // Buckets per power of two: 2^4
+#define HISTOGRAM_SUB_BUCKETS ( 1 << HISTOGRAM_SUB_BITS )
+#define HISTOGRAM_BUCKETS     ( ( 64 - HISTOGRAM_SUB_BITS + 1 ) * HISTOGRAM_SUB_BUCKETS )
+
+// Latency histogram. Unlike C_distribution, whose buckets are all the same width, the
+// buckets here are log-linear: each power of two is split into 16 buckets, so any value
+// from nanoseconds to hours is counted to within 1/16 of itself and percentiles can be
+// read back with that precision. The maximum is kept exactly.
+class C_latency_histogram
+{
+
+public:
+
+    explicit
+    C_latency_histogram( const char * title );
+
+    ~C_latency_histogram() {}
+
+    void
+    add( uint64_t value );
+
+    void
+    reset();
+
+    uint64_t
+    count() { return count_; }
+
+    uint64_t
+    max() { return max_; }
+
+    uint64_t
+    percentile( double percent );
+
+    std::string
+    report();
+
+    static std::string
+    report_header();
+
+private:
+
+    static uint32_t
+    bucket( uint64_t value );
+
+    static uint64_t
+    bucket_high( uint32_t bucket );
+
+private:
+
+    uint64_t buckets_[ HISTOGRAM_BUCKETS ];
+    uint64_t count_;
+    uint64_t sum_;
+    uint64_t max_;
+
+    std::string title_;
+};
+
+}
@@ -11,13 +11,14 @@
 #include <memory>
 #include <dirent.h>
 #include <fcntl.h>
+#include <poll.h>
 #include <unistd.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
-#include "buffer.h"
 #include "kbdraw.h"
 #include "keyevent.h"
 #include "log.h"
@@ -41,8 +42,14 @@ C_kbd_raw::C_kbd_raw()
     : abort_( false )
     , handle_( -1 )
     , acquired_( false )
+    , dropped_( false )
+    , monotonic_( false )
+    , identity_known_( false )
 {
-    buffer_ = std::make_unique< C_buffer< uint16_t, 256 > >();
+    chorder_      = std::make_unique< C_chorder >();
+    watch_        = std::make_unique< C_device_watch >();
+    buffer_       = std::make_unique< C_spsc_ring< S_key_event, 256 > >();
+    chord_buffer_ = std::make_unique< C_spsc_ring< S_steno_stroke, 16 > >();
     
     timer_.stop();
 }
@@ -64,11 +71,24 @@ C_kbd_raw::~C_kbd_raw()
 // -----------------------------------------------------------------------------------
 
 bool
-C_kbd_raw::initialise( const std::string & device )
+C_kbd_raw::initialise( const std::string & device, chord_mode_t chord_mode )
 {
     device_ = device;
     handle_ = -1;
 
+    chorder_->mode( chord_mode );
+
+    if ( device_.length() > 0 )
+    {
+        device_name_ = device_.substr( device_.rfind( '/' ) + 1 );
+
+        watch_->initialise_for( device_ );
+    }
+    else
+    {
+        watch_->initialise( DEV_DIR );
+    }
+
     return true;
 }
 
@@ -85,15 +105,17 @@ C_kbd_raw::stop()
     thread_await_exit();
 }
 
+// time: when the kernel received the event (CLOCK_MONOTONIC, ns)
 bool
-C_kbd_raw::read( key_event_t & key_event, uint8_t & scancode )
+C_kbd_raw::read( key_event_t & key_event, uint8_t & scancode, uint64_t & time )
 {
-    uint16_t key_entry = 0;
+    S_key_event entry;
 
-    if ( buffer_->get( key_entry ) )
+    if ( buffer_->get( entry ) )
     {
-        key_event = ( key_event_t ) ( key_entry >> 8 );
-        scancode  = key_entry & 0xff;
+        key_event = entry.event;
+        scancode  = entry.code & 0xff;
+        time      = entry.time;
 
         return true;
     }
@@ -101,6 +123,15 @@ C_kbd_raw::read( key_event_t & key_event, uint8_t & scancode )
     return false;
 }
 
+// Read a chord made on the keyboard, as the stroke a steno machine would send for it. The
+// serial read time is when the kernel received the key event which completed the chord
+// (or when the chord was made, if the device's timestamps aren't from the latency clock).
+bool
+C_kbd_raw::read_stroke( S_steno_stroke & stroke )
+{
+    return chord_buffer_->get( stroke );
+}
+
 // Returns true if device has been successfully opened either at program run
 // time, or when access to the device has been lost and re-aquired.
 bool
@@ -116,6 +147,28 @@ C_kbd_raw::acquired()
     return result;
 }
 
+// Signalled when key events may have been added since read() last emptied the buffer, or
+// when the device has been acquired. The acquired flag must be checked whenever the event
+// has been cleared, as that clears the signal for acquisition too.
+int
+C_kbd_raw::event_fd()
+{
+    return buffer_->event_fd();
+}
+
+// Signalled when chords may have been added since read_stroke() last emptied the chord buffer
+int
+C_kbd_raw::stroke_event_fd()
+{
+    return chord_buffer_->event_fd();
+}
+
+std::string
+C_kbd_raw::stroke_source_name()
+{
+    return "keyboard";
+}
+
 // -----------------------------------------------------------------------------------
 // Background thread code
 // -----------------------------------------------------------------------------------
@@ -141,7 +194,16 @@ C_kbd_raw::thread_handler()
         {
             case tsAwaitingOpen:
                 
-                thread_state = open() ? tsOpenSuccessful : tsStartTimer;
+                // After a failed attempt on a node which has just appeared, carry on waiting
+                // for the full search that is due, rather than putting it off
+                if ( open() )
+                {
+                    thread_state = tsOpenSuccessful;
+                }
+                else
+                {
+                    thread_state = timer_.active() ? tsWaitBeforeReopenAttempt : tsStartTimer;
+                }
                 break;
 
             case tsOpenSuccessful:
@@ -149,6 +211,8 @@ C_kbd_raw::thread_handler()
                 acquired_ = true;
                 thread_state = tsReading;
 
+                buffer_->notify();
+
                 log_writeln_fmt( C_log::LL_INFO, "Using raw keyboard device %s", device_in_use_.c_str() );
                 break;
 
@@ -160,24 +224,36 @@ C_kbd_raw::thread_handler()
             case tsReadError:
 
                 thread_state = tsStartTimer;
+                chorder_->reset();
                 log_writeln_fmt( C_log::LL_INFO, "Lost access to raw keyboard device %s", device_in_use_.c_str() );
                 break;
 
             case tsStartTimer:
 
-                timer_.start( 5000 );
+                timer_.start( RAW_REOPEN_MS );
                 thread_state = tsWaitBeforeReopenAttempt;
                 break;
 
             case tsWaitBeforeReopenAttempt:
                 
-                if ( timer_.expired() )
+                // Try the configured device as soon as its node reappears, or the event
+                // nodes which appear as soon as they do, and otherwise try again (searching
+                // all of the nodes) now and again in case an event was missed
+                if ( device_.length() > 0 )
+                {
+                    if ( watch_->wait_for( RAW_POLL_MS, device_name_ ) || timer_.expired() )
+                    {
+                        thread_state = tsAwaitingOpen;
+                    }
+                }
+                else if ( watch_->wait( RAW_POLL_MS, hotplugged_ ) )
                 {
                     thread_state = tsAwaitingOpen;
                 }
-                else
+                else if ( timer_.expired() )
                 {
-                    delay( 10 );
+                    hotplugged_.clear();
+                    thread_state = tsAwaitingOpen;
                 }
                 break;
         }
@@ -186,6 +262,8 @@ C_kbd_raw::thread_handler()
     log_writeln( C_log::LL_INFO, "Shutting down raw keyboard thread" );
 }
     
+// Open the configured keyboard device, or find the keyboard among the event nodes which
+// have just appeared (all of them, if none have)
 bool
 C_kbd_raw::open( void )
 {
@@ -193,7 +271,7 @@ C_kbd_raw::open( void )
     {
         std::string detected_device;
 
-        if ( detect_keyboard( detected_device ) )
+        if ( detect_keyboard( hotplugged_, detected_device ) )
         {
             device_in_use_ = detected_device;
 
@@ -202,58 +280,159 @@ C_kbd_raw::open( void )
     }
     else
     {
+        device_in_use_ = device_;
+
         handle_ = open_keyboard( device_ );
     }
 
-    return handle_ >= 0;
+    hotplugged_.clear();
+
+    if ( handle_ < 0 )
+    {
+        return false;
+    }
+
+    // Remember the keyboard, so that it can be recognised when it is next plugged in
+    identity_known_ = identify( handle_, identity_ );
+
+    return true;
+}
+
+// returns: false if the device can't be identified
+bool
+C_kbd_raw::identify( int hnd, S_input_identity & identity )
+{
+    char name[ 256 ] = { 0 };
+    char phys[ 256 ] = { 0 };
+
+    struct input_id id;
+
+    if ( ( ioctl( hnd, EVIOCGNAME( sizeof( name ) - 1 ), name ) < 0 ) || ( ioctl( hnd, EVIOCGID, &id ) < 0 ) )
+    {
+        return false;
+    }
+
+    // Not all devices have a physical path
+    ioctl( hnd, EVIOCGPHYS( sizeof( phys ) - 1 ), phys );
+
+    identity.name    = name;
+    identity.phys    = phys;
+    identity.bustype = id.bustype;
+    identity.vendor  = id.vendor;
+    identity.product = id.product;
+
+    return true;
 }
 
 
+// Wait for input from the device, then read the events available (up to RAW_READ_MAX) and
+// queue all their key events with one put. When the keyboard is used for steno, the steno
+// keys' events go to the chorder instead, and the chords it completes are queued.
+// returns: false on a read error
 bool
 C_kbd_raw::read( void )
 { 
-    struct input_event kbd_event[ 64 ];
+    struct pollfd poll_fd = { handle_, POLLIN, 0 };
+
+    int res = poll( &poll_fd, 1, RAW_POLL_MS );
+
+    if ( ( res == 0 ) || ( ( res < 0 ) && ( errno == EINTR ) ) )
+    {
+        // Nothing yet: return so that the thread can check for a stop request
+        return true;
+    }
 
-    int bytes_read = ::read( handle_, kbd_event, sizeof( struct input_event ) * 64 );
+    struct input_event kbd_event[ RAW_READ_MAX ];
+    S_key_event        key_events[ RAW_READ_MAX ];
+    S_steno_stroke     strokes[ RAW_READ_MAX ];
+
+    int bytes_read = ::read( handle_, kbd_event, sizeof( kbd_event ) );
 
     log_writeln_fmt( C_log::LL_VERBOSE_1, "thread_handler, bytes_read: %d", bytes_read );
 
     if ( bytes_read >= ( int ) sizeof( struct input_event ) )
     {
+        int key_count    = 0;
+        int stroke_count = 0;
+
+        chord_type chord = 0;
+
         for ( int ii = 0; ii < (int) ( bytes_read / sizeof( struct input_event ) ); ii++ )
         {
             // We have:
-            //   kbd_event[ii].time        timeval: 16 bytes (8 bytes for seconds, 8 bytes for microseconds)
+            //   kbd_event[ii].time        timeval: when the kernel received the event
             //   kbd_event[ii].type        See input-event-codes.h
             //   kbd_event[ii].code        See input-event-codes.h
             //   kbd_event[ii].value       01 for keypress, 00 for release, 02 for autorepeat
-    
-            if ( kbd_event[ ii ].type == EV_KEY )
+            
+            if ( kbd_event[ ii ].type == EV_SYN )
             {
-                if ( kbd_event[ ii ].value == 2 )
+                if ( kbd_event[ ii ].code == SYN_DROPPED )
+                {
+                    // The kernel's buffer overflowed: the events up to the next report are
+                    // incomplete, so they are ignored
+                    log_writeln( C_log::LL_ERROR, "Raw keyboard events dropped by the kernel" );
+                    dropped_ = true;
+                    chorder_->reset();
+                }
+                else if ( kbd_event[ ii ].code == SYN_REPORT )
                 {
-                    // TODO? Suppress auto-repeat for keys such as Shift, Ctrl and Meta
-                    // Key auto-repeat
-                    buffer_->put( ( KEY_EV_AUTO << 8 ) + kbd_event[ ii ].code );
+                    dropped_ = false;
+                }
+            }
+            else if ( ( kbd_event[ ii ].type == EV_KEY ) && ( ! dropped_ ) )
+            {
+                S_key_event & key_event = key_events[ key_count ];
 
-                    //log_writeln_fmt( C_log::LL_INFO, "key auto kbd_event[ii].code: %u", kbd_event[ii].code );
+                // TODO? Suppress auto-repeat for keys such as Shift, Ctrl and Meta
+                switch ( kbd_event[ ii ].value )
+                {
+                    case 2:  key_event.event = KEY_EV_AUTO; break;
+                    case 1:  key_event.event = KEY_EV_DOWN; break;
+                    case 0:  key_event.event = KEY_EV_UP;   break;
+                    default: continue;
                 }
-                else if ( kbd_event[ ii ].value == 1 )
+
+                key_event.code = kbd_event[ ii ].code;
+                key_event.time = ( ( uint64_t ) kbd_event[ ii ].input_event_sec * 1000000000 ) + ( ( uint64_t ) kbd_event[ ii ].input_event_usec * 1000 );
+
+                if ( ! chorder_->steno_key( key_event.code ) )
                 {
-                    // Key down
-                    buffer_->put( ( KEY_EV_DOWN << 8 ) + kbd_event[ ii ].code );
+                    // Passed through
+                    key_count++;
                 }
-                else if ( kbd_event[ ii ].value == 0 )
+                else if ( chorder_->key( key_event.event, key_event.code, chord ) )
                 {
-                    // Key up
-                    buffer_->put( ( KEY_EV_UP << 8 ) + kbd_event[ ii ].code );
+                    S_steno_stroke & stroke = strokes[ stroke_count++ ];
+
+                    C_gemini_pr::encode( chord, stroke.packet );
+
+                    // Without monotonic timestamps, the chord is timed from now
+                    stroke.times.serial_read     = monotonic_ ? key_event.time : C_latency_stats::now();
+                    stroke.times.packet_complete = C_latency_stats::now();
                 }
-                
-                return true;
             }
         }
+
+        int put = buffer_->put_n( key_events, key_count );
+
+        if ( put < key_count )
+        {
+            log_writeln_fmt( C_log::LL_ERROR, "Raw key buffer full: %d key events lost", key_count - put );
+        }
+
+        put = chord_buffer_->put_n( strokes, stroke_count );
+
+        if ( put < stroke_count )
+        {
+            log_writeln_fmt( C_log::LL_ERROR, "Chord buffer full: %d chords lost", stroke_count - put );
+        }
+    }
+    else if ( ( bytes_read < 0 ) && ( errno == EAGAIN ) )
+    {
+        return true;
     }
-    else if ( bytes_read < 0 )
+    else if ( bytes_read <= 0 )
     {
         // Read error, most likely because device has become inaccessible
         // (for example, when using a KVM switch to switch from one PC to 
@@ -270,70 +449,77 @@ C_kbd_raw::read( void )
     return true;
 }
 
+// Find the keyboard among the event nodes named, or among all of those in /dev/input if
+// no names are given. A keyboard which has been used before is recognised by its identity;
+// until then, the Planck keyboard is looked for.
 bool
-C_kbd_raw::detect_keyboard( std::string & device )  
+C_kbd_raw::detect_keyboard( const std::vector< std::string > & names, std::string & device )  
 {
-    int device_event_num = 99999999;
+    std::vector< std::string > candidates = names;
+
+    if ( candidates.empty() )
+    {
+        DIR * dir = opendir( DEV_DIR );
+
+        if ( dir != nullptr )
+        {
+            struct dirent * dir_entry = nullptr;
+
+            while ( ( dir_entry = readdir( dir ) ) != nullptr )
+            {
+                candidates.push_back( dir_entry->d_name );
+            }
 
-    // Try to auto-detect
-    struct dirent * dir_entry = nullptr;
+            closedir( dir );
+        }
+    }
 
-    DIR * dir = opendir( DEV_DIR );
+    int device_event_num = 99999999;
 
-    if ( dir != nullptr )
+    for ( const std::string & candidate : candidates )
     {
-        while ( ( dir_entry = readdir( dir ) ) != nullptr )
+        if ( candidate.compare( 0, strlen( EVENT_DEV ), EVENT_DEV ) != 0 )
         {
-            //log_writeln_fmt( C_log::LL_INFO, "device: %s", dir_entry->d_name );
+            continue;
+        }
 
-            if ( strstr( dir_entry->d_name, EVENT_DEV ) != nullptr )
-            {   
-                std::string dev_path = std::string( DEV_DIR ) + dir_entry->d_name;
+        std::string dev_path = std::string( DEV_DIR ) + candidate;
 
-                int hnd = -1;
+        int hnd = ::open( dev_path.c_str(), O_RDONLY | O_NONBLOCK );
 
-                // Open device
-                if ( ( hnd = ::open( dev_path.c_str(), O_RDONLY ) ) < 0 )
-                {
-                    continue;
-                }
+        if ( hnd < 0 )
+        {
+            continue;
+        }
 
-                char name[ 256 ];
-                
-                int rc = -1;
-                
-                if ( ( rc = ioctl( hnd, EVIOCGNAME( sizeof( name ) ), name ) ) < 0 )
-                {
-                    log_writeln_fmt( C_log::LL_ERROR, "ioctl: EVIOCGNAME failed, rc = %d, errno = %d", rc, errno );
-                } 
+        S_input_identity identity;
 
-                close( hnd );
+        bool identified = identify( hnd, identity );
 
-                //log_writeln_fmt( C_log::LL_ERROR, "device name: %s", name );
-                
-                if ( strstr( name, PLANCK_DEV ) != nullptr )
-                {
-                    // Found a Planck keyboard entry, but there will be two entries for the one keyboard, and we need
-                    // the lowest numbered one to be able to successfully grab it (TODO: find a better way of deciding
-                    // between the two).
-            
-                    //log_writeln_fmt( C_log::LL_ERROR, "Got a planck entry on %s", dir_entry->d_name );
-                    
-                    int num = atoi( dir_entry->d_name + strlen( EVENT_DEV ) );
+        close( hnd );
 
-                    //log_writeln_fmt( C_log::LL_ERROR, "num: %d", num );
-                    
-                    if ( num < device_event_num )
-                    {
-                        device_event_num = num;
-                    }
-                }
+        if ( ! identified )
+        {
+            log_writeln_fmt( C_log::LL_ERROR, "Failed to identify input device %s, errno = %d", dev_path.c_str(), errno );
+            continue;
+        }
+
+        // A Planck keyboard has two entries, and we need the lowest numbered one to be able
+        // to successfully grab it (TODO: find a better way of deciding between the two). Once
+        // it has been grabbed, it is known by its interface.
+        bool match = identity_known_ ? identity.same_device( identity_ ) : ( identity.name.find( PLANCK_DEV ) != std::string::npos );
+
+        if ( match )
+        {
+            int num = atoi( candidate.c_str() + strlen( EVENT_DEV ) );
+
+            if ( num < device_event_num )
+            {
+                device_event_num = num;
             }
         }
     }
 
-    closedir( dir );
-
     if ( device_event_num < 99999999 )
     {
         device = DEV_DIR + std::string( EVENT_DEV ) + std::to_string( device_event_num );
@@ -349,8 +535,8 @@ C_kbd_raw::open_keyboard( const std::string & device )
 {
     int hnd = -1;
 
-    // Open device
-    if ( ( hnd = ::open( device.c_str(), O_RDONLY ) ) < 0 )
+    // Open device. Non-blocking, so that the thread can wait with a timeout in poll().
+    if ( ( hnd = ::open( device.c_str(), O_RDONLY | O_NONBLOCK ) ) < 0 )
     {
         log_writeln_fmt( C_log::LL_ERROR, "Failed to open raw keyboard device %s", device.c_str() );
         return -1;
@@ -390,6 +576,16 @@ C_kbd_raw::open_keyboard( const std::string & device )
         return -1;
     }
 
+    // Timestamp events with the clock the latency figures use (the default is the wall clock)
+    int clock_id = CLOCK_MONOTONIC;
+
+    monotonic_ = ( ioctl( hnd, EVIOCSCLOCKID, &clock_id ) == 0 );
+
+    if ( ! monotonic_ )
+    {
+        log_writeln_fmt( C_log::LL_VERBOSE_1, "  ioctl: EVIOCSCLOCKID failed, errno = %d", errno );
+    }
+
     return hnd;
 }
 
@@ -5,18 +5,48 @@
 #include <memory>
 #include <string>
 #include <termios.h>
+#include <vector>
 
-#include "buffer.h"
-#include "geminipr.h"
+#include "chorder.h"
+#include "devicewatch.h"
 #include "keyevent.h"
+#include "latency.h"
 #include "mutex.h"
+#include "spscring.h"
+#include "strokesource.h"
 #include "thread.h"
 #include "timer.h"
 
 namespace stenosys
 {
 
-class C_kbd_raw : public C_thread
+#define RAW_READ_MAX   64       // Events read from the device in one call
+#define RAW_POLL_MS    100      // Longest wait for input before checking for a stop request
+#define RAW_REOPEN_MS  5000     // Interval for searching all the devices for the keyboard, if it isn't seen to reappear
+
+// Identifies a keyboard, so that it can be recognised when it is plugged in again
+struct S_input_identity
+{
+    std::string name;
+    std::string phys;           // Physical path, e.g. "usb-0000:00:14.0-2/input0"
+    uint16_t    bustype;
+    uint16_t    vendor;
+    uint16_t    product;
+
+    // The same keyboard, and the same interface of it (the USB port may differ)
+    bool
+    same_device( const S_input_identity & other ) const
+    {
+        return ( name == other.name )
+            && ( bustype == other.bustype )
+            && ( vendor == other.vendor )
+            && ( product == other.product )
+            && ( phys.substr( phys.rfind( '/' ) + 1 ) == other.phys.substr( other.phys.rfind( '/' ) + 1 ) );
+    }
+};
+
+// Reads key events from the raw keyboard, and chords made on it if it is used for steno
+class C_kbd_raw : public C_thread, public C_stroke_source
 {
 
 public:
@@ -25,7 +55,7 @@ public:
     ~C_kbd_raw();
 
     bool
-    initialise( const std::string & device );
+    initialise( const std::string & device, chord_mode_t chord_mode );
     
     bool
     start();
@@ -34,15 +64,30 @@ public:
     stop();
 
     bool
-    read( key_event_t & key_event, uint8_t & scan_code );
+    read( key_event_t & key_event, uint8_t & scan_code, uint64_t & time );
+
+    bool
+    read_stroke( S_steno_stroke & stroke );
     
     bool
     acquired();
+
+    int
+    event_fd();
+
+    int
+    stroke_event_fd();
+
+    std::string
+    stroke_source_name();
     
 private:
 
     bool 
-    detect_keyboard( std::string & device );
+    detect_keyboard( const std::vector< std::string > & names, std::string & device );
+
+    static bool
+    identify( int hnd, S_input_identity & identity );
 
     int
     open_keyboard( const std::string & device );
@@ -62,13 +107,25 @@ private:
     int         handle_;
 
     bool        acquired_;
+    bool        dropped_;       // The kernel dropped events: ignore the rest of the report
+    bool        monotonic_;     // Event timestamps are from the clock the latency figures use
 
     std::string device_;
+    std::string device_name_;   // The configured device's name in its directory, e.g. "event3"
     std::string device_in_use_;
 
+    S_input_identity identity_;     // The keyboard last opened
+    bool             identity_known_;
+
+    std::unique_ptr< C_device_watch > watch_;
+    std::vector< std::string >        hotplugged_;  // Event nodes which have just appeared
+
     C_timer     timer_;
 
-    std::unique_ptr< C_buffer< uint16_t, 256 > > buffer_;
+    std::unique_ptr< C_chorder > chorder_;
+
+    std::unique_ptr< C_spsc_ring< S_key_event, 256 > >   buffer_;
+    std::unique_ptr< C_spsc_ring< S_steno_stroke, 16 > > chord_buffer_;    // Chords made on the keyboard
 };
 
 }
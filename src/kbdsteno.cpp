@@ -2,20 +2,23 @@
 // Class for inputting keypresses from a keyboard, typically running the QMK firmware
 // This class supports:
 // - Keypresses direct from the keyboard (normal typing, USB HID)
-// - Steno packets in GeminiPR format (steno layer enabled on the keyboard, serial over USB)
+// - Steno packets in GeminiPR format (steno layer enabled on the keyboard, serial over USB),
+//   or from other steno machines in TX Bolt format, or Plover HID reports
 //
 #include <iostream>
 
 #include <istream>
-#include <linux/input.h>
-#include <linux/input-event-codes.h>
 #include <memory.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <fcntl.h>
+#include <linux/serial.h>
+#include <poll.h>
+#include <sys/ioctl.h>
 #include <unistd.h>
 #include <stdio.h>
 
+#include "devicewatch.h"
 #include "geminipr.h"
 #include "kbdsteno.h"
 #include "log.h"
@@ -35,9 +38,15 @@ extern C_log log;
 
 C_kbd_steno::C_kbd_steno()
 {
-    handle_ = -1;
-    abort_  = false;
-    buffer_ = std::make_unique< C_buffer< S_geminipr_packet, 16 > >();
+    handle_        = -1;
+    abort_         = false;
+    low_latency_   = false;
+    input_length_  = 0;
+    input_time_    = 0;
+    protocol_type_ = SP_GEMINI_PR;
+    buffer_   = std::make_unique< C_spsc_ring< S_steno_stroke, 16 > >();
+    watch_    = std::make_unique< C_device_watch >();
+    protocol_ = C_steno_protocol::create( protocol_type_ );
     timer_.stop();
 }
 
@@ -55,9 +64,15 @@ C_kbd_steno::~C_kbd_steno()
 // -----------------------------------------------------------------------------------
 
 bool
-C_kbd_steno::initialise( const std::string & device )
+C_kbd_steno::initialise( const std::string & device, steno_protocol_t protocol, bool low_latency )
 {
-    device_ = device;
+    protocol_type_ = protocol;
+    protocol_      = C_steno_protocol::create( protocol );
+    device_        = device;
+    device_name_   = device.substr( device.rfind( '/' ) + 1 );
+    low_latency_   = low_latency;
+
+    watch_->initialise_for( device_ );
 
     return true;
 }
@@ -76,16 +91,32 @@ C_kbd_steno::stop()
     thread_await_exit();
 }
 
+// A get() which finds the ring empty makes no system calls, so the main loop can poll an
+// idle source cheaply. It asks for a wakeup on the next put, which the main loop's event
+// loop clears when it reports it.
 bool
-C_kbd_steno::read( S_geminipr_packet & packet )
+C_kbd_steno::read_stroke( S_steno_stroke & stroke )
+{
+    return buffer_->get( stroke );
+}
+
+// Signalled when packets may have been added since read_stroke() last emptied the buffer
+int
+C_kbd_steno::stroke_event_fd()
+{
+    return buffer_->event_fd();
+}
+
+std::string
+C_kbd_steno::stroke_source_name()
 {
-    return buffer_->get( packet );
+    return device_name_;
 }
 
 // See https://stackoverflow.com/questions/20154157/termios-vmin-vtime-and-blocking-non-blocking-read-operations
 
 int
-C_kbd_steno::set_interface_attributes( int fd, int speed )
+C_kbd_steno::set_interface_attributes( int fd, speed_t speed, unsigned int read_min )
 {
     struct termios tty;
 
@@ -95,8 +126,8 @@ C_kbd_steno::set_interface_attributes( int fd, int speed )
         return -1;
     }
 
-    cfsetospeed( &tty, ( speed_t ) speed );
-    cfsetispeed( &tty, ( speed_t ) speed );
+    cfsetospeed( &tty, speed );
+    cfsetispeed( &tty, speed );
 
     tty.c_cflag |= (CLOCAL | CREAD);    // ignore modem controls
     tty.c_cflag &= ~CSIZE;
@@ -110,6 +141,11 @@ C_kbd_steno::set_interface_attributes( int fd, int speed )
     tty.c_lflag &= ~( ECHO | ECHONL | ICANON | ISIG | IEXTEN );
     tty.c_oflag &= ~OPOST;
 
+    // Report the device as readable once the shortest stroke has arrived, with no inter-byte
+    // timer. The device is non-blocking, so this affects poll() rather than read().
+    tty.c_cc[ VMIN ]  = read_min;
+    tty.c_cc[ VTIME ] = 0;
+
     if ( tcsetattr( fd, TCSANOW, &tty ) != 0 )
     {
         log_writeln_fmt( C_log::LL_ERROR, "tcgetattr() error: %s\n", strerror( errno ) );
@@ -118,6 +154,27 @@ C_kbd_steno::set_interface_attributes( int fd, int speed )
     return 0;
 }
 
+// Ask the driver to pass received bytes on immediately rather than on its next timer tick.
+// Not all serial drivers support this (USB CDC ACM devices don't), which is not an error.
+void
+C_kbd_steno::set_low_latency( int fd )
+{
+    struct serial_struct serial;
+
+    if ( ( ioctl( fd, TIOCGSERIAL, &serial ) == 0 ) )
+    {
+        serial.flags |= ASYNC_LOW_LATENCY;
+
+        if ( ioctl( fd, TIOCSSERIAL, &serial ) == 0 )
+        {
+            log_writeln( C_log::LL_VERBOSE_1, "Steno device low latency mode set" );
+            return;
+        }
+    }
+
+    log_writeln_fmt( C_log::LL_VERBOSE_1, "Steno device low latency mode not available: %s", strerror( errno ) );
+}
+
 // -----------------------------------------------------------------------------------
 // Background thread code
 // -----------------------------------------------------------------------------------
@@ -125,11 +182,10 @@ C_kbd_steno::set_interface_attributes( int fd, int speed )
 void
 C_kbd_steno::thread_handler()
 {
-    unsigned int  packet_count = 0;
-    unsigned char b            = 0;
-    eThreadState  thread_state = tsAwaitingOpen;
-
-    S_geminipr_packet packet;
+    eThreadState thread_state = tsAwaitingOpen;
+    uint64_t     read_time    = 0;
+    chord_type   chord        = 0;
+    unsigned int byte_timeout = 0;
 
     while ( ! abort_ )
     {
@@ -142,86 +198,93 @@ C_kbd_steno::thread_handler()
 
             case tsOpenSuccessful:
 
-                log_writeln_fmt( C_log::LL_ERROR, "Using steno serial device %s", device_.c_str() );
-                thread_state = tsAwaitingPacketHeader;
+                log_writeln_fmt( C_log::LL_ERROR, "Using steno %s device %s", C_steno_protocol::name( protocol_type_ ), device_.c_str() );
+                thread_state = tsReading;
                 break;
             
-            case tsAwaitingPacketHeader:
+            case tsReading:
 
-                if ( get_byte( thread_state, b ) )
-                {
-                    // Packet header has top bit set
-                    if ( b & 0x80 )
-                    {
-                        packet[ packet_count++ ]= b;
-                        thread_state = tsPacketBody;
-                    }
-                }
-                break;
-            
-            case tsPacketBody:
-            
-                if ( get_byte( thread_state, b ) )
+                // While a stroke's bytes are arriving, wait no longer than the protocol
+                // allows between them: a stroke with no end marker is complete once they stop
+                byte_timeout = protocol_->in_chord() ? protocol_->byte_timeout_ms() : 0;
+
+                if ( fill( thread_state, ( byte_timeout > 0 ) ? byte_timeout : SERIAL_POLL_MS ) )
                 {
-                    // Rest of packet bytes must have the top bit as zero
-                    if ( b & 0x80 )
+                    // A stroke's time is that of the read which returned its first byte
+                    for ( ssize_t ii = 0; ii < input_length_; ii++ )
                     {
-                        packet_count = 0;
-                        thread_state = tsAwaitingPacketHeader;
-                        log_writeln( C_log::LL_ERROR, "Invalid steno packet" );
-                    }
-                    else
-                    {
-                        packet[ packet_count++ ]= b;
-                        
-                        if ( packet_count == BYTES_PER_STROKE )
+                        if ( ! protocol_->in_chord() )
+                        {
+                            read_time = input_time_;
+                        }
+
+                        if ( protocol_->decode( input_[ ii ], chord ) )
                         {
-                            // We have a complete packet, add it to buffer
-                            buffer_->put( packet );
+                            queue( chord, read_time );
 
-                            packet_count = 0;
-                            thread_state = tsAwaitingPacketHeader;
+                            // The byte may also have started the next stroke
+                            read_time = input_time_;
                         }
                     }
                 }
+                else if ( ( byte_timeout > 0 )
+                       && ( thread_state == tsReading )
+                       && ( ( C_latency_stats::now() - input_time_ ) >= ( byte_timeout * 1000000ULL ) )
+                       && protocol_->end_of_input( chord ) )
+                {
+                    queue( chord, read_time );
+                }
                 break;
 
             case tsReadError:
 
-                log_writeln_fmt( C_log::LL_ERROR, "Lost access to steno serial device %s", device_.c_str() );
+                log_writeln_fmt( C_log::LL_ERROR, "Lost access to steno device %s", device_.c_str() );
                 
-                // Read error: close file and wait 10 seconds before attempting to re-open it
+                // Read error: close file and wait for the device to reappear
                 if ( handle_ >= 0 )
                 {
                     close( handle_ );
                     handle_ = -1;
                 }
-        
-                timer_.start( 10000 );
+
+                protocol_->reset();
                 thread_state = tsStartTimer;
                 break;
             
             case tsStartTimer:
 
-                timer_.start( 5000 );
+                timer_.start( SERIAL_REOPEN_MS );
                 thread_state = tsWaitBeforeReopenAttempt;
                 break;
             
             case tsWaitBeforeReopenAttempt:
         
-                if ( timer_.expired() )
+                // Reopen as soon as the device node is created (or its permissions are set),
+                // and otherwise retry now and again in case the event was missed
+                if ( watch_->wait_for( SERIAL_POLL_MS, device_name_ ) || timer_.expired() )
                 {
                     thread_state = tsAwaitingOpen;
                 }
-                else
-                {
-                    delay( 10 );
-                }
                 break;     
         }
     }
 }
 
+// Pass a decoded chord to the main loop, as the GeminiPR packet a steno machine would send
+// for it
+void
+C_kbd_steno::queue( chord_type chord, uint64_t read_time )
+{
+    S_steno_stroke stroke;
+
+    C_gemini_pr::encode( chord, stroke.packet );
+
+    stroke.times.serial_read     = read_time;
+    stroke.times.packet_complete = C_latency_stats::now();
+
+    buffer_->put( stroke );
+}
+
 bool
 C_kbd_steno::open( void )
 {
@@ -233,8 +296,17 @@ C_kbd_steno::open( void )
     }
     else
     {
-        if ( set_interface_attributes( handle_, B19200 ) > -1 )
+        // A hidraw device has no line settings
+        if ( ( ! protocol_->serial() ) || ( set_interface_attributes( handle_, protocol_->baud_rate(), protocol_->read_min() ) > -1 ) )
         {
+            if ( low_latency_ && protocol_->serial() )
+            {
+                set_low_latency( handle_ );
+            }
+
+            input_length_ = 0;
+            protocol_->reset();
+
             log_writeln_fmt( C_log::LL_VERBOSE_1, "Steno device %s opened", device_.c_str() );
             return true;
         }
@@ -243,36 +315,42 @@ C_kbd_steno::open( void )
     return false;
 }
 
-// Fetch a block of data in GeminiPR format
-// returns: 1 if character was read, and ch is set to character
-//          0 if no character available
-//         -1 if read error
+// Wait up to timeout_ms for input from the device and read all that is available
 bool
-C_kbd_steno::get_byte( eThreadState & state, unsigned char & ch )
+C_kbd_steno::fill( eThreadState & state, unsigned int timeout_ms )
 {
-    unsigned char buf[ 2 ];
+    struct pollfd poll_fd = { handle_, POLLIN, 0 };
 
-    int res = ::read( handle_, buf, 1 );
+    int res = poll( &poll_fd, 1, timeout_ms );
 
-    if ( res > 0 )
+    if ( ( res == 0 ) || ( ( res < 0 ) && ( errno == EINTR ) ) )
     {
-        ch = buf[ 0 ];
-        return true;
+        // Nothing yet: return so that the thread can check for a stop request
+        return false;
     }
-    else if ( ( res < 0 ) &&  ( errno == EAGAIN ) )
+
+    // Data, or a hang-up or error (read() then returns 0 or fails)
+    ssize_t length = ( res > 0 ) ? ::read( handle_, input_, sizeof( input_ ) ) : -1;
+
+    if ( length > 0 )
     {
-        // No data available: short sleep so we don't consume excessive CPU in a tight loop
-        delay( 10 );
+        input_time_   = C_latency_stats::now();
+        input_length_ = length;
+
+        return true;
     }
-    else
+    
+    if ( ( length < 0 ) && ( errno == EAGAIN ) )
     {
-        log_writeln_fmt( C_log::LL_VERBOSE_1, "**Steno read error on serial device %s: %s"
-                       , device_.c_str()  
-                       , strerror( errno ) );
-
-        state = tsReadError;
+        return false;
     }
 
+    log_writeln_fmt( C_log::LL_VERBOSE_1, "**Steno read error on device %s: %s"
+                   , device_.c_str()  
+                   , ( length == 0 ) ? "device closed" : strerror( errno ) );
+
+    state = tsReadError;
+
     return false;
 }
 
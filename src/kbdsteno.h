@@ -6,28 +6,37 @@
 #include <string>
 #include <termios.h>
 
-#include "buffer.h"
+#include "devicewatch.h"
 #include "geminipr.h"
+#include "latency.h"
 #include "mutex.h"
+#include "spscring.h"
+#include "stenoprotocol.h"
+#include "strokesource.h"
 #include "thread.h"
 #include "timer.h"
 
 namespace stenosys
 {
 
+#define SERIAL_READ_MAX  256    // Bytes read from the serial device in one call
+#define SERIAL_POLL_MS   100    // Longest wait for input before checking for a stop request
+#define SERIAL_REOPEN_MS 5000   // Retry interval for reopening the device, if it isn't seen to reappear
+
 enum eThreadState
 {
     tsAwaitingOpen
 ,   tsOpenSuccessful
-,   tsAwaitingPacketHeader
-,   tsPacketBody
+,   tsReading
 ,   tsReadError
 ,   tsStartTimer
 ,   tsWaitBeforeReopenAttempt
 };
 
 
-class C_kbd_steno : public C_thread
+// Reads strokes from a steno machine on a serial (or hidraw) device, decoding them with the
+// machine's protocol
+class C_kbd_steno : public C_thread, public C_stroke_source
 {
 
 public:
@@ -36,7 +45,7 @@ public:
     ~C_kbd_steno();
 
     bool
-    initialise( const std::string & device );
+    initialise( const std::string & device, steno_protocol_t protocol, bool low_latency );
     
     bool
     start();
@@ -45,13 +54,22 @@ public:
     stop();
 
     bool
-    read( S_geminipr_packet & packet );
+    read_stroke( S_steno_stroke & stroke );
+
+    int
+    stroke_event_fd();
+
+    std::string
+    stroke_source_name();
 
 private:
     
 
     int
-    set_interface_attributes( int fd, int speed );
+    set_interface_attributes( int fd, speed_t speed, unsigned int read_min );
+
+    void
+    set_low_latency( int fd );
 
     void
     thread_handler();
@@ -59,19 +77,33 @@ private:
     bool
     open( void );
 
-    bool 
-    get_byte( eThreadState & state, unsigned char & ch );
+    bool
+    fill( eThreadState & state, unsigned int timeout_ms );
+
+    void
+    queue( chord_type chord, uint64_t read_time );
 
 private:
     
     int         handle_;
     bool        abort_;
+    bool        low_latency_;
+
+    unsigned char input_[ SERIAL_READ_MAX ];    // Bytes read from the device
+    ssize_t       input_length_;
+    uint64_t      input_time_;                  // When the input was read
 
     std::string device_;
+    std::string device_name_;   // The device's name in its directory, e.g. "ttyACM0"
 
     C_timer     timer_;
 
-    std::unique_ptr< C_buffer< S_geminipr_packet, 16 > > buffer_;
+    std::unique_ptr< C_device_watch > watch_;
+
+    steno_protocol_t                    protocol_type_;
+    std::unique_ptr< C_steno_protocol > protocol_;
+
+    std::unique_ptr< C_spsc_ring< S_steno_stroke, 16 > > buffer_;
 };
 
 }
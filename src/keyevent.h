@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstdint>
+
 namespace stenosys
 {
 
@@ -10,4 +12,12 @@ namespace stenosys
 
 enum key_event_t { KEY_EV_UNKNOWN, KEY_EV_UP, KEY_EV_DOWN, KEY_EV_AUTO };
 
+// A key event from the raw keyboard, with the time the kernel received it (CLOCK_MONOTONIC, ns)
+struct S_key_event
+{
+    uint64_t    time;
+    uint16_t    code;
+    key_event_t event;
+};
+
 }
@@ -0,0 +1,365 @@
+// keystrokes.cpp
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+
+#include <X11/X.h>
+#include <X11/keysym.h>
+
+#include "keystrokes.h"
+#include "shaviankeysymdefs.h"
+#include "utf8.h"
+
+
+using namespace stenosys;
+
+namespace stenosys
+{
+
+// The key for a character: its keysym, with Shift if the keysym's table entry says so
+// returns: false if the character can't be typed
+bool
+C_keystrokes::keystroke( uint32_t code, keystroke_t & keystroke )
+{
+    KeySym keysym = 0;
+    KeySym modsym = 0;
+
+    if ( code <= 0x7f )
+    {
+        keysym = ascii_to_keysym[ code ].keysym1;
+        modsym = ascii_to_keysym[ code ].keysym2;
+    }
+    else if ( ( code == XK_namingdot ) || ( code == XK_acroring ) )
+    {
+        keysym = to_keysym( code );
+    }
+    else if ( ( code >= XK_peep ) && ( code <= XK_yew ) )
+    {
+        keysym = to_keysym( shavian_to_keysym[ code - XK_peep ].keysym1 );
+        modsym = shavian_to_keysym[ code - XK_peep ].keysym2;
+    }
+
+    int index = keycode_cache_index( keysym );
+
+    if ( ( keysym == 0 ) || ( index < 0 ) || ( ( modsym != 0 ) && ( modsym != XK_Shift_L ) ) )
+    {
+        return false;
+    }
+
+    keystroke = ( keystroke_t ) ( index | ( ( modsym != 0 ) ? KEYSTROKE_SHIFT : 0 ) );
+
+    return true;
+}
+
+// Compile a translation into a keystroke program, one keystroke per character
+// returns: false if any of its characters can't be typed
+bool
+C_keystrokes::compile( const std::string & text, std::u16string & keystrokes )
+{
+    keystrokes.clear();
+
+    C_utf8 utf8_text( text );
+
+    uint32_t code = 0;
+
+    if ( utf8_text.get_first( code ) )
+    {
+        do
+        {
+            keystroke_t key = 0;
+
+            if ( ! keystroke( code, key ) )
+            {
+                return false;
+            }
+
+            keystrokes += key;
+
+        } while ( utf8_text.get_next( code ) );
+    }
+
+    // match() relies on there being a keystroke for every character's first byte
+    size_t characters = 0;
+
+    for ( char ch : text )
+    {
+        if ( ( ch & 0xc0 ) != 0x80 )
+        {
+            characters++;
+        }
+    }
+
+    return keystrokes.length() == characters;
+}
+
+// Find how much of the end of a translation's output is the text of the dictionary entry
+// it came from, unchanged. The entry's keystrokes are replayed for that part, and the rest
+// of the output (backspaces, spaces, a capitalised first letter...) is typed a character
+// at a time.
+// returns: true if keystrokes is set to replay some of the output
+bool
+C_keystrokes::match( const std::string &  output
+                   , const std::string &  text
+                   , const keystroke_t *  keys
+                   , S_keystrokes &       keystrokes )
+{
+    keystrokes.keys   = nullptr;
+    keystrokes.offset = output.length();
+
+    if ( keys == nullptr )
+    {
+        return false;
+    }
+
+    size_t limit   = std::min( output.length(), text.length() );
+    size_t matched = 0;
+
+    while ( ( matched < limit ) && ( output[ output.length() - 1 - matched ] == text[ text.length() - 1 - matched ] ) )
+    {
+        matched++;
+    }
+
+    // Start on a whole character
+    while ( ( matched > 0 ) && ( ( text[ text.length() - matched ] & 0xc0 ) == 0x80 ) )
+    {
+        matched--;
+    }
+
+    if ( matched == 0 )
+    {
+        return false;
+    }
+
+    // Skip the keystrokes of the characters before the match
+    size_t skipped = 0;
+
+    for ( size_t index = 0; index < ( text.length() - matched ); index++ )
+    {
+        if ( ( text[ index ] & 0xc0 ) != 0x80 )
+        {
+            skipped++;
+        }
+    }
+
+    keystrokes.keys   = keys + skipped;
+    keystrokes.offset = output.length() - matched;
+
+    return true;
+}
+
+// returns: the keycode cache index for a keysym, or -1 if it isn't cached
+int
+C_keystrokes::keycode_cache_index( KeySym keysym )
+{
+    if ( keysym <= 0x00ff )
+    {
+        return KEYCODE_CACHE_LATIN1 + keysym;
+    }
+
+    if ( ( keysym >= 0xff00 ) && ( keysym <= 0xffff ) )
+    {
+        return KEYCODE_CACHE_FUNCTION + ( keysym - 0xff00 );
+    }
+
+    if ( ( keysym >= to_keysym( XK_peep ) ) && ( keysym <= to_keysym( XK_yew ) ) )
+    {
+        return KEYCODE_CACHE_SHAVIAN + ( keysym - to_keysym( XK_peep ) );
+    }
+
+    if ( keysym == to_keysym( XK_acroring ) )
+    {
+        return KEYCODE_CACHE_ACRORING;
+    }
+
+    return -1;
+}
+
+const keysym_entry
+C_keystrokes::ascii_to_keysym[] =
+{
+    { 0,               0          }     // 0000
+,   { 0,               0          }     // 0001
+,   { 0,               0          }     // 0002
+,   { 0,               0          }     // 0003
+,   { 0,               0          }     // 0004
+,   { 0,               0          }     // 0005
+,   { 0,               0          }     // 0006
+,   { 0,               0          }     // 0007
+,   { XK_BackSpace,    0          }     // 0008
+,   { XK_Tab,          0          }     // 0009
+,   { XK_Linefeed,     0          }     // 000a
+,   { XK_Clear,        0          }     // 000b
+,   { 0,               0          }     // 000c
+,   { XK_Return,       0          }     // 000d
+,   { 0,               0          }     // 000e
+,   { 0,               0          }     // 000f
+,   { 0,               0          }     // 0010
+,   { 0,               0          }     // 0011
+,   { 0,               0          }     // 0012
+,   { XK_Pause,        0          }     // 0013
+,   { XK_Scroll_Lock,  0          }     // 0014
+,   { XK_Sys_Req,      0          }     // 0015
+,   { 0,               0          }     // 0016
+,   { 0,               0          }     // 0017
+,   { 0,               0          }     // 0018
+,   { 0,               0          }     // 0019
+,   { 0,               0          }     // 001a
+,   { XK_Escape,       0          }     // 001b
+,   { 0,               0          }     // 00lc
+,   { 0,               0          }     // 00ld
+,   { 0,               0          }     // 00le
+,   { 0,               0          }     // 00lf
+,   { XK_space,        0          }     // 0020  /* U+0020 SPACE */
+,   { XK_exclam,       XK_Shift_L }     // 0021  /* U+0021 EXCLAMATION MARK */
+,   { XK_quotedbl,     XK_Shift_L }     // 0022  /* U+0022 QUOTATION MARK */
+,   { XK_numbersign,   0          }     // 0023  /* U+0023 NUMBER SIGN */
+,   { XK_dollar,       XK_Shift_L }     // 0024  /* U+0024 DOLLAR SIGN */
+,   { XK_percent,      XK_Shift_L }     // 0025  /* U+0025 PERCENT SIGN */
+,   { XK_ampersand,    XK_Shift_L }     // 0026  /* U+0026 AMPERSAND */
+,   { XK_apostrophe,   0          }     // 0027  /* U+0027 APOSTROPHE */
+,   { XK_parenleft,    XK_Shift_L }     // 0028  /* U+0028 LEFT PARENTHESIS */
+,   { XK_parenright,   XK_Shift_L }     // 0029  /* U+0029 RIGHT PARENTHESIS */
+,   { XK_asterisk,     XK_Shift_L }     // 002a  /* U+002A ASTERISK */
+,   { XK_plus,         XK_Shift_L }     // 002b  /* U+002B PLUS SIGN */
+,   { XK_comma,        0          }     // 002c  /* U+002C COMMA */
+,   { XK_minus,        0          }     // 002d  /* U+002D HYPHEN-MINUS */
+,   { XK_period,       0          }     // 002e  /* U+002E FULL STOP */
+,   { XK_slash,        0          }     // 002f  /* U+002F SOLIDUS */
+,   { XK_0,            0          }     // 0030  /* U+0030 DIGIT ZERO */
+,   { XK_1,            0          }     // 0031  /* U+0031 DIGIT ONE */
+,   { XK_2,            0          }     // 0032  /* U+0032 DIGIT TWO */
+,   { XK_3,            0          }     // 0033  /* U+0033 DIGIT THREE */
+,   { XK_4,            0          }     // 0034  /* U+0034 DIGIT FOUR */
+,   { XK_5,            0          }     // 0035  /* U+0035 DIGIT FIVE */
+,   { XK_6,            0          }     // 0036  /* U+0036 DIGIT SIX */
+,   { XK_7,            0          }     // 0037  /* U+0037 DIGIT SEVEN */
+,   { XK_8,            0          }     // 0038  /* U+0038 DIGIT EIGHT */
+,   { XK_9,            0          }     // 0039  /* U+0039 DIGIT NINE */
+,   { XK_colon,        XK_Shift_L }     // 003a  /* U+003A COLON */
+,   { XK_semicolon,    0          }     // 003b  /* U+003B SEMICOLON */
+,   { XK_less,         XK_Shift_L }     // 003c  /* U+003C LESS-THAN SIGN */
+,   { XK_equal,        0          }     // 003d  /* U+003D EQUALS SIGN */
+,   { XK_greater,      XK_Shift_L }     // 003e  /* U+003E GREATER-THAN SIGN */
+,   { XK_question,     XK_Shift_L }     // 003f  /* U+003F QUESTION MARK */
+,   { XK_at,           0          }     // 0040  /* U+0040 COMMERCIAL AT */
+,   { XK_A,            XK_Shift_L }     // 0041  /* U+0041 LATIN CAPITAL LETTER A */
+,   { XK_B,            XK_Shift_L }     // 0042  /* U+0042 LATIN CAPITAL LETTER B */
+,   { XK_C,            XK_Shift_L }     // 0043  /* U+0043 LATIN CAPITAL LETTER C */
+,   { XK_D,            XK_Shift_L }     // 0044  /* U+0044 LATIN CAPITAL LETTER D */
+,   { XK_E,            XK_Shift_L }     // 0045  /* U+0045 LATIN CAPITAL LETTER E */
+,   { XK_F,            XK_Shift_L }     // 0046  /* U+0046 LATIN CAPITAL LETTER F */
+,   { XK_G,            XK_Shift_L }     // 0047  /* U+0047 LATIN CAPITAL LETTER G */
+,   { XK_H,            XK_Shift_L }     // 0048  /* U+0048 LATIN CAPITAL LETTER H */
+,   { XK_I,            XK_Shift_L }     // 0049  /* U+0049 LATIN CAPITAL LETTER I */
+,   { XK_J,            XK_Shift_L }     // 004a  /* U+004A LATIN CAPITAL LETTER J */
+,   { XK_K,            XK_Shift_L }     // 004b  /* U+004B LATIN CAPITAL LETTER K */
+,   { XK_L,            XK_Shift_L }     // 004c  /* U+004C LATIN CAPITAL LETTER L */
+,   { XK_M,            XK_Shift_L }     // 004d  /* U+004D LATIN CAPITAL LETTER M */
+,   { XK_N,            XK_Shift_L }     // 004e  /* U+004E LATIN CAPITAL LETTER N */
+,   { XK_O,            XK_Shift_L }     // 004f  /* U+004F LATIN CAPITAL LETTER O */
+,   { XK_P,            XK_Shift_L }     // 0050  /* U+0050 LATIN CAPITAL LETTER P */
+,   { XK_Q,            XK_Shift_L }     // 0051  /* U+0051 LATIN CAPITAL LETTER Q */
+,   { XK_R,            XK_Shift_L }     // 0052  /* U+0052 LATIN CAPITAL LETTER R */
+,   { XK_S,            XK_Shift_L }     // 0053  /* U+0053 LATIN CAPITAL LETTER S */
+,   { XK_T,            XK_Shift_L }     // 0054  /* U+0054 LATIN CAPITAL LETTER T */
+,   { XK_U,            XK_Shift_L }     // 0055  /* U+0055 LATIN CAPITAL LETTER U */
+,   { XK_V,            XK_Shift_L }     // 0056  /* U+0056 LATIN CAPITAL LETTER V */
+,   { XK_W,            XK_Shift_L }     // 0057  /* U+0057 LATIN CAPITAL LETTER W */
+,   { XK_X,            XK_Shift_L }     // 0058  /* U+0058 LATIN CAPITAL LETTER X */
+,   { XK_Y,            XK_Shift_L }     // 0059  /* U+0059 LATIN CAPITAL LETTER Y */
+,   { XK_Z,            XK_Shift_L }     // 005a  /* U+005A LATIN CAPITAL LETTER Z */
+,   { XK_bracketleft,  0          }     // 005b  /* U+005B LEFT SQUARE BRACKET */
+,   { XK_backslash,    0          }     // 005c  /* U+005C REVERSE SOLIDUS */
+,   { XK_bracketright, 0          }     // 005d  /* U+005D RIGHT SQUARE BRACKET */
+,   { XK_asciicircum,  XK_Shift_L }     // 005e  /* U+005E CIRCUMFLEX ACCENT */
+,   { XK_underscore,   XK_Shift_L }     // 005f  /* U+005F LOW LINE */
+,   { XK_grave,        0          }     // 0060  /* U+0060 GRAVE ACCENT */
+,   { XK_a,            0          }     // 0061  /* U+0061 LATIN SMALL LETTER A */
+,   { XK_b,            0          }     // 0062  /* U+0062 LATIN SMALL LETTER B */
+,   { XK_c,            0          }     // 0063  /* U+0063 LATIN SMALL LETTER C */
+,   { XK_d,            0          }     // 0064  /* U+0064 LATIN SMALL LETTER D */
+,   { XK_e,            0          }     // 0065  /* U+0065 LATIN SMALL LETTER E */
+,   { XK_f,            0          }     // 0066  /* U+0066 LATIN SMALL LETTER F */
+,   { XK_g,            0          }     // 0067  /* U+0067 LATIN SMALL LETTER G */
+,   { XK_h,            0          }     // 0068  /* U+0068 LATIN SMALL LETTER H */
+,   { XK_i,            0          }     // 0069  /* U+0069 LATIN SMALL LETTER I */
+,   { XK_j,            0          }     // 006a  /* U+006A LATIN SMALL LETTER J */
+,   { XK_k,            0          }     // 006b  /* U+006B LATIN SMALL LETTER K */
+,   { XK_l,            0          }     // 006c  /* U+006C LATIN SMALL LETTER L */
+,   { XK_m,            0          }     // 006d  /* U+006D LATIN SMALL LETTER M */
+,   { XK_n,            0          }     // 006e  /* U+006E LATIN SMALL LETTER N */
+,   { XK_o,            0          }     // 006f  /* U+006F LATIN SMALL LETTER O */
+,   { XK_p,            0          }     // 0070  /* U+0070 LATIN SMALL LETTER P */
+,   { XK_q,            0          }     // 0071  /* U+0071 LATIN SMALL LETTER Q */
+,   { XK_r,            0          }     // 0072  /* U+0072 LATIN SMALL LETTER R */
+,   { XK_s,            0          }     // 0073  /* U+0073 LATIN SMALL LETTER S */
+,   { XK_t,            0          }     // 0074  /* U+0074 LATIN SMALL LETTER T */
+,   { XK_u,            0          }     // 0075  /* U+0075 LATIN SMALL LETTER U */
+,   { XK_v,            0          }     // 0076  /* U+0076 LATIN SMALL LETTER V */
+,   { XK_w,            0          }     // 0077  /* U+0077 LATIN SMALL LETTER W */
+,   { XK_x,            0          }     // 0078  /* U+0078 LATIN SMALL LETTER X */
+,   { XK_y,            0          }     // 0079  /* U+0079 LATIN SMALL LETTER Y */
+,   { XK_z,            0          }     // 007a  /* U+007A LATIN SMALL LETTER Z */
+,   { XK_braceleft,    0          }     // 007b  /* U+007B LEFT CURLY BRACKET */
+,   { XK_bar,          XK_Shift_L }     // 007c  /* U+007C VERTICAL LINE */
+,   { XK_braceright,   0          }     // 007d  /* U+007D RIGHT CURLY BRACKET */
+,   { XK_asciitilde,   XK_Shift_L }     // 007e  /* U+007E TILDE */
+};
+
+const keysym_entry
+C_keystrokes::shavian_to_keysym[] =
+{
+    { XK_peep,         0          }
+,   { XK_tot,          0          }
+,   { XK_kick,         0          }
+,   { XK_fee,          0          }
+,   { XK_thigh,        0          }
+,   { XK_so,           0          }
+,   { XK_sure,         0          }
+,   { XK_church,       0          }
+,   { XK_yea,          XK_Shift_L }
+,   { XK_hung,         0          }
+,   { XK_bib,          XK_Shift_L }
+,   { XK_dead,         XK_Shift_L }
+,   { XK_gag,          XK_Shift_L }
+,   { XK_vow,          XK_Shift_L }
+,   { XK_they,         XK_Shift_L }
+,   { XK_zoo,          XK_Shift_L }
+
+,   { XK_measure,      XK_Shift_L }
+,   { XK_judge,        XK_Shift_L }
+,   { XK_woe,          0          }
+,   { XK_haha,         XK_Shift_L }
+,   { XK_loll,         0          }
+,   { XK_mime,         0          }
+,   { XK_if,           0          }
+,   { XK_egg,          0          }
+,   { XK_ash,          0          }
+,   { XK_ado,          0          }
+,   { XK_on,           0          }
+,   { XK_wool,         0          }
+,   { XK_out,          0          }
+,   { XK_ah,           0          }
+,   { XK_roar,         XK_Shift_L }
+,   { XK_none,         XK_Shift_L }
+
+,   { XK_eat,          XK_Shift_L }
+,   { XK_age,          XK_Shift_L }
+,   { XK_ice,          XK_Shift_L }
+,   { XK_up,           XK_Shift_L }
+,   { XK_oak,          XK_Shift_L }
+,   { XK_ooze,         XK_Shift_L }
+,   { XK_oil,          XK_Shift_L }
+,   { XK_awe,          XK_Shift_L }
+,   { XK_are,          0          }
+,   { XK_or,           XK_Shift_L }
+,   { XK_air,          0          }
+,   { XK_urge,         XK_Shift_L }
+,   { XK_array,        0          }
+,   { XK_ear,          XK_Shift_L }
+,   { XK_ian,          0          }
+,   { XK_yew,          XK_Shift_L }
+};
+
+}
@@ -0,0 +1,97 @@
+// keystrokes.h
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <X11/X.h>
+
+#include "shaviankeysymdefs.h"
+
+namespace stenosys
+{
+
+#define is_shavian_code( x ) ( ( ( XK_peep <= ( x ) ) && ( x <= XK_yew ) ) || \
+                               ( x == XK_namingdot ) || \
+                               ( x == XK_acroring  ) )
+
+// From keysymdef.h:
+// "For any future extension of the keysyms with characters already
+//  found in ISO 10646 / Unicode, the following algorithm shall be
+//  used. The new keysym code position will simply be the character's
+//  Unicode number plus 0x01000000. The keysym values in the range
+//  0x01000100 to 0x0110ffff are reserved to represent Unicode"
+//
+// 0x10450 is the base value of the Shavian code block
+
+#define to_keysym( x ) ( ( ( ( x ) >= XK_peep ) || ( ( x ) == XK_acroring ) ) ? ( ( x ) + 0x1000000 ) : x )
+
+// Keycode cache layout: the keysyms stenosys sends, indexed densely
+#define KEYCODE_CACHE_LATIN1    0x000   // Latin-1 keysyms 0x0000 - 0x00ff (ASCII and the naming dot)
+#define KEYCODE_CACHE_FUNCTION  0x100   // Function keysyms 0xff00 - 0xffff (BackSpace, Return, Shift_L...)
+#define KEYCODE_CACHE_SHAVIAN   0x200   // Shavian keysyms, peep to yew
+#define KEYCODE_CACHE_ACRORING  0x230   // Acronym indicator
+#define KEYCODE_CACHE_SIZE      0x231
+
+// A keystroke: the keycode cache index of the key's keysym, and whether Shift is held
+// for it. A keystroke program holds one keystroke per character of a translation and
+// ends with a zero.
+typedef char16_t keystroke_t;
+
+#define KEYSTROKE_INDEX         0x03ff  // Keycode cache index of the key
+#define KEYSTROKE_SHIFT         0x8000  // Shift is held down for the key
+
+struct keysym_entry
+{
+    keysym_entry()
+    {
+        keysym1 = 0;
+        keysym2 = 0;
+    }
+
+    keysym_entry( KeySym ks1, KeySym ks2 )
+    {
+        keysym1 = ks1;
+        keysym2 = ks2;
+    }
+
+    KeySym keysym1;
+    KeySym keysym2;
+};
+
+// The part of a translation's output that can be replayed from a keystroke program
+struct S_keystrokes
+{
+    const keystroke_t * keys;       // Keystrokes for the end of the output (nullptr: none)
+    size_t              offset;     // Byte offset in the output of the first of them
+};
+
+// Maps characters to the keys typed for them. dictbuild compiles each dictionary entry's
+// translations into keystroke programs with this, and the X11 outputter types everything
+// else with it, so the two always agree.
+class C_keystrokes
+{
+
+public:
+
+    static bool
+    keystroke( uint32_t code, keystroke_t & keystroke );
+
+    static bool
+    compile( const std::string & text, std::u16string & keystrokes );
+
+    static bool
+    match( const std::string &  output
+         , const std::string &  text
+         , const keystroke_t *  keys
+         , S_keystrokes &       keystrokes );
+
+    static int
+    keycode_cache_index( KeySym keysym );
+
+private:
+
+    static const keysym_entry ascii_to_keysym[];
+    static const keysym_entry shavian_to_keysym[];
+};
+
+}
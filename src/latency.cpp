@@ -0,0 +1,242 @@
+// latency.cpp
+
+#include <memory>
+#include <stdio.h>
+#include <string>
+#include <time.h>
+
+#include "latency.h"
+#include "log.h"
+
+
+using namespace stenosys;
+
+namespace stenosys
+{
+
+extern C_log log;
+
+C_latency_stats::C_latency_stats()
+    : abort_( false )
+{
+    histograms_[ LS_PARSE ]     = std::make_unique< C_latency_histogram >( "Parse" );
+    histograms_[ LS_QUEUE ]     = std::make_unique< C_latency_histogram >( "Queue" );
+    histograms_[ LS_TRANSLATE ] = std::make_unique< C_latency_histogram >( "Translate" );
+    histograms_[ LS_OUTPUT ]    = std::make_unique< C_latency_histogram >( "Output" );
+    histograms_[ LS_TOTAL ]     = std::make_unique< C_latency_histogram >( "Total" );
+    histograms_[ LS_KEY ]       = std::make_unique< C_latency_histogram >( "Key" );
+}
+
+// sources: the names of the stroke sources, in the order of their S_stroke_times source index
+bool
+C_latency_stats::initialise( int port, const std::vector< std::string > & sources )
+{
+    for ( const std::string & source : sources )
+    {
+        source_histograms_.push_back( std::make_unique< C_latency_histogram >( ( "  " + source ).c_str() ) );
+    }
+
+    tcpserver_ = std::make_unique< C_tcp_server >();
+
+    return tcpserver_->initialise( port, "Latency stats" );
+}
+
+bool
+C_latency_stats::start()
+{
+    return tcpserver_->start() && thread_start();
+}
+
+void
+C_latency_stats::stop()
+{
+    // Stopping the server wakes the thread if it is waiting for input
+    abort_ = true;
+    tcpserver_->stop();
+
+    thread_await_exit();
+}
+
+// Intervals which end before they start (a timestamp not taken from the latency clock)
+// are meaningless, and are left out
+static void
+add_interval( C_latency_histogram & histogram, uint64_t start, uint64_t end )
+{
+    if ( end >= start )
+    {
+        histogram.add( end - start );
+    }
+}
+
+void
+C_latency_stats::add( const S_stroke_times & times )
+{
+    mutex_.lock();
+
+    add_interval( *histograms_[ LS_PARSE ], times.serial_read, times.packet_complete );
+    add_interval( *histograms_[ LS_QUEUE ], times.packet_complete, times.dequeued );
+    add_interval( *histograms_[ LS_TRANSLATE ], times.dequeued, times.translated );
+    add_interval( *histograms_[ LS_OUTPUT ], times.translated, times.output );
+    add_interval( *histograms_[ LS_TOTAL ], times.serial_read, times.output );
+
+    if ( times.source < source_histograms_.size() )
+    {
+        add_interval( *source_histograms_[ times.source ], times.serial_read, times.output );
+    }
+
+    mutex_.unlock();
+}
+
+void
+C_latency_stats::add_key( uint64_t received, uint64_t output )
+{
+    mutex_.lock();
+
+    // The device may not support monotonic timestamps, in which case they are meaningless
+    add_interval( *histograms_[ LS_KEY ], received, output );
+
+    mutex_.unlock();
+}
+
+void
+C_latency_stats::reset()
+{
+    mutex_.lock();
+
+    for ( int ii = 0; ii < LS_COUNT; ii++ )
+    {
+        histograms_[ ii ]->reset();
+    }
+
+    for ( std::unique_ptr< C_latency_histogram > & histogram : source_histograms_ )
+    {
+        histogram->reset();
+    }
+
+    mutex_.unlock();
+}
+
+std::string
+C_latency_stats::report()
+{
+    std::string report = C_latency_histogram::report_header() + "\r\n";
+
+    mutex_.lock();
+
+    for ( int ii = 0; ii < LS_COUNT; ii++ )
+    {
+        report += histograms_[ ii ]->report() + "\r\n";
+
+        if ( ii == LS_TOTAL )
+        {
+            for ( std::unique_ptr< C_latency_histogram > & histogram : source_histograms_ )
+            {
+                report += histogram->report() + "\r\n";
+            }
+        }
+    }
+
+    mutex_.unlock();
+
+    return report;
+}
+
+void
+C_latency_stats::log_report()
+{
+    log_writeln( C_log::LL_INFO, "Stroke latency:" );
+    log_writeln( C_log::LL_INFO, C_latency_histogram::report_header().c_str() );
+
+    mutex_.lock();
+
+    for ( int ii = 0; ii < LS_COUNT; ii++ )
+    {
+        log_writeln( C_log::LL_INFO, histograms_[ ii ]->report().c_str() );
+
+        if ( ii == LS_TOTAL )
+        {
+            for ( std::unique_ptr< C_latency_histogram > & histogram : source_histograms_ )
+            {
+                log_writeln( C_log::LL_INFO, histogram->report().c_str() );
+            }
+        }
+    }
+
+    mutex_.unlock();
+}
+
+uint64_t
+C_latency_stats::now()
+{
+    struct timespec time;
+
+    clock_gettime( CLOCK_MONOTONIC, &time );
+
+    return ( ( uint64_t ) time.tv_sec * 1000000000 ) + time.tv_nsec;
+}
+
+// -----------------------------------------------------------------------------------
+// Background thread code
+// -----------------------------------------------------------------------------------
+
+void
+C_latency_stats::thread_handler()
+{
+    bool reset_requested = false;
+    bool line_start      = true;
+    char last_ch         = '\0';
+
+    while ( ( ! abort_ ) && tcpserver_->running() )
+    {
+        if ( tcpserver_->new_connection() )
+        {
+            tcpserver_->put_text( report() );
+
+            reset_requested = false;
+            line_start      = true;
+        }
+
+        char ch = '\0';
+
+        if ( tcpserver_->get_char( ch ) )
+        {
+            switch ( ch )
+            {
+                case '\n':
+                    if ( last_ch == '\r' )
+                    {
+                        // Second half of a CR LF
+                        break;
+                    }
+                    // fall through
+                case '\r':
+                    if ( reset_requested )
+                    {
+                        reset();
+                        reset_requested = false;
+                    }
+
+                    tcpserver_->put_text( report() );
+                    break;
+
+                case 'r':
+                case 'R':
+                    // Only as the first character of a line
+                    reset_requested = reset_requested || line_start;
+                    break;
+
+                default:
+                    break;
+            }
+
+            last_ch    = ch;
+            line_start = ( ch == '\r' ) || ( ch == '\n' );
+        }
+        else if ( ! abort_ )
+        {
+            tcpserver_->wait_input();
+        }
+    }
+}
+
+}
@@ -0,0 +1,107 @@
+// latency.h
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "geminipr.h"
+#include "histogram.h"
+#include "mutex.h"
+#include "tcpserver.h"
+#include "thread.h"
+
+namespace stenosys
+{
+
+// Monotonic times (ns) at which a stroke reached each stage between the steno device and
+// the X server
+struct S_stroke_times
+{
+    uint64_t serial_read;       // The read() which returned the packet's first byte (for a chord
+                                // made on the raw keyboard, the key event which completed it)
+    uint64_t packet_complete;   // Last byte parsed, packet queued for the main loop
+    uint64_t dequeued;          // Taken from the queue by the main loop
+    uint64_t translated;        // Translator done (with the rest of its batch)
+    uint64_t output;            // Output sent and XSync'd (or translated, if no output)
+    uint32_t source;            // The stroke source it came from (see C_steno_keyboard::source_name())
+};
+
+// A stroke, as passed from the steno device thread to the main loop
+struct S_steno_stroke
+{
+    S_geminipr_packet packet;
+    S_stroke_times    times;
+};
+
+enum latency_stage_t
+{
+    LS_PARSE            // serial_read     -> packet_complete
+,   LS_QUEUE            // packet_complete -> dequeued
+,   LS_TRANSLATE        // dequeued        -> translated
+,   LS_OUTPUT           // translated      -> output
+,   LS_TOTAL            // serial_read     -> output
+,   LS_KEY              // Raw key events: kernel timestamp -> output
+,   LS_COUNT
+};
+
+// Per-stage latency histograms for the strokes translated by the main loop, the total
+// latency of the strokes from each source, and the latency of the key events passed
+// through from the raw keyboard. Reported by the dump stroke (#-D),
+// and to anything connecting to the stats port: a report is sent on connection and for
+// each line received; a line starting with 'r' resets the figures.
+class C_latency_stats : C_thread
+{
+
+public:
+
+    C_latency_stats();
+    ~C_latency_stats() {}
+
+    bool
+    initialise( int port, const std::vector< std::string > & sources );
+
+    bool
+    start();
+
+    void
+    stop();
+
+    void
+    add( const S_stroke_times & times );
+
+    void
+    add_key( uint64_t received, uint64_t output );
+
+    void
+    reset();
+
+    std::string
+    report();
+
+    void
+    log_report();
+
+    static uint64_t
+    now();
+
+private:
+
+    void
+    thread_handler();
+
+private:
+
+    bool abort_;
+
+    C_mutex mutex_;     // Guards the histograms: added to by the main loop, read by the server
+
+    std::unique_ptr< C_latency_histogram > histograms_[ LS_COUNT ];
+
+    std::vector< std::unique_ptr< C_latency_histogram > > source_histograms_;  // Total, by stroke source
+
+    std::unique_ptr< C_tcp_server > tcpserver_;
+};
+
+}
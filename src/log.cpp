@@ -24,6 +24,7 @@ C_log::C_log()
     level_    = LL_INFO;
     datetime_ = false;
     fileline_ = false;
+    stream_   = stdout;
 }
 
 C_log::~C_log()
@@ -82,8 +83,8 @@ C_log::write_line( eLogLevel    level
             str += "\n";
         }
 
-        fprintf( stdout, "%s", str.c_str() );
-        fflush( stdout );
+        fprintf( stream_, "%s", str.c_str() );
+        fflush( stream_ );
 
         log_lock_.unlock();
     }
@@ -2,6 +2,7 @@
 #pragma once
 
 #include "stdarg.h"
+#include <stdio.h>
 #include <string>
 
 #include "mutex.h"
@@ -43,11 +44,16 @@ public:
     eLogLevel
     log_level() { return level_; }
 
+    // Where log output goes (stdout unless set)
+    void
+    stream( FILE * stream ) { stream_ = stream; }
+
 private:
 
     bool              datetime_;
     bool              fileline_;
     eLogLevel         level_;
+    FILE *            stream_;
                      
     C_mutex           log_lock_;
 
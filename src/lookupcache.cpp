@@ -0,0 +1,117 @@
+// lookupcache.cpp
+
+#include <cstdint>
+#include <list>
+#include <string>
+#include <unordered_map>
+
+#include "log.h"
+#include "lookupcache.h"
+
+
+using namespace stenosys;
+
+namespace stenosys
+{
+
+extern C_log log;
+
+C_lookup_cache::C_lookup_cache()
+    : generation_( 0 )
+{
+    stats_ = { 0, 0, 0, 0 };
+}
+
+C_lookup_cache::~C_lookup_cache()
+{
+}
+
+bool
+C_lookup_cache::find( const std::string & key, std::string & text, uint16_t & flags, const char16_t * & keys, int16_t & depth )
+{
+    auto it = index_.find( key );
+
+    if ( it == index_.end() )
+    {
+        return false;
+    }
+
+    // Move to the front of the LRU list
+    entries_.splice( entries_.begin(), entries_, it->second );
+
+    text  = it->second->text;
+    flags = it->second->flags;
+    keys  = it->second->keys;
+    depth = it->second->depth;
+
+    return true;
+}
+
+void
+C_lookup_cache::insert( const std::string & key, const std::string & text, uint16_t flags, const char16_t * keys, int16_t depth )
+{
+    if ( entries_.size() >= LOOKUP_CACHE_MAX )
+    {
+        index_.erase( entries_.back().key );
+        entries_.pop_back();
+    }
+
+    entries_.push_front( { key, text, flags, keys, depth } );
+
+    index_[ key ] = entries_.begin();
+}
+
+// Drop all entries if the user dictionary has changed since they were made
+void
+C_lookup_cache::validate( uint32_t generation )
+{
+    if ( generation != generation_ )
+    {
+        entries_.clear();
+        index_.clear();
+
+        generation_ = generation;
+    }
+}
+
+void
+C_lookup_cache::record( bool hit, uint64_t ns )
+{
+    if ( hit )
+    {
+        stats_.hits++;
+        stats_.hit_ns += ns;
+    }
+    else
+    {
+        stats_.misses++;
+        stats_.miss_ns += ns;
+    }
+}
+
+void
+C_lookup_cache::add_stats( S_lookup_stats & total, const S_lookup_stats & stats )
+{
+    total.hits    += stats.hits;
+    total.misses  += stats.misses;
+    total.hit_ns  += stats.hit_ns;
+    total.miss_ns += stats.miss_ns;
+}
+
+// Log the hit rate and an estimate of the time saved: each hit is taken to have saved the
+// difference between the average miss and the average hit.
+void
+C_lookup_cache::report( const S_lookup_stats & stats )
+{
+    uint64_t lookups  = stats.hits + stats.misses;
+    double   hit_rate = ( lookups > 0 ) ? ( 100.0 * stats.hits / lookups ) : 0.0;
+    double   hit_ns   = ( stats.hits > 0 )   ? ( ( double ) stats.hit_ns / stats.hits )     : 0.0;
+    double   miss_ns  = ( stats.misses > 0 ) ? ( ( double ) stats.miss_ns / stats.misses ) : 0.0;
+    double   saved_ms = ( stats.hits * ( miss_ns - hit_ns ) ) / 1000000.0;
+
+    log_writeln_fmt( C_log::LL_INFO, "Lookup cache    : %.1f%% hits (%lu of %lu)", hit_rate, ( unsigned long ) stats.hits, ( unsigned long ) lookups );
+    log_writeln_fmt( C_log::LL_INFO, "Lookup time     : %.0f ns hit, %.0f ns miss", hit_ns, miss_ns );
+    log_writeln_fmt( C_log::LL_INFO, "Lookup saved    : %.3f ms", saved_ms );
+}
+
+}
@@ -0,0 +1,74 @@
+// lookupcache.h
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <string>
+#include <unordered_map>
+
+namespace stenosys
+{
+
+#define LOOKUP_CACHE_MAX 4096       // Entries held before the least recently used is dropped
+
+typedef struct
+{
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t hit_ns;                // Total time spent on lookbacks answered from the cache
+    uint64_t miss_ns;               // Total time spent on lookbacks that probed the dictionary
+} S_lookup_stats;
+
+// LRU cache of stroke history lookbacks. The key is the steno of every stroke in the
+// history plus the alphabet; the value is the best dictionary match that looking back
+// through the history finds: its text, its flags, its keystroke program (if it came from
+// the compiled-in dictionary), and how many strokes back it starts.
+class C_lookup_cache
+{
+
+public:
+
+    C_lookup_cache();
+    ~C_lookup_cache();
+
+    bool
+    find( const std::string & key, std::string & text, uint16_t & flags, const char16_t * & keys, int16_t & depth );
+
+    void
+    insert( const std::string & key, const std::string & text, uint16_t flags, const char16_t * keys, int16_t depth );
+
+    void
+    validate( uint32_t generation );
+
+    void
+    record( bool hit, uint64_t ns );
+
+    const S_lookup_stats &
+    stats() { return stats_; }
+
+    static void
+    add_stats( S_lookup_stats & total, const S_lookup_stats & stats );
+
+    static void
+    report( const S_lookup_stats & stats );
+
+private:
+
+    typedef struct
+    {
+        std::string      key;
+        std::string      text;
+        uint16_t         flags;
+        const char16_t * keys;      // Keystroke program for the text, or nullptr if none
+        int16_t          depth;     // Strokes back to the start of the match, or -1 if none
+    } S_lookup_entry;
+
+    std::list< S_lookup_entry > entries_;       // Most recently used first
+
+    std::unordered_map< std::string, std::list< S_lookup_entry >::iterator > index_;
+
+    uint32_t       generation_;     // User dictionary generation the entries were made with
+    S_lookup_stats stats_;
+};
+
+}
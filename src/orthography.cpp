@@ -0,0 +1,379 @@
+// orthography.cpp
+
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "orthography.h"
+
+
+using namespace stenosys;
+
+namespace stenosys
+{
+
+// Pattern syntax, matched against the end of the (lowercased) word:
+//   a-z  the letter
+//   C    a consonant; C* zero or more consonants
+//   V    a vowel
+//   F    a consonant which doubles before a vowel (not w, x or y)
+//   ^    the start of the word
+// An '=' in the appended text repeats the last letter of the word.
+//
+// The first matching rule for the suffix is used; if none match, the suffix is appended.
+const C_orthography::S_latin_rule C_orthography::latin_rules[] =
+{
+    { "s",   "Cy",    1, "ies"  },      // cry     -> cries
+    { "s",   "s",     0, "es"   },      // kiss    -> kisses
+    { "s",   "x",     0, "es"   },      // box     -> boxes
+    { "s",   "z",     0, "es"   },      // buzz    -> buzzes
+    { "s",   "ch",    0, "es"   },      // church  -> churches
+    { "s",   "sh",    0, "es"   },      // wish    -> wishes
+    { "ing", "ie",    2, "ying" },      // die     -> dying
+    { "ing", "ee",    0, "ing"  },      // see     -> seeing
+    { "ing", "oe",    0, "ing"  },      // hoe     -> hoeing
+    { "ing", "ye",    0, "ing"  },      // dye     -> dyeing
+    { "ing", "e",     1, "ing"  },      // make    -> making
+    { "ing", "ic",    0, "king" },      // panic   -> panicking
+    { "ing", "^C*VF", 0, "=ing" },      // run     -> running
+    { "ed",  "Cy",    1, "ied"  },      // cry     -> cried
+    { "ed",  "e",     1, "ed"   },      // bake    -> baked
+    { "ed",  "ic",    0, "ked"  },      // panic   -> panicked
+    { "ed",  "^C*VF", 0, "=ed"  },      // stop    -> stopped
+    { nullptr, nullptr, 0, nullptr }
+};
+
+// Plurals and past tenses take the voicing of the final sound, with a vowel inserted after
+// a sibilant (for -S) or after 𐑑 and 𐑛 (for -D).
+const C_orthography::S_shavian_rule C_orthography::shavian_rules[] =
+{
+    { 'G', nullptr,          "𐑦𐑙" },     // 𐑮𐑳𐑯 -> 𐑮𐑳𐑯𐑦𐑙
+    { 'S', "𐑕𐑟𐑖𐑠𐑗𐑡", "𐑩𐑟" },     // 𐑒𐑦𐑕 -> 𐑒𐑦𐑕𐑩𐑟
+    { 'S', "𐑐𐑑𐑒𐑓𐑔",    "𐑕"   },     // 𐑒𐑨𐑑 -> 𐑒𐑨𐑑𐑕
+    { 'S', nullptr,          "𐑟"   },     // 𐑐𐑤𐑱 -> 𐑐𐑤𐑱𐑟
+    { 'Z', "𐑕𐑟𐑖𐑠𐑗𐑡", "𐑩𐑟" },
+    { 'Z', "𐑐𐑑𐑒𐑓𐑔",    "𐑕"   },
+    { 'Z', nullptr,          "𐑟"   },
+    { 'D', "𐑑𐑛",          "𐑩𐑛" },     // 𐑢𐑪𐑯𐑑 -> 𐑢𐑪𐑯𐑑𐑩𐑛
+    { 'D', "𐑐𐑒𐑓𐑔𐑕𐑖𐑗", "𐑑"   },     // 𐑕𐑑𐑪𐑐 -> 𐑕𐑑𐑪𐑐𐑑
+    { 'D', nullptr,          "𐑛"   },     // 𐑑𐑮𐑲 -> 𐑑𐑮𐑲𐑛
+    { '\0', nullptr, nullptr }
+};
+
+C_orthography::C_orthography()
+{
+    for ( uint16_t rule = 0; latin_rules[ rule ].suffix != nullptr; rule++ )
+    {
+        compile( latin_rules[ rule ] );
+    }
+}
+
+C_orthography::~C_orthography()
+{
+}
+
+// Split the suffix key off the last stroke of a steno key, e.g. KRAOEU/KWREUD gives
+// KRAOEU/KWREU and D. Only a right-hand G, S, D or Z at the end of the stroke counts.
+bool
+C_orthography::fold( const std::string & steno, std::string & base, char & suffix )
+{
+    size_t slash = steno.rfind( '/' );
+    size_t start = ( slash == std::string::npos ) ? 0 : slash + 1;
+
+    if ( ( steno.length() <= start ) || ( strchr( "GSDZ", steno.back() ) == nullptr ) )
+    {
+        return false;
+    }
+
+    size_t right = steno.find_first_of( "AO*EU-", start );
+
+    if ( ( right == std::string::npos ) || ( right >= steno.length() - 1 ) || ( steno.find( '#', start ) != std::string::npos ) )
+    {
+        return false;
+    }
+
+    suffix = steno.back();
+    base   = steno.substr( 0, steno.length() - 1 );
+
+    if ( base.back() == '-' )
+    {
+        base.pop_back();
+    }
+
+    // Nothing left of the stroke, or only the undo stroke
+    return ( base.length() > start ) && ( base.substr( start ) != "*" );
+}
+
+// The reverse of fold() for a single chord: add the suffix key, if it follows the keys
+// already in the chord in steno order.
+bool
+C_orthography::unfold( const std::string & chord, char suffix, std::string & suffixed )
+{
+    const char * right_keys = "FRPBLGTSDZ";
+
+    if ( ( chord.length() == 0 ) || ( chord.find( '#' ) != std::string::npos ) )
+    {
+        return false;
+    }
+
+    size_t separator = chord.find_first_of( "AO*EU-" );
+
+    if ( separator == std::string::npos )
+    {
+        suffixed = chord + "-" + suffix;
+        return true;
+    }
+
+    if ( separator < chord.length() - 1 )
+    {
+        const char * last = strchr( right_keys, chord.back() );
+
+        if ( ( last == nullptr ) || ( last >= strchr( right_keys, suffix ) ) )
+        {
+            return false;
+        }
+    }
+
+    suffixed = chord + suffix;
+
+    return true;
+}
+
+// Add the text for a suffix key to a word. Fails if the word does not end in a letter.
+bool
+C_orthography::inflect( const std::string & word, char suffix, std::string & inflected )
+{
+    std::string key = suffix + word;
+
+    auto it = cache_.find( key );
+
+    if ( it != cache_.end() )
+    {
+        inflected = it->second;
+        return true;
+    }
+
+    size_t length = word.length();
+
+    if ( ( length > 0 ) && isalpha( ( unsigned char ) word.back() ) )
+    {
+        inflect_latin( word, suffix, inflected );
+    }
+    else if ( ( length >= 4 ) && ( word.compare( length - 4, 3, "\xf0\x90\x91" ) == 0 )
+                              && ( ( uint8_t ) word.back() >= 0x90 ) )
+    {
+        // Shavian block, U+10450 to U+1047F
+        inflect_shavian( word, suffix, inflected );
+    }
+    else
+    {
+        return false;
+    }
+
+    if ( cache_.size() >= ORTHOGRAPHY_CACHE_MAX )
+    {
+        cache_.clear();
+    }
+
+    cache_[ key ] = inflected;
+
+    return true;
+}
+
+void
+C_orthography::compile( const S_latin_rule & latin_rule )
+{
+    S_rule rule;
+
+    rule.suffix = latin_rule.suffix;
+    rule.remove = latin_rule.remove;
+    rule.append = latin_rule.append;
+
+    for ( const char * ch = latin_rule.pattern; *ch != '\0'; ch++ )
+    {
+        S_token token = { TK_LETTER, *ch };
+
+        switch ( *ch )
+        {
+            case 'C':
+                token.type = ( *( ch + 1 ) == '*' ) ? TK_CONSONANTS : TK_CONSONANT;
+                ch        += ( token.type == TK_CONSONANTS ) ? 1 : 0;
+                break;
+
+            case 'V':
+                token.type = TK_VOWEL;
+                break;
+
+            case 'F':
+                token.type = TK_FINAL;
+                break;
+
+            case '^':
+                token.type = TK_START;
+                break;
+
+            default:
+                break;
+        }
+
+        rule.tokens.insert( rule.tokens.begin(), token );
+    }
+
+    rules_.push_back( rule );
+}
+
+// Match the tokens (last first) against the end of the word
+bool
+C_orthography::match( const std::string & word, const std::vector< S_token > & tokens )
+{
+    size_t index = word.length();
+
+    for ( const S_token & token : tokens )
+    {
+        if ( token.type == TK_START )
+        {
+            if ( index != 0 )
+            {
+                return false;
+            }
+
+            continue;
+        }
+
+        if ( token.type == TK_CONSONANTS )
+        {
+            while ( ( index > 0 ) && isalpha( ( unsigned char ) word[ index - 1 ] ) && ( ! vowel( word, index - 1 ) ) )
+            {
+                index--;
+            }
+
+            continue;
+        }
+
+        if ( index == 0 )
+        {
+            return false;
+        }
+
+        index--;
+
+        char ch        = word[ index ];
+        bool consonant = isalpha( ( unsigned char ) ch ) && ( ! vowel( word, index ) );
+
+        switch ( token.type )
+        {
+            case TK_LETTER:
+                if ( ch != token.letter )
+                {
+                    return false;
+                }
+                break;
+
+            case TK_CONSONANT:
+                if ( ! consonant )
+                {
+                    return false;
+                }
+                break;
+
+            case TK_VOWEL:
+                if ( ! vowel( word, index ) )
+                {
+                    return false;
+                }
+                break;
+
+            case TK_FINAL:
+                if ( ( ! consonant ) || ( strchr( "wxy", ch ) != nullptr ) )
+                {
+                    return false;
+                }
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    return true;
+}
+
+void
+C_orthography::inflect_latin( const std::string & word, char suffix, std::string & inflected )
+{
+    std::string lower = word;
+
+    for ( char & ch : lower )
+    {
+        ch = tolower( ( unsigned char ) ch );
+    }
+
+    const char * suffix_text = latin_suffix( suffix );
+
+    for ( const S_rule & rule : rules_ )
+    {
+        if ( ( rule.suffix == suffix_text ) && match( lower, rule.tokens ) )
+        {
+            inflected = word.substr( 0, word.length() - rule.remove );
+
+            for ( char ch : rule.append )
+            {
+                inflected += ( ch == '=' ) ? lower.back() : ch;
+            }
+
+            return;
+        }
+    }
+
+    inflected = word + suffix_text;
+}
+
+void
+C_orthography::inflect_shavian( const std::string & word, char suffix, std::string & inflected )
+{
+    std::string last = word.substr( word.length() - 4 );
+
+    for ( uint16_t rule = 0; shavian_rules[ rule ].suffix != '\0'; rule++ )
+    {
+        const S_shavian_rule & shavian_rule = shavian_rules[ rule ];
+
+        if ( ( shavian_rule.suffix == suffix ) &&
+             ( ( shavian_rule.finals == nullptr ) || ( std::string( shavian_rule.finals ).find( last ) != std::string::npos ) ) )
+        {
+            inflected = word + shavian_rule.append;
+            return;
+        }
+    }
+
+    inflected = word;
+}
+
+// A 'u' after a 'q' is treated as part of the consonant
+bool
+C_orthography::vowel( const std::string & word, size_t index )
+{
+    char ch = word[ index ];
+
+    if ( ( ch == 'u' ) && ( index > 0 ) && ( word[ index - 1 ] == 'q' ) )
+    {
+        return false;
+    }
+
+    return strchr( "aeiou", ch ) != nullptr;
+}
+
+const char *
+C_orthography::latin_suffix( char suffix )
+{
+    switch ( suffix )
+    {
+        case 'G': return "ing";
+        case 'D': return "ed";
+        default:  return "s";
+    }
+}
+
+}
@@ -0,0 +1,107 @@
+// orthography.h
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace stenosys
+{
+
+#define ORTHOGRAPHY_CACHE_MAX 1024  // Inflected forms held before the cache is cleared
+
+// Suffix folding. A stroke which is not in the dictionary but ends in one of the -G, -S,
+// -D or -Z suffix keys is looked up without it, and the suffix is added to the word found
+// using the spelling rules of its alphabet, e.g. KRAOEUD -> KRAOEU (cry) -> cried.
+//
+// The Latin rules are written as patterns matched against the end of the word, and
+// compiled when the instance is created. Shavian spelling is phonemic, so its rules only
+// depend on the voicing of the final sound.
+class C_orthography
+{
+
+public:
+
+    C_orthography();
+    ~C_orthography();
+
+    static bool
+    fold( const std::string & steno, std::string & base, char & suffix );
+
+    static bool
+    unfold( const std::string & chord, char suffix, std::string & suffixed );
+
+    bool
+    inflect( const std::string & word, char suffix, std::string & inflected );
+
+private:
+
+    typedef enum
+    {
+        TK_LETTER,                  // The letter itself
+        TK_CONSONANT,               // Any consonant
+        TK_CONSONANTS,              // Zero or more consonants
+        TK_VOWEL,                   // Any vowel
+        TK_FINAL,                   // A consonant which doubles: not w, x or y
+        TK_START                    // Start of the word
+    } token_type;
+
+    typedef struct
+    {
+        token_type type;
+        char       letter;
+    } S_token;
+
+    typedef struct
+    {
+        const char * suffix;        // Suffix the rule applies to
+        const char * pattern;       // End of the word it applies to
+        uint16_t     remove;        // Letters removed from the end of the word
+        const char * append;        // Letters then added
+    } S_latin_rule;
+
+    typedef struct
+    {
+        std::string            suffix;
+        std::vector< S_token > tokens;      // Pattern, last letter first
+        uint16_t               remove;
+        std::string            append;
+    } S_rule;
+
+    typedef struct
+    {
+        char         suffix;
+        const char * finals;        // Final letters the rule applies to; nullptr for any
+        const char * append;
+    } S_shavian_rule;
+
+    void
+    compile( const S_latin_rule & latin_rule );
+
+    bool
+    match( const std::string & word, const std::vector< S_token > & tokens );
+
+    void
+    inflect_latin( const std::string & word, char suffix, std::string & inflected );
+
+    void
+    inflect_shavian( const std::string & word, char suffix, std::string & inflected );
+
+    static bool
+    vowel( const std::string & word, size_t index );
+
+    static const char *
+    latin_suffix( char suffix );
+
+private:
+
+    std::vector< S_rule > rules_;
+
+    std::unordered_map< std::string, std::string > cache_;
+
+    static const S_latin_rule   latin_rules[];
+    static const S_shavian_rule shavian_rules[];
+};
+
+}
@@ -0,0 +1,87 @@
+// ploverhid.cpp
+
+#include <string>
+
+#include "chord.h"
+#include "ploverhid.h"
+
+
+using namespace stenosys;
+
+namespace stenosys
+{
+
+C_plover_hid_protocol::C_plover_hid_protocol()
+{
+    reset();
+}
+
+// hidraw returns one report per read, but reports are also taken from a stream of them
+// (e.g. from stenosys-synth on a pty), each starting with the report id
+bool
+C_plover_hid_protocol::decode( uint8_t byte, chord_type & chord )
+{
+    if ( ( report_count_ == 0 ) && ( byte != PLOVER_HID_REPORT_ID ) )
+    {
+        return false;
+    }
+
+    report_[ report_count_++ ] = byte;
+
+    if ( report_count_ < PLOVER_HID_REPORT_SIZE )
+    {
+        return false;
+    }
+
+    report_count_ = 0;
+
+    chord_type held = 0;
+
+    for ( int key = 0; key < KEY_COUNT; key++ )
+    {
+        if ( report_[ 1 + ( key / 8 ) ] & ( 0x80 >> ( key % 8 ) ) )
+        {
+            held |= chord_key_number_last( key );
+        }
+    }
+
+    chord_ |= held;
+
+    if ( ( held != 0 ) || ( chord_ == 0 ) )
+    {
+        return false;
+    }
+
+    chord  = chord_;
+    chord_ = 0;
+
+    return true;
+}
+
+void
+C_plover_hid_protocol::reset()
+{
+    report_count_ = 0;
+    chord_        = 0;
+}
+
+// The reports for pressing all the keys of the chord together, then releasing them
+void
+C_plover_hid_protocol::encode( chord_type chord, std::string & data )
+{
+    uint8_t pressed[ PLOVER_HID_REPORT_SIZE ]  = { PLOVER_HID_REPORT_ID };
+    uint8_t released[ PLOVER_HID_REPORT_SIZE ] = { PLOVER_HID_REPORT_ID };
+
+    for ( int key = 0; key < KEY_COUNT; key++ )
+    {
+        if ( chord & chord_key_number_last( key ) )
+        {
+            pressed[ 1 + ( key / 8 ) ] |= 0x80 >> ( key % 8 );
+        }
+    }
+
+    data.append( ( const char * ) pressed, sizeof( pressed ) );
+    data.append( ( const char * ) released, sizeof( released ) );
+}
+
+}
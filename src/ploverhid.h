@@ -0,0 +1,55 @@
+// ploverhid.h
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "chord.h"
+#include "stenoprotocol.h"
+
+namespace stenosys
+{
+
+#define PLOVER_HID_REPORT_ID   0x50    // 'P'
+#define PLOVER_HID_REPORT_SIZE 9       // Report id, then 64 key bits
+
+// The Plover HID protocol: the machine is a USB HID device which sends a report of all the
+// keys held whenever a key is pressed or released, read whole from its hidraw device with
+// no serial framing. The keys are numbered from the top bit of the first byte after the
+// report id, in steno order with the number bar last; the rest of the 64 bits are extra
+// keys, which stenosys doesn't use. The machine leaves chording to the host, so a chord is
+// all the keys pressed until they have all been released.
+class C_plover_hid_protocol : public C_steno_protocol
+{
+
+public:
+
+    C_plover_hid_protocol();
+    ~C_plover_hid_protocol() {}
+
+    bool
+    decode( uint8_t byte, chord_type & chord );
+
+    // A chord is complete on the report which releases its last key, so its time is when
+    // that report was read
+    bool
+    in_chord() { return false; }
+
+    void
+    reset();
+
+    void
+    encode( chord_type chord, std::string & data );
+
+    bool
+    serial() { return false; }
+
+private:
+
+    uint8_t      report_[ PLOVER_HID_REPORT_SIZE ];
+    unsigned int report_count_;
+
+    chord_type   chord_;        // Keys pressed since all were last released
+};
+
+}
@@ -0,0 +1,224 @@
+// retranslator.cpp
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "log.h"
+#include "retranslator.h"
+#include "strokes.h"
+#include "translator.h"
+
+
+using namespace stenosys;
+
+namespace stenosys
+{
+
+extern C_log log;
+
+C_retranslate_worker::C_retranslate_worker( const std::vector< std::string > & strokes
+                                          , size_t                             warmup
+                                          , size_t                             begin
+                                          , size_t                             end )
+    : begin_( begin )
+    , end_( end )
+    , start_hash_( 0 )
+    , strokes_( strokes )
+    , warmup_( warmup )
+    , started_( false )
+{
+    translator_ = std::make_unique< C_translator >( AT_LATIN );
+}
+
+// Start translating the chunk on its own thread, or if the thread can't be started,
+// translate it here
+// returns: true if the thread was started
+bool
+C_retranslate_worker::start()
+{
+    started_ = thread_start();
+
+    if ( ! started_ )
+    {
+        thread_handler();
+    }
+
+    return started_;
+}
+
+void
+C_retranslate_worker::wait()
+{
+    if ( started_ )
+    {
+        thread_await_exit();
+    }
+}
+
+// -----------------------------------------------------------------------------------
+// Background thread code
+// -----------------------------------------------------------------------------------
+
+void
+C_retranslate_worker::thread_handler()
+{
+    std::string output;
+
+    translator_->initialise();
+
+    // Bring the alphabet, spacing and paper tape modes into line with a sequential run
+    S_translator_modes modes = { AT_LATIN, SP_BEFORE, false };
+
+    for ( size_t index = 0; index < warmup_; index++ )
+    {
+        C_translator::track_mode( strokes_[ index ], modes );
+    }
+
+    translator_->reset( modes );
+
+    // Warm up the stroke history; output is discarded
+    for ( size_t index = warmup_; index < begin_; index++ )
+    {
+        translator_->translate( strokes_[ index ], output );
+    }
+
+    start_hash_ = translator_->state_hash();
+
+    outputs_.resize( end_ - begin_ );
+    hashes_.resize( end_ - begin_ );
+
+    for ( size_t index = begin_; index < end_; index++ )
+    {
+        translator_->translate( strokes_[ index ], outputs_[ index - begin_ ] );
+
+        hashes_[ index - begin_ ] = translator_->state_hash();
+    }
+}
+
+// -----------------------------------------------------------------------------------
+// Foreground thread code
+// -----------------------------------------------------------------------------------
+
+C_retranslator::C_retranslator()
+    : chunks_( 0 )
+    , resync_strokes_( 0 )
+{
+    lookup_stats_ = { 0, 0, 0, 0 };
+}
+
+C_retranslator::~C_retranslator()
+{
+}
+
+// The number of threads to use for jobs: as given, or if 0 one per online CPU
+unsigned int
+C_retranslator::threads( unsigned int jobs )
+{
+    if ( jobs == 0 )
+    {
+        long cpus = sysconf( _SC_NPROCESSORS_ONLN );
+
+        jobs = ( cpus > 0 ) ? ( unsigned int ) cpus : 1;
+    }
+
+    return jobs;
+}
+
+// jobs: number of threads to use, or 0 to use one per online CPU
+bool
+C_retranslator::retranslate( const std::vector< std::string > & strokes, unsigned int jobs )
+{
+    jobs = threads( jobs );
+
+    size_t chunk_count = std::max< size_t >( 1, std::min< size_t >( jobs, strokes.size() / CHUNK_MIN ) );
+    size_t chunk_size  = ( strokes.size() + chunk_count - 1 ) / chunk_count;
+
+    std::vector< std::unique_ptr< C_retranslate_worker > > workers;
+
+    for ( size_t begin = 0; begin < strokes.size(); begin += chunk_size )
+    {
+        size_t end    = std::min( begin + chunk_size, strokes.size() );
+        size_t warmup = ( begin > HISTORY_MAX ) ? ( begin - HISTORY_MAX ) : 0;
+
+        // The first chunk starts from a clean translator, so needs no warm-up
+        workers.push_back( std::make_unique< C_retranslate_worker >( strokes, ( begin == 0 ) ? 0 : warmup, begin, end ) );
+    }
+
+    for ( auto & worker : workers )
+    {
+        if ( ! worker->start() )
+        {
+            log_writeln( C_log::LL_WARNING, "Failed to start retranslation thread; translated the chunk in the foreground" );
+        }
+    }
+
+    for ( auto & worker : workers )
+    {
+        worker->wait();
+    }
+
+    chunks_         = workers.size();
+    resync_strokes_ = 0;
+
+    // Reconcile the seams. The carrier holds the true (sequential) translator state at the
+    // start of each chunk; if that already matches the chunk's own state there is nothing
+    // to do, otherwise the carrier re-runs strokes into the chunk until the two agree.
+    C_translator * carrier = ( workers.size() > 0 ) ? workers[ 0 ]->translator_.get() : nullptr;
+
+    for ( size_t chunk = 1; chunk < workers.size(); chunk++ )
+    {
+        C_retranslate_worker & worker = *workers[ chunk ];
+
+        bool agreed = ( carrier->state_hash() == worker.start_hash_ );
+
+        for ( size_t index = worker.begin_; ( index < worker.end_ ) && ( ! agreed ); index++ )
+        {
+            size_t offset = index - worker.begin_;
+
+            carrier->translate( strokes[ index ], worker.outputs_[ offset ] );
+
+            resync_strokes_++;
+
+            uint64_t hash = carrier->state_hash();
+
+            agreed = ( hash == worker.hashes_[ offset ] );
+
+            worker.hashes_[ offset ] = hash;
+        }
+
+        if ( agreed )
+        {
+            // From here on the chunk's translator is in step with a sequential run
+            carrier = worker.translator_.get();
+        }
+    }
+
+    lookup_stats_ = { 0, 0, 0, 0 };
+
+    for ( auto & worker : workers )
+    {
+        C_lookup_cache::add_stats( lookup_stats_, worker->translator_->lookup_stats() );
+    }
+
+    outputs_.clear();
+    hashes_.clear();
+
+    outputs_.reserve( strokes.size() );
+    hashes_.reserve( strokes.size() );
+
+    for ( auto & worker : workers )
+    {
+        std::move( worker->outputs_.begin(), worker->outputs_.end(), std::back_inserter( outputs_ ) );
+        hashes_.insert( hashes_.end(), worker->hashes_.begin(), worker->hashes_.end() );
+    }
+
+    return true;
+}
+
+}
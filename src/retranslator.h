@@ -0,0 +1,110 @@
+// retranslator.h
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "thread.h"
+#include "translator.h"
+
+namespace stenosys
+{
+
+// Translates one chunk of a stroke journal on its own thread. The modes set by the mode
+// strokes before the chunk are restored, then translation starts HISTORY_MAX strokes
+// before the chunk (the warm-up) so that the translator's state is close to what a
+// sequential run would have at the chunk start.
+class C_retranslate_worker : public C_thread
+{
+
+public:
+
+    C_retranslate_worker( const std::vector< std::string > & strokes
+                        , size_t                             warmup
+                        , size_t                             begin
+                        , size_t                             end );
+    ~C_retranslate_worker() {}
+
+    bool
+    start();
+
+    void
+    wait();
+
+private:
+
+    void
+    thread_handler();
+
+public:
+
+    size_t begin_;
+    size_t end_;
+
+    uint64_t start_hash_;                       // Translator state at begin_, after the warm-up
+
+    std::vector< std::string > outputs_;        // Output for each stroke in [begin_, end_)
+    std::vector< uint64_t >    hashes_;         // Translator state after each stroke
+
+    std::unique_ptr< C_translator > translator_;
+
+private:
+
+    const std::vector< std::string > & strokes_;
+
+    size_t warmup_;
+
+    bool started_;                              // The chunk is being translated on its own thread
+};
+
+
+// Parallel retranslation of a stroke journal. The journal is split into chunks which are
+// translated concurrently; each seam is then reconciled by carrying the translator that
+// holds the true state at the end of the previous chunk forward until its state agrees
+// with the state recorded by the next chunk's translator.
+class C_retranslator
+{
+
+public:
+
+    C_retranslator();
+    ~C_retranslator();
+
+    bool
+    retranslate( const std::vector< std::string > & strokes, unsigned int jobs );
+
+    std::vector< std::string > &
+    outputs() { return outputs_; }
+
+    std::vector< uint64_t > &
+    hashes() { return hashes_; }
+
+    uint32_t
+    chunks() { return chunks_; }
+
+    uint32_t
+    resync_strokes() { return resync_strokes_; }
+
+    const S_lookup_stats &
+    lookup_stats() { return lookup_stats_; }
+
+    static unsigned int
+    threads( unsigned int jobs );
+
+private:
+
+    std::vector< std::string > outputs_;        // Translator output for each stroke
+    std::vector< uint64_t >    hashes_;         // Translator state after each stroke
+
+    uint32_t chunks_;
+    uint32_t resync_strokes_;                   // Strokes re-run to reconcile chunk seams
+
+    S_lookup_stats lookup_stats_;               // Lookup cache statistics, summed over all threads
+
+    static const size_t CHUNK_MIN = 2048;       // Smallest chunk worth a thread of its own
+};
+
+}
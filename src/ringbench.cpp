@@ -0,0 +1,255 @@
+// ringbench.cpp
+// Microbenchmark of the rings used to pass strokes from the input threads to the main loop:
+// the lock-free single producer, single consumer ring (C_spsc_ring) against the mutex
+// protected ring it replaced (C_buffer).
+//
+// Three measurements for each ring:
+// - Empty: one thread gets from an empty ring, as the main loop does for each idle source
+//   when it reads a stroke.
+// - Uncontended: one thread puts a stroke and gets it back, so the cost of a put and a get
+//   with no other thread touching the ring. Every get() empties the SPSC ring, so this
+//   includes the event the next put() signals, as for a main loop which keeps up with its
+//   input (which clears the event when it wakes, not counted here).
+// - Contended: a producer thread puts strokes as fast as it can while the main thread gets
+//   them, each yielding when the ring is full or empty. The strokes carry a sequence
+//   number, which the consumer checks.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <sched.h>
+#include <time.h>
+#include <vector>
+
+#include "buffer.h"
+#include "latency.h"
+#include "log.h"
+#include "spscring.h"
+#include "thread.h"
+
+
+using namespace stenosys;
+
+namespace stenosys
+{
+
+extern C_log log;
+
+#define RINGBENCH_STROKES   1000000     // Strokes passed per run (default)
+#define RINGBENCH_RUNS      5           // Runs of each measurement; the best is reported
+#define RINGBENCH_LENGTH    64          // Ring length, as for the stroke server
+
+typedef struct
+{
+    double   ns_per_stroke;
+    uint64_t full;                      // Times the producer found the ring full
+    uint64_t empty;                     // Times the consumer found the ring empty
+    bool     in_order;                  // The strokes came out in order (empty: none came out)
+} S_bench_result;
+
+static uint64_t
+now_ns()
+{
+    struct timespec time;
+
+    clock_gettime( CLOCK_MONOTONIC, &time );
+
+    return ( ( uint64_t ) time.tv_sec * 1000000000 ) + time.tv_nsec;
+}
+
+// Puts count strokes, numbered from 0, retrying while the ring is full
+template < class R >
+class C_bench_producer : public C_thread
+{
+
+public:
+
+    C_bench_producer( R & ring, uint32_t count )
+        : full_( 0 )
+        , ring_( ring )
+        , count_( count )
+    {
+    }
+
+    bool
+    start()
+    {
+        return thread_start();
+    }
+
+    void
+    wait()
+    {
+        thread_await_exit();
+    }
+
+    uint64_t full_;
+
+private:
+
+    void
+    thread_handler()
+    {
+        S_steno_stroke stroke = {};
+
+        for ( uint32_t seq = 0; seq < count_; seq++ )
+        {
+            stroke.times.serial_read = seq;
+
+            while ( ! ring_.put( stroke ) )
+            {
+                full_++;
+                sched_yield();
+            }
+        }
+    }
+
+private:
+
+    R &      ring_;
+    uint32_t count_;
+};
+
+template < class R >
+static S_bench_result
+empty( uint32_t count )
+{
+    R              ring;
+    S_steno_stroke stroke = {};
+    S_bench_result result = { 0.0, 0, 0, true };
+
+    uint64_t start = now_ns();
+
+    for ( uint32_t seq = 0; seq < count; seq++ )
+    {
+        result.in_order = result.in_order && ( ! ring.get( stroke ) );
+    }
+
+    result.ns_per_stroke = ( double ) ( now_ns() - start ) / count;
+
+    return result;
+}
+
+template < class R >
+static S_bench_result
+uncontended( uint32_t count )
+{
+    R              ring;
+    S_steno_stroke stroke = {};
+    S_bench_result result = { 0.0, 0, 0, true };
+
+    uint64_t start = now_ns();
+
+    for ( uint32_t seq = 0; seq < count; seq++ )
+    {
+        stroke.times.serial_read = seq;
+
+        ring.put( stroke );
+        ring.get( stroke );
+
+        result.in_order = result.in_order && ( stroke.times.serial_read == seq );
+    }
+
+    result.ns_per_stroke = ( double ) ( now_ns() - start ) / count;
+
+    return result;
+}
+
+template < class R >
+static S_bench_result
+contended( uint32_t count )
+{
+    R                     ring;
+    C_bench_producer< R > producer( ring, count );
+    S_steno_stroke        stroke;
+    S_bench_result        result = { 0.0, 0, 0, true };
+
+    uint64_t start = now_ns();
+
+    if ( ! producer.start() )
+    {
+        log_writeln( C_log::LL_ERROR, "Failed to start producer thread" );
+        result.in_order = false;
+        return result;
+    }
+
+    for ( uint32_t seq = 0; seq < count; seq++ )
+    {
+        while ( ! ring.get( stroke ) )
+        {
+            result.empty++;
+            sched_yield();
+        }
+
+        result.in_order = result.in_order && ( stroke.times.serial_read == seq );
+    }
+
+    producer.wait();
+
+    result.ns_per_stroke = ( double ) ( now_ns() - start ) / count;
+    result.full          = producer.full_;
+
+    return result;
+}
+
+// The fastest of several runs, i.e. the one least disturbed by other processes
+static S_bench_result
+best( S_bench_result ( *measure )( uint32_t ), uint32_t count )
+{
+    S_bench_result best_result = measure( count );
+
+    for ( int run = 1; run < RINGBENCH_RUNS; run++ )
+    {
+        S_bench_result result = measure( count );
+
+        if ( result.ns_per_stroke < best_result.ns_per_stroke )
+        {
+            best_result = result;
+        }
+
+        best_result.in_order = best_result.in_order && result.in_order;
+    }
+
+    return best_result;
+}
+
+static void
+report( const char * name, const S_bench_result & result )
+{
+    log_writeln_fmt( C_log::LL_INFO, "%-24s: %8.1f ns/stroke %10lu full %10lu empty%s"
+                   , name
+                   , result.ns_per_stroke
+                   , ( unsigned long ) result.full
+                   , ( unsigned long ) result.empty
+                   , result.in_order ? "" : "  OUT OF ORDER" );
+}
+
+}
+
+/** \brief main function
+
+    Run the ring benchmark
+
+    @param[in]      argc: Number of parameters
+    @param[in]      argv: Array of parameter strings: [strokes per run]
+*/
+int main( int argc, char *argv[] )
+{
+    stenosys::log.initialise( C_log::LL_INFO, false );
+
+    uint32_t count = ( argc > 1 ) ? ( uint32_t ) std::max( atoi( argv[ 1 ] ), 1 ) : RINGBENCH_STROKES;
+
+    typedef C_spsc_ring< S_steno_stroke, RINGBENCH_LENGTH > spsc_ring;
+    typedef C_buffer< S_steno_stroke, RINGBENCH_LENGTH >    mutex_ring;
+
+    log_writeln_fmt( C_log::LL_INFO, "Strokes per run         : %u (best of %d runs), ring length %d", count, RINGBENCH_RUNS, RINGBENCH_LENGTH );
+
+    report( "Empty, SPSC ring",        best( empty< spsc_ring >,        count ) );
+    report( "Empty, mutex ring",       best( empty< mutex_ring >,       count ) );
+    report( "Uncontended, SPSC ring",  best( uncontended< spsc_ring >,  count ) );
+    report( "Uncontended, mutex ring", best( uncontended< mutex_ring >, count ) );
+    report( "Contended, SPSC ring",    best( contended< spsc_ring >,    count ) );
+    report( "Contended, mutex ring",   best( contended< mutex_ring >,   count ) );
+
+    return 0;
+}
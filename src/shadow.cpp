@@ -0,0 +1,277 @@
+// shadow.cpp
+
+#include <algorithm>
+#include <cctype>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "formatter.h"
+#include "shadow.h"
+#include "stenoflags.h"
+#include "stroke.h"
+
+
+using namespace stenosys;
+
+namespace stenosys
+{
+
+C_shadow::C_shadow()
+    : marked_( false )
+{
+}
+
+C_shadow::~C_shadow()
+{
+}
+
+// Number of UTF-8 characters in a string (counts lead bytes)
+static size_t
+characters( const std::string & str )
+{
+    size_t count = 0;
+
+    for ( char ch : str )
+    {
+        if ( ( ch & 0xc0 ) != 0x80 )
+        {
+            count++;
+        }
+    }
+
+    return count;
+}
+
+// Replace the output of the earlier strokes of a group (most recent first) and append the
+// group's text, recording the edit against stroke. If retract_space is set, a trailing
+// space left by the stroke before the group is removed (space-after mode). format_last
+// holds any retroactive flags to apply to the word before the group.
+std::string
+C_shadow::edit( const std::vector< C_stroke * > & group
+              , bool                              retract_space
+              , uint16_t                          format_last
+              , const std::string &               text
+              , C_stroke &                        stroke )
+{
+    // Rebuild the text as it was before the group began. It is held as text_ up to
+    // 'from', followed by 'tail'.
+    size_t      from = text_.length();
+    std::string tail;
+
+    for ( C_stroke * member : group )
+    {
+        size_t inserted = member->inserted();
+
+        if ( inserted <= tail.length() )
+        {
+            tail.resize( tail.length() - inserted );
+        }
+        else
+        {
+            from -= std::min( inserted - tail.length(), from );
+            tail.clear();
+        }
+
+        tail += member->replaced();
+    }
+
+    if ( retract_space )
+    {
+        if ( ( tail.length() == 0 ) && ( from > 0 ) )
+        {
+            // Step back over the last character
+            do
+            {
+                from--;
+            } while ( ( from > 0 ) && ( ( text_[ from ] & 0xc0 ) == 0x80 ) );
+
+            tail = text_.substr( from );
+        }
+
+        if ( ( tail.length() > 0 ) && ( tail.back() == ' ' ) )
+        {
+            tail.pop_back();
+        }
+    }
+
+    if ( format_last != 0 )
+    {
+        last_word( format_last, from, tail );
+    }
+
+    std::string replaced;
+    uint32_t    inserted = 0;
+
+    std::string output = transition( from, tail + text, replaced, inserted );
+
+    stroke.replaced( replaced );
+    stroke.inserted( inserted );
+
+    return output;
+}
+
+// Reverse the edit made by stroke
+std::string
+C_shadow::undo( C_stroke & stroke )
+{
+    std::string replaced;
+    uint32_t    inserted = 0;
+
+    size_t from = text_.length() - std::min< size_t >( stroke.inserted(), text_.length() );
+
+    return transition( from, stroke.replaced(), replaced, inserted );
+}
+
+// Remember the current text, so that the net effect of several edits can be found
+void
+C_shadow::mark()
+{
+    mark_   = text_;
+    marked_ = true;
+}
+
+// The minimal edit (backspaces, then text) from the text at the mark to the current text.
+// Clears the mark.
+std::string
+C_shadow::since_mark()
+{
+    size_t common = 0;
+    size_t limit  = std::min( mark_.length(), text_.length() );
+
+    while ( ( common < limit ) && ( mark_[ common ] == text_[ common ] ) )
+    {
+        common++;
+    }
+
+    while ( ( common > 0 ) && ( ( ( mark_[ common ] & 0xc0 ) == 0x80 ) || ( ( text_[ common ] & 0xc0 ) == 0x80 ) ) )
+    {
+        common--;
+    }
+
+    std::string output( characters( mark_.substr( common ) ), '\b' );
+
+    output.append( text_, common, std::string::npos );
+
+    mark_.clear();
+    marked_ = false;
+
+    trim();
+
+    return output;
+}
+
+// Forget all text, as for a new shadow
+void
+C_shadow::reset()
+{
+    text_.clear();
+    mark_.clear();
+
+    marked_ = false;
+}
+
+// FNV-1a hash of the last reach bytes of the text
+uint64_t
+C_shadow::hash( size_t reach )
+{
+    uint64_t hash = 0xcbf29ce484222325;
+
+    for ( size_t ii = text_.length() - std::min( reach, text_.length() ); ii < text_.length(); ii++ )
+    {
+        hash = ( hash ^ ( uint8_t ) text_[ ii ] ) * 0x100000001b3;
+    }
+
+    return hash;
+}
+
+// Replace the text from byte offset 'from' with target, keeping any common prefix.
+// Returns the backspaces and text needed to make the change.
+std::string
+C_shadow::transition( size_t from, const std::string & target, std::string & replaced, uint32_t & inserted )
+{
+    size_t common = 0;
+    size_t limit  = std::min( text_.length() - from, target.length() );
+
+    while ( ( common < limit ) && ( text_[ from + common ] == target[ common ] ) )
+    {
+        common++;
+    }
+
+    // Back up to the start of a UTF-8 character
+    while ( ( common > 0 ) && ( ( ( target[ common ] & 0xc0 ) == 0x80 ) ||
+                                ( ( text_[ from + common ] & 0xc0 ) == 0x80 ) ) )
+    {
+        common--;
+    }
+
+    replaced = text_.substr( from + common );
+    inserted = target.length() - common;
+
+    std::string output( characters( replaced ), '\b' );
+
+    output.append( target, common, std::string::npos );
+
+    text_.resize( from + common );
+    text_.append( target, common, std::string::npos );
+
+    trim();
+
+    return output;
+}
+
+// Reformat the last word of the text (text_ up to 'from', followed by tail). The start of
+// the tail is moved back to the start of the word if need be, so the work done depends
+// only on the length of the word.
+void
+C_shadow::last_word( uint16_t flags, size_t & from, std::string & tail )
+{
+    size_t end = from + tail.length();
+
+    while ( ( end > 0 ) && isspace( ( uint8_t ) at( end - 1, from, tail ) ) )
+    {
+        end--;
+    }
+
+    size_t begin = end;
+
+    while ( ( begin > 0 ) && ( ! isspace( ( uint8_t ) at( begin - 1, from, tail ) ) ) )
+    {
+        begin--;
+    }
+
+    if ( begin < from )
+    {
+        tail.insert( 0, text_, begin, from - begin );
+        from = begin;
+    }
+
+    C_formatter::format_last( flags, tail, begin - from, end - from );
+}
+
+// Character at position pos of the text held as text_ up to 'from', followed by tail
+char
+C_shadow::at( size_t pos, size_t from, const std::string & tail )
+{
+    return ( pos < from ) ? text_[ pos ] : tail[ pos - from ];
+}
+
+// Discard the oldest text, keeping whole UTF-8 characters
+void
+C_shadow::trim()
+{
+    if ( ( text_.length() > SHADOW_MAX ) && ( ! marked_ ) )
+    {
+        size_t discard = text_.length() - ( SHADOW_MAX / 2 );
+
+        while ( ( discard < text_.length() ) && ( ( text_[ discard ] & 0xc0 ) == 0x80 ) )
+        {
+            discard++;
+        }
+
+        text_.erase( 0, discard );
+    }
+}
+
+}
@@ -0,0 +1,74 @@
+// shadow.h
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace stenosys
+{
+
+class C_stroke;
+
+#define SHADOW_MAX 4096     // Shadow text is trimmed back to half this once it grows beyond it
+
+// A shadow copy of the tail of the text emitted so far. Each stroke records the edit it
+// made (the text it replaced and the number of bytes it inserted), so the text as it was
+// before any stroke still in the history can be recovered. The output for a stroke is
+// the minimal edit, backspaces then text, from the current text to the new text.
+class C_shadow
+{
+
+public:
+
+    C_shadow();
+    ~C_shadow();
+
+    std::string
+    edit( const std::vector< C_stroke * > & group
+        , bool                              retract_space
+        , uint16_t                          format_last
+        , const std::string &               text
+        , C_stroke &                        stroke );
+
+    std::string
+    undo( C_stroke & stroke );
+
+    uint64_t
+    hash( size_t reach );
+
+    void
+    reset();
+
+    void
+    mark();
+
+    std::string
+    since_mark();
+
+    const std::string &
+    text() { return text_; }
+
+private:
+
+    std::string
+    transition( size_t from, const std::string & target, std::string & replaced, uint32_t & inserted );
+
+    void
+    last_word( uint16_t flags, size_t & from, std::string & tail );
+
+    char
+    at( size_t pos, size_t from, const std::string & tail );
+
+    void
+    trim();
+
+private:
+
+    std::string text_;
+    std::string mark_;          // Text at the mark
+    bool        marked_;        // Mark set; text is not trimmed until it is cleared
+};
+
+}
@@ -0,0 +1,231 @@
+// spscring.h
+// Lock-free ring buffer for passing data from one thread to another
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <poll.h>
+
+#include "event.h"
+
+namespace stenosys
+{
+
+#define CACHE_LINE_SIZE 64
+
+// Single producer, single consumer ring buffer. Only one thread may put to it and only one
+// (other) thread may get from it. The producer and consumer indices are kept on separate
+// cache lines, each with a cached copy of the other side's index, so that the threads only
+// touch each other's cache lines when the ring looks full or empty.
+//
+// A consumer with nothing to do can sleep until there is data, either in wait() or by
+// waiting on event_fd() with poll() or epoll. A get() which empties the ring (or finds it
+// empty) asks the producer to signal the event on its next put; the producer doesn't
+// otherwise make any system calls, and get() makes none. The consumer must only sleep once
+// it has seen the ring empty, as the event may not be signalled for data which is left in
+// it. The event is cleared on the sleep path, when the consumer wakes: by wait(), or by
+// whatever waits on event_fd() (C_event_loop::add_event()), before the consumer gets.
+template < class T, int L >
+class C_spsc_ring
+{
+    static_assert( ( L > 0 ) && ( ( L & ( L - 1 ) ) == 0 ), "Ring length must be a power of two" );
+
+public:
+
+    C_spsc_ring()
+        : head_( 0 )
+        , tail_cache_( 0 )
+        , tail_( 0 )
+        , head_cache_( 0 )
+        , waiting_( true )      // The consumer may be waiting before it first reads
+    {
+    }
+
+    ~C_spsc_ring()
+    {
+    }
+
+    // Producer
+
+    bool
+    put( const T & data )
+    {
+        return put_n( &data, 1 ) == 1;
+    }
+
+    // returns: the number of items put, which is less than count if the ring fills up
+    int
+    put_n( const T * data, int count )
+    {
+        uint32_t tail = tail_.load( std::memory_order_relaxed );
+
+        if ( ( tail - head_cache_ ) + count > ( uint32_t ) L )
+        {
+            head_cache_ = head_.load( std::memory_order_acquire );
+        }
+
+        uint32_t space = L - ( tail - head_cache_ );
+
+        if ( ( uint32_t ) count > space )
+        {
+            count = space;
+        }
+
+        for ( int ii = 0; ii < count; ii++ )
+        {
+            buffer_[ ( tail + ii ) & ( L - 1 ) ] = data[ ii ];
+        }
+
+        tail_.store( tail + count, std::memory_order_release );
+
+        if ( count > 0 )
+        {
+            wake();
+        }
+
+        return count;
+    }
+
+    // returns: room for at least this many more items
+    int
+    space()
+    {
+        return L - count();
+    }
+
+    // Wake the consumer whether or not there is data, e.g. to have it check for a stop
+    // request. Waking clears this wakeup along with any other, so the consumer must check
+    // whatever it was told about (the stop flag) after waking, and the producer must set it
+    // before calling notify().
+    void
+    notify()
+    {
+        event_.signal();
+    }
+
+    // Consumer
+
+    bool
+    get( T & data )
+    {
+        return get_n( &data, 1 ) == 1;
+    }
+
+    // returns: the number of items got, which is less than count if the ring empties
+    int
+    get_n( T * data, int count )
+    {
+        uint32_t head = head_.load( std::memory_order_relaxed );
+
+        if ( tail_cache_ - head <= ( uint32_t ) count )
+        {
+            tail_cache_ = tail_.load( std::memory_order_acquire );
+
+            if ( tail_cache_ - head <= ( uint32_t ) count )
+            {
+                // This will empty the ring: ask for a wakeup on the next put (if not
+                // already asked), then look again in case the producer put more without
+                // seeing the request
+                arm();
+
+                tail_cache_ = tail_.load( std::memory_order_acquire );
+            }
+        }
+
+        uint32_t available = tail_cache_ - head;
+
+        if ( ( uint32_t ) count > available )
+        {
+            count = available;
+        }
+
+        for ( int ii = 0; ii < count; ii++ )
+        {
+            data[ ii ] = buffer_[ ( head + ii ) & ( L - 1 ) ];
+        }
+
+        head_.store( head + count, std::memory_order_release );
+
+        return count;
+    }
+
+    int
+    count()
+    {
+        return tail_.load( std::memory_order_acquire ) - head_.load( std::memory_order_acquire );
+    }
+
+    // Readable when the ring may have data which the consumer hasn't seen, or notify() has
+    // been called
+    int
+    event_fd()
+    {
+        return event_.fd();
+    }
+
+    // Sleep until there may be data, or for timeout_ms (-1: no timeout; 0: don't sleep,
+    // just clear the event)
+    // returns: true if there is data
+    bool
+    wait( int timeout_ms )
+    {
+        struct pollfd poll_fd = { event_.fd(), POLLIN, 0 };
+
+        if ( count() == 0 )
+        {
+            poll( &poll_fd, 1, timeout_ms );
+        }
+
+        event_.clear();
+
+        return count() > 0;
+    }
+
+private:
+
+    // The fence pairs with the one in wake(): at least one side sees the other's store, so
+    // either the consumer finds the new data or the producer signals. While the request is
+    // still set the fence which followed setting it does the same job, so a get() from an
+    // empty ring (e.g. an idle source polled by a busy consumer) touches nothing shared but
+    // the producer's index.
+    void
+    arm()
+    {
+        if ( ! waiting_.load( std::memory_order_relaxed ) )
+        {
+            waiting_.store( true, std::memory_order_relaxed );
+
+            std::atomic_thread_fence( std::memory_order_seq_cst );
+        }
+    }
+
+    void
+    wake()
+    {
+        std::atomic_thread_fence( std::memory_order_seq_cst );
+
+        if ( waiting_.load( std::memory_order_relaxed ) && waiting_.exchange( false, std::memory_order_relaxed ) )
+        {
+            event_.signal();
+        }
+    }
+
+private:
+
+    // Consumer's cache line
+    alignas( CACHE_LINE_SIZE ) std::atomic< uint32_t > head_;
+    uint32_t                                           tail_cache_;
+
+    // Producer's cache line
+    alignas( CACHE_LINE_SIZE ) std::atomic< uint32_t > tail_;
+    uint32_t                                           head_cache_;
+
+    alignas( CACHE_LINE_SIZE ) std::atomic< bool >     waiting_;
+
+    alignas( CACHE_LINE_SIZE ) T                       buffer_[ L ];
+
+    C_event event_;
+};
+
+}
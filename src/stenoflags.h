@@ -19,6 +19,9 @@ const uint16_t LOWERCASE_LAST_WORD  = 0x0200;
 const uint16_t GLUE                 = 0x0400;
 const uint16_t NAMING_DOT           = 0x0800;   // Shavian only
 
+// Flags which reformat the previous word
+const uint16_t FORMAT_LAST          = CAPITALISE_LAST | LOWERCASE_LAST | UPPERCASE_LAST_WORD | LOWERCASE_LAST_WORD;
+
 enum space_type    { SP_NONE, SP_BEFORE, SP_AFTER };
 enum alphabet_type { AT_LATIN, AT_SHAVIAN };
 
@@ -2,7 +2,8 @@
 // Class for inputting keypresses from a keyboard, typically running the QMK firmware
 // This class supports:
 // - Keypresses direct from the keyboard (normal typing, USB HID)
-// - Steno packets in GeminiPR format (steno layer enabled on the keyboard, serial over USB)
+// - Steno packets in GeminiPR format (steno layer enabled on the keyboard, serial over USB),
+//   from any number of steno machines
 //
 #include <iostream>
 
@@ -30,8 +31,7 @@ extern C_log log;
 
 C_steno_keyboard::C_steno_keyboard()
 {
-    raw_   = std::make_unique< C_kbd_raw >();
-    steno_ = std::make_unique< C_kbd_steno>();
+    raw_ = std::make_unique< C_kbd_raw >();
 }
 
 C_steno_keyboard::~C_steno_keyboard()
@@ -44,34 +44,108 @@ C_steno_keyboard::~C_steno_keyboard()
 // -----------------------------------------------------------------------------------
 
 bool
-C_steno_keyboard::initialise( const std::string & device_raw, const std::string & device_steno )
+C_steno_keyboard::initialise( const std::string &                   device_raw
+                            , const std::vector< S_steno_device > & devices_steno
+                            , bool                                  low_latency
+                            , chord_mode_t                          chord_mode )
 {
-    return raw_->initialise( device_raw) && steno_->initialise( device_steno );
+    bool worked = raw_->initialise( device_raw, chord_mode );
+
+    for ( const S_steno_device & device_steno : devices_steno )
+    {
+        steno_.push_back( std::make_unique< C_kbd_steno >() );
+
+        worked = worked && steno_.back()->initialise( device_steno.path, device_steno.protocol, low_latency );
+
+        sources_.push_back( steno_.back().get() );
+    }
+
+    if ( chord_mode != CM_OFF )
+    {
+        sources_.push_back( raw_.get() );
+    }
+
+    next_.resize( sources_.size() );
+    next_valid_.assign( sources_.size(), false );
+
+    return worked;
+}
+
+// Add a stroke source run by the caller (e.g. the network stroke server), to be merged with
+// the steno machines. Call before reading.
+void
+C_steno_keyboard::add_source( C_stroke_source * source )
+{
+    sources_.push_back( source );
+
+    next_.resize( sources_.size() );
+    next_valid_.assign( sources_.size(), false );
 }
 
 bool
 C_steno_keyboard::start()
 {
-    return raw_->start() && steno_->start();
+    bool worked = raw_->start();
+
+    for ( std::unique_ptr< C_kbd_steno > & steno : steno_ )
+    {
+        worked = worked && steno->start();
+    }
+
+    return worked;
 }
 
 void
 C_steno_keyboard::stop()
 {
     raw_->stop();
-    steno_->stop();
+
+    for ( std::unique_ptr< C_kbd_steno > & steno : steno_ )
+    {
+        steno->stop();
+    }
 }
 
 bool
-C_steno_keyboard::read( key_event_t & key_event, uint8_t & scancode )
+C_steno_keyboard::read( key_event_t & key_event, uint8_t & scancode, uint64_t & time )
 {
-    return raw_->read( key_event, scancode );
+    return raw_->read( key_event, scancode, time );
 }
     
+// Read the next stroke from any of the sources: the one which was read from its device
+// first, of those at the head of each source's queue. Strokes from one source stay in
+// order, as each source's queue is.
 bool
-C_steno_keyboard::read( S_geminipr_packet & packet  )
+C_steno_keyboard::read( S_geminipr_packet & packet, S_stroke_times & times )
 {
-    return steno_->read( packet );
+    size_t first = sources_.size();
+
+    for ( size_t source = 0; source < sources_.size(); source++ )
+    {
+        if ( ! next_valid_[ source ] )
+        {
+            next_valid_[ source ] = sources_[ source ]->read_stroke( next_[ source ] );
+        }
+
+        if ( next_valid_[ source ] &&
+             ( ( first == sources_.size() ) || ( next_[ source ].times.serial_read < next_[ first ].times.serial_read ) ) )
+        {
+            first = source;
+        }
+    }
+
+    if ( first == sources_.size() )
+    {
+        return false;
+    }
+
+    next_valid_[ first ] = false;
+
+    packet       = next_[ first ].packet;
+    times        = next_[ first ].times;
+    times.source = first;
+
+    return true;
 }
 
 bool
@@ -80,4 +154,31 @@ C_steno_keyboard::acquired()
     return raw_->acquired();
 }
 
+size_t
+C_steno_keyboard::sources()
+{
+    return sources_.size();
+}
+
+std::string
+C_steno_keyboard::source_name( size_t source )
+{
+    return sources_[ source ]->stroke_source_name();
+}
+
+// An eventfd, signalled when strokes from the source may be waiting to be read
+int
+C_steno_keyboard::source_event_fd( size_t source )
+{
+    return sources_[ source ]->stroke_event_fd();
+}
+
+// An eventfd, signalled when key events may be waiting to be read, or when the raw
+// keyboard has been (re)acquired
+int
+C_steno_keyboard::raw_event_fd()
+{
+    return raw_->event_fd();
+}
+
 }
@@ -5,15 +5,23 @@
 #include <memory>
 #include <string>
 #include <termios.h>
+#include <vector>
 
 #include "geminipr.h"
 #include "kbdraw.h"
 #include "kbdsteno.h"
 #include "keyevent.h"
+#include "stenoprotocol.h"
+#include "strokesource.h"
 
 namespace stenosys
 {
 
+// The raw keyboard, and any number of steno machines (e.g. a primary and a backup, both
+// plugged in). Every steno machine, and the raw keyboard if it is used for steno, is a
+// stroke source with its own thread and queue; their strokes are merged into one stream
+// for the translator in the order in which they were read from their devices. A machine
+// which is unplugged doesn't hold up the others.
 class C_steno_keyboard
 {
 
@@ -24,7 +32,13 @@ public:
     ~C_steno_keyboard();
 
     bool
-    initialise( const std::string & device_raw, const std::string & device_steno );
+    initialise( const std::string &                   device_raw
+              , const std::vector< S_steno_device > & devices_steno
+              , bool                                  low_latency
+              , chord_mode_t                          chord_mode );
+
+    void
+    add_source( C_stroke_source * source );
 
     bool
     start();
@@ -33,18 +47,36 @@ public:
     stop();
 
     bool
-    read( key_event_t & key_event, uint8_t & scancode );
+    read( key_event_t & key_event, uint8_t & scancode, uint64_t & time );
     
     bool
-    read( S_geminipr_packet & packet );
+    read( S_geminipr_packet & packet, S_stroke_times & times );
     
     bool
     acquired();
 
+    size_t
+    sources();
+
+    std::string
+    source_name( size_t source );
+
+    int
+    source_event_fd( size_t source );
+
+    int
+    raw_event_fd();
+
 private:
     
-    std::unique_ptr< C_kbd_raw >   raw_;
-    std::unique_ptr< C_kbd_steno > steno_;
+    std::unique_ptr< C_kbd_raw > raw_;
+
+    std::vector< std::unique_ptr< C_kbd_steno > > steno_;
+
+    std::vector< C_stroke_source * > sources_;
+
+    std::vector< S_steno_stroke > next_;        // The oldest stroke of each source, read ahead
+    std::vector< bool >           next_valid_;  // so that the sources can be merged in order
 };
 
 }
@@ -0,0 +1,117 @@
+// stenoprotocol.cpp
+
+#include <memory>
+#include <string>
+
+#include "geminipr.h"
+#include "log.h"
+#include "ploverhid.h"
+#include "stenoprotocol.h"
+#include "txbolt.h"
+
+
+using namespace stenosys;
+
+namespace stenosys
+{
+
+extern C_log log;
+
+std::unique_ptr< C_steno_protocol >
+C_steno_protocol::create( steno_protocol_t protocol )
+{
+    switch ( protocol )
+    {
+        case SP_TX_BOLT:    return std::make_unique< C_tx_bolt_protocol >();
+        case SP_PLOVER_HID: return std::make_unique< C_plover_hid_protocol >();
+        default:            return std::make_unique< C_gemini_pr_protocol >();
+    }
+}
+
+// name: as in the configuration, e.g. "txbolt"
+bool
+C_steno_protocol::parse( const std::string & name, steno_protocol_t & protocol )
+{
+    if ( name == "geminipr" )
+    {
+        protocol = SP_GEMINI_PR;
+    }
+    else if ( name == "txbolt" )
+    {
+        protocol = SP_TX_BOLT;
+    }
+    else if ( name == "hid" )
+    {
+        protocol = SP_PLOVER_HID;
+    }
+    else
+    {
+        return false;
+    }
+
+    return true;
+}
+
+const char *
+C_steno_protocol::name( steno_protocol_t protocol )
+{
+    switch ( protocol )
+    {
+        case SP_TX_BOLT:    return "txbolt";
+        case SP_PLOVER_HID: return "hid";
+        default:            return "geminipr";
+    }
+}
+
+C_gemini_pr_protocol::C_gemini_pr_protocol()
+    : packet_count_( 0 )
+{
+}
+
+bool
+C_gemini_pr_protocol::decode( uint8_t byte, chord_type & chord )
+{
+    if ( packet_count_ == 0 )
+    {
+        // Packet header has top bit set
+        if ( byte & 0x80 )
+        {
+            packet_[ packet_count_++ ] = byte;
+        }
+
+        return false;
+    }
+
+    // Rest of packet bytes must have the top bit as zero
+    if ( byte & 0x80 )
+    {
+        log_writeln( C_log::LL_ERROR, "Invalid steno packet" );
+
+        packet_count_ = 0;
+        return false;
+    }
+
+    packet_[ packet_count_++ ] = byte;
+
+    if ( packet_count_ < BYTES_PER_STROKE )
+    {
+        return false;
+    }
+
+    chord         = C_gemini_pr::chord( packet_ );
+    packet_count_ = 0;
+
+    return true;
+}
+
+void
+C_gemini_pr_protocol::encode( chord_type chord, std::string & data )
+{
+    S_geminipr_packet packet;
+
+    C_gemini_pr::encode( chord, packet );
+
+    data.append( ( const char * ) packet.data, sizeof( packet.data ) );
+}
+
+}
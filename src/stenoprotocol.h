@@ -0,0 +1,124 @@
+// stenoprotocol.h
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <termios.h>
+
+#include "chord.h"
+#include "geminipr.h"
+
+namespace stenosys
+{
+
+// The protocols a steno machine can use
+enum steno_protocol_t
+{
+    SP_GEMINI_PR        // 6-byte packets over serial
+,   SP_TX_BOLT          // 1 to 4 bytes per stroke over serial
+,   SP_PLOVER_HID       // HID reports of the keys held, read from a hidraw device
+};
+
+// A steno machine's device, and the protocol it uses
+struct S_steno_device
+{
+    std::string      path;
+    steno_protocol_t protocol;
+};
+
+// Decodes the data a steno machine sends into chords, and encodes chords the same way (for
+// stenosys-synth). The data is fed to the decoder as it is read from the device, a byte at
+// a time. Protocols with no end of stroke marker are also told, by end_of_input(), when
+// nothing more has arrived within their byte timeout of a partly decoded chord.
+class C_steno_protocol
+{
+
+public:
+
+    virtual
+    ~C_steno_protocol() {}
+
+    static std::unique_ptr< C_steno_protocol >
+    create( steno_protocol_t protocol );
+
+    static bool
+    parse( const std::string & name, steno_protocol_t & protocol );
+
+    static const char *
+    name( steno_protocol_t protocol );
+
+    // returns: true if the byte completes a chord, and chord is set to it
+    virtual bool
+    decode( uint8_t byte, chord_type & chord ) = 0;
+
+    // No byte has arrived within byte_timeout_ms() of the last one of a partly decoded chord.
+    // Protocols with no end of stroke marker complete the chord here.
+    // returns: true if a chord is complete, and chord is set to it
+    virtual bool
+    end_of_input( chord_type & chord ) { return false; }
+
+    // Longest gap between the bytes of a stroke, or 0 if the protocol marks the end of its
+    // strokes itself
+    virtual unsigned int
+    byte_timeout_ms() { return 0; }
+
+    // Part of a chord has been decoded: the chord's bytes started arriving in an earlier read
+    virtual bool
+    in_chord() = 0;
+
+    // Discard any partly decoded chord, e.g. when the device has been reopened
+    virtual void
+    reset() = 0;
+
+    // Append the data the machine sends for a chord
+    virtual void
+    encode( chord_type chord, std::string & data ) = 0;
+
+    // Serial devices have their line settings set; others (hidraw) are just read
+    virtual bool
+    serial() { return true; }
+
+    virtual speed_t
+    baud_rate() { return B9600; }
+
+    // Bytes to wait for before the device is reported readable (the serial VMIN setting):
+    // as many as the shortest stroke
+    virtual unsigned int
+    read_min() { return 1; }
+};
+
+// GeminiPR: six bytes per stroke, the first with its top bit set
+class C_gemini_pr_protocol : public C_steno_protocol
+{
+
+public:
+
+    C_gemini_pr_protocol();
+    ~C_gemini_pr_protocol() {}
+
+    bool
+    decode( uint8_t byte, chord_type & chord );
+
+    bool
+    in_chord() { return packet_count_ > 0; }
+
+    void
+    reset() { packet_count_ = 0; }
+
+    void
+    encode( chord_type chord, std::string & data );
+
+    speed_t
+    baud_rate() { return B19200; }
+
+    unsigned int
+    read_min() { return BYTES_PER_STROKE; }
+
+private:
+
+    S_geminipr_packet packet_;
+    unsigned int      packet_count_;
+};
+
+}
@@ -25,20 +25,29 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 
 #include <memory>
 #include <string>
+#include <sys/resource.h>
+#include <time.h>
 #include <unistd.h>
+#include <vector>
 
 #include "config.h"
 #include "device.h"
 #include "dictsearch.h"
+#include "eventloop.h"
 #include "geminipr.h"
 #include "keyboard.h"
 #include "keyevent.h"
+#include "keystrokes.h"
+#include "latency.h"
 #include "log.h"
 #include "miscellaneous.h"
 #include "papertape.h"
 #include "stenokeyboard.h"
 #include "stenosys.h"
 #include "strokefeed.h"
+#include "strokeserver.h"
+#include "timer.h"
+#include "transcriber.h"
 #include "translator.h"
 #include "x11output.h"
 
@@ -53,6 +62,15 @@ extern C_log      log;
 
 const char * VERSION = "0.90";
 
+const size_t BATCH_MAX = 16;    // Most queued chords translated as one batch (the steno keyboard's buffer size)
+
+const int CONSOLE_POLL_MS = 100; // Abort key check interval if the console can't be waited on
+
+const chord_type DUMP_CHORD = KEY_NUM | KEY__D;    // The translator's dump stroke (#-D) also logs the stroke latencies
+
+// Event loop sources
+enum event_source_t { ES_STENO, ES_RAW, ES_CONSOLE };
+
 C_stenosys::C_stenosys()
 {
 }
@@ -79,6 +97,13 @@ C_stenosys::run( int argc, char *argv[] )
 
     log.initialise( ( C_log::eLogLevel ) cfg.c().display_verbosity, cfg.c().display_datetime );
 
+    if ( cfg.c().file_transcribe.length() > 0 )
+    {
+        // Headless mode: no X Window system or keyboard devices required
+        transcribe( cfg.c().file_transcribe, cfg.c().file_output, cfg.c().jobs, cfg.c().defines );
+        return;
+    }
+
     C_keyboard kbd;
 
     const char * device_raw = cfg.c().device_raw.c_str();
@@ -88,7 +113,15 @@ C_stenosys::run( int argc, char *argv[] )
     log_writeln_fmt( C_log::LL_INFO, "Stenosys date   : %s", __DATE__ );
     log_writeln_fmt( C_log::LL_INFO, "Dictionary path : %s", strlen( dict_path ) > 0  ? dict_path  : "<none>" );
     log_writeln_fmt( C_log::LL_INFO, "Raw device      : %s", strlen( device_raw ) > 0 ? device_raw : "auto-detect" ); 
-    log_writeln_fmt( C_log::LL_INFO, "Steno device    : %s", cfg.c().device_steno.c_str() );
+
+    for ( const S_steno_device & device_steno : cfg.c().devices_steno )
+    {
+        log_writeln_fmt( C_log::LL_INFO, "Steno device    : %s (%s)", device_steno.path.c_str(), C_steno_protocol::name( device_steno.protocol ) );
+    }
+
+    log_writeln_fmt( C_log::LL_INFO, "Raw steno       : %s", ( cfg.c().raw_steno == CM_FIRST_UP ) ? "first up"
+                                                         : ( cfg.c().raw_steno == CM_ALL_UP )   ? "all up"
+                                                         :                                        "off" );
 
     // Allow time for the key up event to occur when enter was pressed to execute this program
     delay( 1000 );
@@ -98,6 +131,8 @@ C_stenosys::run( int argc, char *argv[] )
     std::unique_ptr< C_x11_output> outputter = std::make_unique< C_x11_output >();
     
     worked = worked && outputter->initialise();
+
+    outputter->key_delay( cfg.c().key_delay );
     
     if ( ! worked )
     {
@@ -109,8 +144,20 @@ C_stenosys::run( int argc, char *argv[] )
     C_translator        translator( AT_LATIN );
     C_paper_tape        paper_tape;
     C_dictionary_search dictionary_search;
+    C_latency_stats     latency_stats;
+    C_stroke_server     stroke_server;         // Strokes from remote steno machines
+
+    worked = worked && steno_keyboard.initialise( cfg.c().device_raw, cfg.c().devices_steno, cfg.c().low_latency, cfg.c().raw_steno );
 
-    worked = worked && steno_keyboard.initialise( cfg.c().device_raw, cfg.c().device_steno );
+    bool remote_steno = ( cfg.c().stroke_port > 0 ) || ( cfg.c().stroke_socket.length() > 0 );
+
+    if ( remote_steno )
+    {
+        worked = worked && stroke_server.initialise( cfg.c().stroke_port, cfg.c().stroke_address, cfg.c().stroke_socket );
+        worked = worked && stroke_server.start();
+
+        steno_keyboard.add_source( &stroke_server );
+    }
 
     //worked = worked && stroke_feed.initialise( "./stenotext/alice.steno" );    //TEST
     //worked = worked && stroke_feed.initialise( "./stenotext/test.steno" );     //TEST
@@ -124,58 +171,162 @@ C_stenosys::run( int argc, char *argv[] )
 
     worked = worked && dictionary_search.initialise( 6668 );
     worked = worked && dictionary_search.start();
+
+    std::vector< std::string > source_names;
+
+    for ( size_t source = 0; source < steno_keyboard.sources(); source++ )
+    {
+        source_names.push_back( steno_keyboard.source_name( source ) );
+    }
+
+    worked = worked && latency_stats.initialise( 6670, source_names );
+    worked = worked && latency_stats.start();
     delay( 2000 );
+
+    // The main loop sleeps until there is steno or key input (or a key is pressed on the
+    // console), rather than polling for it
+    C_event_loop event_loop;
+
+    worked = worked && event_loop.initialise();
+
+    for ( size_t source = 0; source < steno_keyboard.sources(); source++ )
+    {
+        worked = worked && event_loop.add_event( steno_keyboard.source_event_fd( source ), ES_STENO );
+    }
+
+    worked = worked && event_loop.add_event( steno_keyboard.raw_event_fd(), ES_RAW );
+
+    // The console can't be waited on if input has been redirected from a file, in which
+    // case it is checked for the abort key periodically
+    int timeout_ms = ( worked && event_loop.add( STDIN_FILENO, ES_CONSOLE ) ) ? -1 : CONSOLE_POLL_MS;
+
+    struct rusage   usage_start;
+    struct timespec time_start = C_timer::current_time();
+
+    getrusage( RUSAGE_SELF, &usage_start );
     
     if ( worked )
     {
         std::string       stroke;
         std::string       steno;
         std::string       translation;
+        S_keystrokes      keystrokes;
         S_geminipr_packet packet;
 
+        std::vector< S_geminipr_packet > packets;
+        std::vector< bool >              packets_paper_tape;
+
+        S_stroke_times                stroke_times;
+        std::vector< S_stroke_times > packet_times;
+
         uint8_t           scancode  = 0;
         key_event_t       key_event = KEY_EV_UNKNOWN;
+        uint64_t          key_time  = 0;
+
+        uint32_t          sources[ EVENT_LOOP_SOURCES_MAX ];
+
+        bool              steno_pending = false;   // A full batch was read, so there may be more
         
         while ( ! kbd.abort() )
         {
-            // Stenographic chord input
-            if ( steno_keyboard.read( packet ) )
+            // Input sources are only signalled once their buffer has been emptied, so
+            // don't wait if a batch of chords was cut short
+            int count = event_loop.wait( steno_pending ? 0 : timeout_ms, sources, EVENT_LOOP_SOURCES_MAX );
+
+            if ( count < 0 )
+            {
+                break;
+            }
+
+            bool steno_ready = steno_pending;
+            bool raw_ready   = false;
+
+            for ( int ii = 0; ii < count; ii++ )
+            {
+                steno_ready = steno_ready || ( sources[ ii ] == ES_STENO );
+                raw_ready   = raw_ready   || ( sources[ ii ] == ES_RAW );
+            }
+
+            // Stenographic chord input. Chords which have queued up (after a stall, or
+            // during a fast burst) are translated together and their output sent once.
+            packets.clear();
+            packet_times.clear();
+
+            while ( steno_ready && ( packets.size() < BATCH_MAX ) && steno_keyboard.read( packet, stroke_times ) )
+            {
+                stroke_times.dequeued = C_latency_stats::now();
+
+                packets.push_back( packet );
+                packet_times.push_back( stroke_times );
+            }
+
+            steno_pending = ( packets.size() == BATCH_MAX );
+
+            if ( packets.size() > 0 )
             {
                 //log_writeln( C_log::LL_ERROR, "Got steno chord" );
                 
-                translator.translate( packet, translation );
+                translator.translate_batch( packets, translation, packets_paper_tape );
+
+                uint64_t translated = C_latency_stats::now();
                 
                 //TEMP
-                log_writeln_fmt( C_log::LL_VERBOSE_1, "translation: %s", translation.c_str() );
+                log_writeln_fmt( C_log::LL_VERBOSE_1, "translation: %s (%u chords)", translation.c_str(), ( unsigned int ) packets.size() );
                 
                 if ( translation.length() > 0 )
                 {
-                    outputter->send( translation );
+                    translator.keystrokes( translation, keystrokes );
+
+                    outputter->send( translation, keystrokes );
                 }
 
-                if ( translator.paper_tape() )
+                uint64_t output = ( translation.length() > 0 ) ? C_latency_stats::now() : translated;
+
+                for ( S_stroke_times & batch_times : packet_times )
                 {
-                    paper_tape.write( packet );
+                    batch_times.translated = translated;
+                    batch_times.output     = output;
+
+                    latency_stats.add( batch_times );
                 }
-            }
 
-            if ( steno_keyboard.acquired() )
-            {
-                outputter->set_keymapping(); 
-                
-                log_writeln( C_log::LL_INFO, "Ready" );
+                // Each packet goes on the tape if paper tape was on once it was translated
+                for ( size_t ii = 0; ii < packets.size(); ii++ )
+                {
+                    if ( packets_paper_tape[ ii ] )
+                    {
+                        paper_tape.write( packets[ ii ] );
+                    }
+                }
+
+                for ( const S_geminipr_packet & batch_packet : packets )
+                {
+                    if ( C_gemini_pr::chord( batch_packet ) == DUMP_CHORD )
+                    {
+                        latency_stats.log_report();
+                    }
+                }
             }
 
             // Key event input
-            if ( steno_keyboard.read( key_event, scancode ) )
+            while ( raw_ready && steno_keyboard.read( key_event, scancode, key_time ) )
             {
                 //TEMP
                 log_writeln_fmt( C_log::LL_VERBOSE_1, "key event: scancode: 0x%02x", scancode );
 
                 outputter->send( key_event, scancode );
+
+                latency_stats.add_key( key_time, C_latency_stats::now() );
             }
 
-            delay( 1 );
+            // Checked whenever the key event buffer's event has been cleared (by the
+            // event loop), as that event also signals acquisition
+            if ( raw_ready && steno_keyboard.acquired() )
+            {
+                outputter->set_keymapping(); 
+                
+                log_writeln( C_log::LL_INFO, "Ready" );
+            }
         }
     }
     else
@@ -185,13 +336,94 @@ C_stenosys::run( int argc, char *argv[] )
 
     log_writeln( C_log::LL_INFO, "Closing down" );
 
+    log_usage( usage_start, time_start );
+
+    latency_stats.stop();
     dictionary_search.stop();
     paper_tape.stop();
     steno_keyboard.stop();
 
+    if ( remote_steno )
+    {
+        stroke_server.stop();
+    }
+
     log_writeln( C_log::LL_INFO, "Closed down" );
 }
 
+/** \brief Log CPU use
+
+    Report the processor time used by all threads since the main loop started, and the
+    number of times they gave up the processor (mostly waits for input).
+
+    @param[in]      usage_start: Resource usage when the main loop started
+    @param[in]      time_start : Time the main loop started
+*/
+void
+C_stenosys::log_usage( const struct rusage & usage_start, const struct timespec & time_start )
+{
+    struct rusage   usage_end;
+    struct timespec time_end = C_timer::current_time();
+
+    getrusage( RUSAGE_SELF, &usage_end );
+
+    double user    = ( usage_end.ru_utime.tv_sec - usage_start.ru_utime.tv_sec ) + ( usage_end.ru_utime.tv_usec - usage_start.ru_utime.tv_usec ) / 1e6;
+    double system  = ( usage_end.ru_stime.tv_sec - usage_start.ru_stime.tv_sec ) + ( usage_end.ru_stime.tv_usec - usage_start.ru_stime.tv_usec ) / 1e6;
+    double elapsed = ( time_end.tv_sec - time_start.tv_sec ) + ( time_end.tv_nsec - time_start.tv_nsec ) / 1e9;
+
+    log_writeln_fmt( C_log::LL_INFO, "CPU time        : %.3fs user, %.3fs system in %.1fs (%.3f%%)"
+                   , user
+                   , system
+                   , elapsed
+                   , ( elapsed > 0 ) ? ( 100.0 * ( user + system ) / elapsed ) : 0.0 );
+
+    log_writeln_fmt( C_log::LL_INFO, "Context switches: %ld voluntary, %ld involuntary"
+                   , usage_end.ru_nvcsw  - usage_start.ru_nvcsw
+                   , usage_end.ru_nivcsw - usage_start.ru_nivcsw );
+}
+
+/** \brief Transcribe a stroke file
+
+    Translate a stroke file at full speed and write out the resulting text. Any
+    definitions are then added one at a time, each updating the transcript incrementally.
+
+    @param[in]      steno_path : Stroke file (.steno format)
+    @param[in]      output_path: Output file, or "" for stdout
+    @param[in]      jobs       : Number of translation threads, or 0 for one per CPU
+    @param[in]      defines    : Dictionary definitions, each in the form STENO=TEXT
+*/
+void
+C_stenosys::transcribe( const std::string &                steno_path
+                      , const std::string &                output_path
+                      , unsigned int                       jobs
+                      , const std::vector< std::string > & defines )
+{
+    log_writeln_fmt( C_log::LL_INFO, "Transcribing   : %s", steno_path.c_str() );
+
+    C_transcriber transcriber;
+
+    if ( ! ( transcriber.initialise( steno_path ) && transcriber.run( jobs ) ) )
+    {
+        log_writeln( C_log::LL_ERROR, "Transcription failed" );
+        return;
+    }
+
+    for ( const std::string & define : defines )
+    {
+        size_t equals = define.find( '=' );
+
+        if ( ( equals == std::string::npos ) || ( equals == 0 ) )
+        {
+            log_writeln_fmt( C_log::LL_ERROR, "Invalid definition (expected STENO=TEXT): %s", define.c_str() );
+            continue;
+        }
+
+        transcriber.define( define.substr( 0, equals ), define.substr( equals + 1 ) );
+    }
+
+    transcriber.write( output_path );
+}
+
 }
 
 /** \brief main function
@@ -213,15 +445,16 @@ int main( int argc, char *argv[] )
     }
     catch ( std::exception & ex )
     {
-        fprintf( stdout, "Program exception: %s\n", ex.what() );
+        log_writeln_fmt( C_log::LL_ERROR, "Program exception: %s", ex.what() );
     }
     
     catch ( ... )
     {
-        fprintf( stdout, "Program exception\n" );
+        log_writeln( C_log::LL_ERROR, "Program exception" );
     }
     
-    fprintf( stdout, "Closed down\n" );
+    // Through the log, which a transcript on stdout keeps out of its way
+    log_writeln( C_log::LL_ERROR, "Closed down" );
 
     return 0;
 }
@@ -1,6 +1,11 @@
 // stenosys.h
 #pragma once
 
+#include <string>
+#include <sys/resource.h>
+#include <time.h>
+#include <vector>
+
 namespace stenosys
 {
 
@@ -15,6 +20,15 @@ public:
 
 private:
 
+    void
+    log_usage( const struct rusage & usage_start, const struct timespec & time_start );
+
+    void
+    transcribe( const std::string &                steno_path
+              , const std::string &                output_path
+              , unsigned int                       jobs
+              , const std::vector< std::string > & defines );
+
 };
 
 }
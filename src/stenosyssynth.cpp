@@ -0,0 +1,547 @@
+// stenosyssynth.cpp
+
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <map>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <random>
+#include <stdio.h>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+#include "geminipr.h"
+#include "log.h"
+#include "miscellaneous.h"
+#include "stenosyssynth.h"
+#include "strokefeed.h"
+#include "strokeframe.h"
+#include "textfile.h"
+
+
+using namespace stenosys;
+
+namespace stenosys
+{
+
+extern C_log log;
+
+const char * VERSION = "0.10";
+
+C_stenosys_synth::C_stenosys_synth()
+    : dict_path_( DEF_DICTIONARY )
+    , random_( false )
+    , count_( 0 )
+    , wpm_( DEF_WPM )
+    , burst_( 1 )
+    , jitter_( 0 )
+    , seed_( 1 )
+    , wait_ms_( DEF_WAIT_MS )
+    , protocol_type_( SP_GEMINI_PR )
+    , master_( -1 )
+    , slave_( -1 )
+{
+}
+
+C_stenosys_synth::~C_stenosys_synth()
+{
+    close_pty();
+}
+
+/** \brief main function
+
+    Load the strokes, create the pty and send the strokes into it
+
+    @param[in]      argc: Number of parameters
+    @param[in]      argv: Array of parameter strings
+*/
+void
+C_stenosys_synth::run( int argc, char *argv[] )
+{
+    log_writeln_fmt( C_log::LL_INFO, "stenosys-synth version %s, date %s", VERSION, __DATE__ );
+
+    if ( ! check_params( argc, argv ) )
+    {
+        return;
+    }
+
+    if ( ! ( random_ ? load_dictionary() : load_steno_file() ) )
+    {
+        return;
+    }
+
+    if ( ! ( ( connect_.length() > 0 ) ? open_connection() : open_pty() ) )
+    {
+        return;
+    }
+
+    delay( wait_ms_ );
+
+    send();
+
+    // Give the reader time to take the last packets before the pty goes away
+    delay( 1000 );
+
+    close_pty();
+}
+
+bool
+C_stenosys_synth::check_params( int argc, char *argv[] )
+{
+    for ( int ii = 1; ii < argc; ii++ )
+    {
+        std::string arg = argv[ ii ];
+
+        if ( ( arg == ARG_STENO ) && ( ( ii + 1 ) < argc ) )
+        {
+            steno_path_ = argv[ ++ii ];
+        }
+        else if ( arg == ARG_RANDOM )
+        {
+            random_ = true;
+        }
+        else if ( ( arg == ARG_DICTIONARY ) && ( ( ii + 1 ) < argc ) )
+        {
+            dict_path_ = argv[ ++ii ];
+        }
+        else if ( ( arg == ARG_COUNT ) && ( ( ii + 1 ) < argc ) )
+        {
+            count_ = atoi( argv[ ++ii ] );
+        }
+        else if ( ( arg == ARG_WPM ) && ( ( ii + 1 ) < argc ) )
+        {
+            wpm_ = atoi( argv[ ++ii ] );
+        }
+        else if ( ( arg == ARG_BURST ) && ( ( ii + 1 ) < argc ) )
+        {
+            burst_ = atoi( argv[ ++ii ] );
+        }
+        else if ( ( arg == ARG_JITTER ) && ( ( ii + 1 ) < argc ) )
+        {
+            jitter_ = atoi( argv[ ++ii ] );
+        }
+        else if ( ( arg == ARG_SEED ) && ( ( ii + 1 ) < argc ) )
+        {
+            seed_ = atoi( argv[ ++ii ] );
+        }
+        else if ( ( arg == ARG_LINK ) && ( ( ii + 1 ) < argc ) )
+        {
+            link_path_ = argv[ ++ii ];
+        }
+        else if ( ( arg == ARG_WAIT ) && ( ( ii + 1 ) < argc ) )
+        {
+            wait_ms_ = atoi( argv[ ++ii ] );
+        }
+        else if ( ( arg == ARG_CONNECT ) && ( ( ii + 1 ) < argc ) )
+        {
+            connect_ = argv[ ++ii ];
+        }
+        else if ( ( arg == ARG_PROTOCOL ) && ( ( ii + 1 ) < argc ) && C_steno_protocol::parse( argv[ ii + 1 ], protocol_type_ ) )
+        {
+            ii++;
+        }
+        else
+        {
+            usage();
+            return false;
+        }
+    }
+
+    if ( ( steno_path_.length() > 0 ) == random_ )
+    {
+        usage();
+        return false;
+    }
+
+    if ( ( burst_ == 0 ) || ( jitter_ > 100 ) )
+    {
+        usage();
+        return false;
+    }
+
+    protocol_ = C_steno_protocol::create( protocol_type_ );
+
+    return true;
+}
+
+void
+C_stenosys_synth::usage()
+{
+    log_writeln( C_log::LL_INFO, "stenosys-synth - virtual steno machine" );
+    log_writeln( C_log::LL_INFO, "  Usage: stenosys-synth " ARG_STENO " <file.steno> | " ARG_RANDOM " [" ARG_DICTIONARY " <file>]" );
+    log_writeln( C_log::LL_INFO, "                        [" ARG_COUNT " <n>] [" ARG_WPM " <n>] [" ARG_BURST " <n>] [" ARG_JITTER " <percent>]" );
+    log_writeln( C_log::LL_INFO, "                        [" ARG_SEED " <n>] [" ARG_LINK " <path>] [" ARG_WAIT " <ms>]" );
+    log_writeln( C_log::LL_INFO, "                        [" ARG_PROTOCOL " geminipr|txbolt|hid] [" ARG_CONNECT " <port|host:port|path>]" );
+    log_writeln( C_log::LL_INFO, "    " ARG_STENO "      : send the strokes in a stroke file" );
+    log_writeln( C_log::LL_INFO, "    " ARG_RANDOM "     : send random strokes, weighted by their use in the dictionary" );
+    log_writeln( C_log::LL_INFO, "    " ARG_DICTIONARY " : dictionary for random strokes (default: " DEF_DICTIONARY ")" );
+    log_writeln( C_log::LL_INFO, "    " ARG_COUNT "      : strokes to send (default: the whole file, repeating it as needed; 1000 random)" );
+    log_writeln( C_log::LL_INFO, "    " ARG_WPM "        : words per minute, at 1.4 strokes per word; 0 for full speed (default: 200)" );
+    log_writeln( C_log::LL_INFO, "    " ARG_BURST "      : strokes sent together in one write, at the same average rate (default: 1)" );
+    log_writeln( C_log::LL_INFO, "    " ARG_JITTER "     : random variation of each interval, 0 to 100 percent (default: 0)" );
+    log_writeln( C_log::LL_INFO, "    " ARG_SEED "       : random number seed (default: 1)" );
+    log_writeln( C_log::LL_INFO, "    " ARG_LINK "       : also make the pty available at this path" );
+    log_writeln( C_log::LL_INFO, "    " ARG_WAIT "       : delay before sending, to let stenosys start (default: 5000)" );
+    log_writeln( C_log::LL_INFO, "    " ARG_PROTOCOL "   : protocol the machine sends (default: geminipr)" );
+    log_writeln( C_log::LL_INFO, "    " ARG_CONNECT "    : send to stenosys's stroke server (on this host if no host is given)," );
+    log_writeln( C_log::LL_INFO, "                   or its Unix socket, instead of creating a pty" );
+}
+
+bool
+C_stenosys_synth::load_steno_file()
+{
+    C_stroke_feed stroke_feed;
+
+    if ( ! stroke_feed.initialise( steno_path_, 0 ) )
+    {
+        log_writeln_fmt( C_log::LL_ERROR, "Failed to load stroke file %s", steno_path_.c_str() );
+        return false;
+    }
+
+    std::string       steno;
+    S_geminipr_packet packet;
+
+    while ( stroke_feed.get_steno( steno ) )
+    {
+        if ( C_gemini_pr::encode( steno, packet ) )
+        {
+            packets_.push_back( packet );
+        }
+        else
+        {
+            log_writeln_fmt( C_log::LL_WARNING, "Not a valid stroke: %s", steno.c_str() );
+        }
+    }
+
+    if ( count_ == 0 )
+    {
+        count_ = packets_.size();
+    }
+
+    log_writeln_fmt( C_log::LL_INFO, "Loaded %u strokes from %s", ( unsigned int ) packets_.size(), steno_path_.c_str() );
+
+    return packets_.size() > 0;
+}
+
+// Count the occurrences of each stroke in the steno of all the dictionary entries
+bool
+C_stenosys_synth::load_dictionary()
+{
+    C_text_file dictionary;
+
+    if ( ! dictionary.read( dict_path_ ) )
+    {
+        log_writeln_fmt( C_log::LL_ERROR, "Failed to load dictionary %s", dict_path_.c_str() );
+        return false;
+    }
+
+    std::map< std::string, unsigned int > occurrences;
+
+    std::string line;
+
+    while ( dictionary.get_line( line ) )
+    {
+        size_t end = line.find( '\t' );
+        size_t start = 0;
+
+        if ( ( end == std::string::npos ) || ( end == 0 ) )
+        {
+            continue;
+        }
+
+        while ( start < end )
+        {
+            size_t slash = line.find( '/', start );
+
+            if ( ( slash == std::string::npos ) || ( slash > end ) )
+            {
+                slash = end;
+            }
+
+            occurrences[ line.substr( start, slash - start ) ]++;
+
+            start = slash + 1;
+        }
+    }
+
+    S_geminipr_packet packet;
+
+    for ( const auto & occurrence : occurrences )
+    {
+        if ( C_gemini_pr::encode( occurrence.first, packet ) )
+        {
+            packets_.push_back( packet );
+            weights_.push_back( occurrence.second );
+        }
+    }
+
+    if ( count_ == 0 )
+    {
+        count_ = DEF_COUNT;
+    }
+
+    log_writeln_fmt( C_log::LL_INFO, "Loaded %u distinct strokes from %s", ( unsigned int ) packets_.size(), dict_path_.c_str() );
+
+    return packets_.size() > 0;
+}
+
+bool
+C_stenosys_synth::open_pty()
+{
+    master_ = posix_openpt( O_RDWR | O_NOCTTY );
+
+    if ( ( master_ < 0 ) || ( grantpt( master_ ) != 0 ) || ( unlockpt( master_ ) != 0 ) )
+    {
+        log_writeln_fmt( C_log::LL_ERROR, "Failed to create pty: %s", strerror( errno ) );
+        return false;
+    }
+
+    std::string device = ptsname( master_ );
+
+    slave_ = open( device.c_str(), O_RDWR | O_NOCTTY );
+
+    if ( slave_ < 0 )
+    {
+        log_writeln_fmt( C_log::LL_ERROR, "Failed to open %s: %s", device.c_str(), strerror( errno ) );
+        return false;
+    }
+
+    // Raw, so that nothing is echoed or translated before stenosys sets up the device
+    struct termios tty;
+
+    tcgetattr( slave_, &tty );
+    cfmakeraw( &tty );
+    tcsetattr( slave_, TCSANOW, &tty );
+
+    if ( link_path_.length() > 0 )
+    {
+        unlink( link_path_.c_str() );
+
+        if ( symlink( device.c_str(), link_path_.c_str() ) != 0 )
+        {
+            log_writeln_fmt( C_log::LL_ERROR, "Failed to link %s to %s: %s", link_path_.c_str(), device.c_str(), strerror( errno ) );
+            return false;
+        }
+    }
+
+    log_writeln_fmt( C_log::LL_INFO, "Steno device   : %s", ( link_path_.length() > 0 ) ? link_path_.c_str() : device.c_str() );
+
+    return true;
+}
+
+bool
+C_stenosys_synth::open_connection()
+{
+    if ( connect_.find( '/' ) != std::string::npos )
+    {
+        struct sockaddr_un address;
+
+        memset( &address, 0, sizeof( address ) );
+
+        address.sun_family = AF_UNIX;
+        strncpy( address.sun_path, connect_.c_str(), sizeof( address.sun_path ) - 1 );
+
+        master_ = socket( AF_UNIX, SOCK_STREAM, 0 );
+
+        if ( ( master_ < 0 ) || ( connect( master_, ( struct sockaddr * ) &address, sizeof( address ) ) != 0 ) )
+        {
+            log_writeln_fmt( C_log::LL_ERROR, "Failed to connect to %s: %s", connect_.c_str(), strerror( errno ) );
+            return false;
+        }
+    }
+    else
+    {
+        size_t      colon = connect_.rfind( ':' );
+        std::string host  = ( colon == std::string::npos ) ? "127.0.0.1" : connect_.substr( 0, colon );
+
+        struct sockaddr_in address;
+
+        memset( &address, 0, sizeof( address ) );
+
+        address.sin_family = AF_INET;
+        address.sin_port   = htons( atoi( connect_.c_str() + ( ( colon == std::string::npos ) ? 0 : colon + 1 ) ) );
+
+        if ( inet_pton( AF_INET, host.c_str(), &address.sin_addr ) != 1 )
+        {
+            log_writeln_fmt( C_log::LL_ERROR, "Not an IPv4 address: %s", host.c_str() );
+            return false;
+        }
+
+        master_ = socket( AF_INET, SOCK_STREAM, 0 );
+
+        if ( ( master_ < 0 ) || ( connect( master_, ( struct sockaddr * ) &address, sizeof( address ) ) != 0 ) )
+        {
+            log_writeln_fmt( C_log::LL_ERROR, "Failed to connect to %s: %s", connect_.c_str(), strerror( errno ) );
+            return false;
+        }
+
+        // Each burst is sent as soon as it is written
+        int on = 1;
+
+        setsockopt( master_, IPPROTO_TCP, TCP_NODELAY, &on, sizeof( on ) );
+    }
+
+    log_writeln_fmt( C_log::LL_INFO, "Stroke server  : %s", connect_.c_str() );
+
+    return true;
+}
+
+void
+C_stenosys_synth::close_pty()
+{
+    if ( link_path_.length() > 0 )
+    {
+        unlink( link_path_.c_str() );
+        link_path_.clear();
+    }
+
+    if ( slave_ >= 0 )
+    {
+        close( slave_ );
+        slave_ = -1;
+    }
+
+    if ( master_ >= 0 )
+    {
+        close( master_ );
+        master_ = -1;
+    }
+}
+
+// Send the strokes on a fixed schedule, so that late sends (e.g. when the reader has fallen
+// behind and the pty is full) don't slow the overall rate
+void
+C_stenosys_synth::send()
+{
+    std::mt19937                           generator( seed_ );
+    std::discrete_distribution< size_t >   pick( weights_.begin(), weights_.end() );
+    std::uniform_real_distribution< double > jitter( -( jitter_ / 100.0 ), jitter_ / 100.0 );
+
+    double interval_ns = ( wpm_ > 0 ) ? ( 60e9 / ( wpm_ * STROKES_PER_WORD ) ) : 0.0;
+
+    std::string                burst;
+    std::vector< chord_type >  chords;
+
+    S_stroke_frame frame = { STROKE_FRAME_CHORD, 0, 0, 0 };
+
+    struct timespec start;
+    struct timespec due;
+    struct timespec now;
+
+    clock_gettime( CLOCK_MONOTONIC, &start );
+
+    double   due_ns      = 0.0;
+    double   late_ns_max = 0.0;
+    double   late_ns_sum = 0.0;
+    unsigned sent        = 0;
+    unsigned bursts      = 0;
+
+    while ( sent < count_ )
+    {
+        chords.clear();
+
+        for ( unsigned int ii = 0; ( ii < burst_ ) && ( ( sent + ii ) < count_ ); ii++ )
+        {
+            size_t index = random_ ? pick( generator ) : ( ( sent + ii ) % packets_.size() );
+
+            chords.push_back( C_gemini_pr::chord( packets_[ index ] ) );
+        }
+
+        if ( interval_ns > 0.0 )
+        {
+            due.tv_sec  = start.tv_sec + ( time_t ) ( ( start.tv_nsec + due_ns ) / 1e9 );
+            due.tv_nsec = ( long ) fmod( start.tv_nsec + due_ns, 1e9 );
+
+            while ( clock_nanosleep( CLOCK_MONOTONIC, TIMER_ABSTIME, &due, nullptr ) == EINTR )
+            {
+            }
+        }
+
+        // Encoded once due, so that frames are timestamped when they are sent
+        burst.clear();
+
+        clock_gettime( CLOCK_MONOTONIC, &now );
+
+        frame.time = ( ( uint64_t ) now.tv_sec * 1000000000 ) + now.tv_nsec;
+
+        for ( chord_type chord : chords )
+        {
+            if ( connect_.length() > 0 )
+            {
+                frame.chord = chord;
+                C_stroke_frame::encode( frame, burst );
+                frame.sequence++;
+            }
+            else
+            {
+                protocol_->encode( chord, burst );
+            }
+        }
+
+        if ( write( master_, burst.data(), burst.length() ) < 0 )
+        {
+            log_writeln_fmt( C_log::LL_ERROR, "Write to %s failed: %s", ( connect_.length() > 0 ) ? "stroke server" : "pty", strerror( errno ) );
+            return;
+        }
+
+        if ( interval_ns > 0.0 )
+        {
+            clock_gettime( CLOCK_MONOTONIC, &now );
+
+            double late_ns = ( ( now.tv_sec - due.tv_sec ) * 1e9 ) + ( now.tv_nsec - due.tv_nsec );
+
+            late_ns_max  = ( late_ns > late_ns_max ) ? late_ns : late_ns_max;
+            late_ns_sum += late_ns;
+
+            due_ns += interval_ns * chords.size() * ( 1.0 + jitter( generator ) );
+        }
+
+        sent += chords.size();
+        bursts++;
+    }
+
+    clock_gettime( CLOCK_MONOTONIC, &now );
+
+    double elapsed = ( now.tv_sec - start.tv_sec ) + ( ( now.tv_nsec - start.tv_nsec ) / 1e9 );
+
+    log_writeln_fmt( C_log::LL_INFO, "Sent %u strokes in %u writes in %.3fs: %.1f strokes/s (%.0f wpm)"
+                   , sent
+                   , bursts
+                   , elapsed
+                   , sent / elapsed
+                   , sent / elapsed * 60 / STROKES_PER_WORD );
+
+    if ( interval_ns > 0.0 )
+    {
+        log_writeln_fmt( C_log::LL_INFO, "Send lateness  : mean %.0fus, max %.0fus", late_ns_sum / bursts / 1e3, late_ns_max / 1e3 );
+    }
+}
+
+}
+
+/** \brief main function
+
+    Run the virtual steno machine
+
+    @param[in]      argc: Number of parameters
+    @param[in]      argv: Array of parameter strings
+*/
+int main( int argc, char *argv[] )
+{
+    stenosys::log.initialise( C_log::LL_INFO, false );
+
+    C_stenosys_synth synth;
+
+    synth.run( argc, argv );
+
+    return 0;
+}
@@ -0,0 +1,107 @@
+// stenosyssynth.h
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "geminipr.h"
+#include "stenoprotocol.h"
+
+namespace stenosys
+{
+
+#define ARG_STENO       "--steno"
+#define ARG_RANDOM      "--random"
+#define ARG_DICTIONARY  "--dictionary"
+#define ARG_COUNT       "--count"
+#define ARG_WPM         "--wpm"
+#define ARG_BURST       "--burst"
+#define ARG_JITTER      "--jitter"
+#define ARG_SEED        "--seed"
+#define ARG_LINK        "--link"
+#define ARG_WAIT        "--wait"
+#define ARG_PROTOCOL    "--protocol"
+#define ARG_CONNECT     "--connect"
+
+#define DEF_DICTIONARY  "./dictionary/yttyx-dict.tsv"
+#define DEF_COUNT       1000        // Random strokes sent if no count is given
+#define DEF_WPM         200
+#define DEF_WAIT_MS     5000        // Time for stenosys to start up and open the device
+
+#define STROKES_PER_WORD 1.4        // Typical for English steno
+
+// Virtual steno machine. Creates a pseudo-terminal and sends GeminiPR packets into it, as
+// a steno keyboard on a serial device would, so that stenosys can be run and timed without
+// steno hardware: point its stenodevice setting at the pty (or at a --link to it). TX Bolt
+// and Plover HID machines can be simulated too; for HID, the pty stands in for the
+// hidraw device. Alternatively, the strokes are sent to stenosys's stroke server, as
+// framed chord words, as a remote steno machine would.
+//
+// Strokes come from a .steno file, or are drawn at random from the dictionary, weighted by
+// how often each stroke occurs in it. They are sent at a given rate (0 for as fast as the
+// device takes them), optionally in bursts of several packets and with random jitter.
+class C_stenosys_synth
+{
+public:
+
+    C_stenosys_synth();
+
+    virtual
+    ~C_stenosys_synth();
+
+    void
+    run( int argc, char *argv[] );
+
+private:
+
+    bool
+    check_params( int argc, char *argv[] );
+
+    void
+    usage();
+
+    bool
+    load_steno_file();
+
+    bool
+    load_dictionary();
+
+    bool
+    open_pty();
+
+    bool
+    open_connection();
+
+    void
+    close_pty();
+
+    void
+    send();
+
+private:
+
+    std::string steno_path_;
+    std::string dict_path_;
+    std::string link_path_;
+    std::string connect_;           // Stroke server: port, host:port or Unix socket path
+
+    bool         random_;
+    unsigned int count_;
+    unsigned int wpm_;
+    unsigned int burst_;
+    unsigned int jitter_;           // Percentage variation of each interval
+    unsigned int seed_;
+    unsigned int wait_ms_;
+
+    steno_protocol_t                    protocol_type_;
+    std::unique_ptr< C_steno_protocol > protocol_;
+
+    int master_;                    // The pty, or the connection to the stroke server
+    int slave_;                     // Held open so the pty stays raw while stenosys reopens it
+
+    std::vector< S_geminipr_packet > packets_;  // Strokes from the file, or each stroke in the dictionary
+    std::vector< unsigned int >      weights_;  // Dictionary occurrences of each stroke
+};
+
+}
@@ -23,6 +23,7 @@ C_stroke::C_stroke()
 {
     flags_       = 0;
     seqnum_      = 0;
+    inserted_    = 0;
 }
 
 C_stroke::C_stroke( const std::string & steno )
@@ -32,6 +33,7 @@ C_stroke::C_stroke( const std::string & steno )
 
     flags_       = 0;
     seqnum_      = 0;
+    inserted_    = 0;
 }
 
 void
@@ -54,6 +56,8 @@ C_stroke::operator=( const C_stroke & rhs )
     shavian_       = rhs.shavian_;
     flags_         = rhs.flags_;
     seqnum_        = rhs.seqnum_;
+    replaced_      = rhs.replaced_;
+    inserted_      = rhs.inserted_;
 
     return *this;
 }
@@ -100,6 +104,30 @@ C_stroke::extends()
     return seqnum_ > 1;
 }
 
+void
+C_stroke::replaced( const std::string & replaced )
+{
+    replaced_ = replaced;
+}
+
+const std::string &
+C_stroke::replaced()
+{
+    return replaced_;
+}
+
+void
+C_stroke::inserted( uint32_t inserted )
+{
+    inserted_ = inserted;
+}
+
+uint32_t
+C_stroke::inserted()
+{
+    return inserted_;
+}
+
 void
 C_stroke::clear()
 {
@@ -107,6 +135,8 @@ C_stroke::clear()
     translation_   = "";
     flags_         = 0;
     seqnum_        = 0;
+    replaced_      = "";
+    inserted_      = 0;
 }
 
 }
@@ -51,6 +51,18 @@ public:
     bool
     extends();
 
+    void
+    replaced( const std::string & replaced );
+
+    const std::string &
+    replaced();
+
+    void
+    inserted( uint32_t inserted );
+
+    uint32_t
+    inserted();
+
     void
     clear();
 
@@ -66,6 +78,9 @@ private:
     uint16_t         flags_;                // Formatting flags
 
     uint16_t         seqnum_;               // The position of this stroke in a multi-stroke word
+
+    std::string      replaced_;             // Output text this stroke replaced
+    uint32_t         inserted_;             // Bytes of output text this stroke added
 };
 
 }
@@ -1,10 +1,8 @@
 // strokefeed.cpp
 
-#include <exception>
 #include <iostream>
 #include <fstream>
 #include <memory>
-#include <regex>
 #include <stdio.h>
 
 #include "geminipr.h"
@@ -24,11 +22,12 @@ extern C_log log;
 //   SR-R     // very
 //   TAOEURD  // tired
 //
-// '-' in REGEX_STROKE must be at the beginning or end of the [] section so it's not 
-// interpreted as a range (and gives the error "Invalid range in bracket expression")
-const char * REGEX_STROKE = "\\s*([#STKPWHRAO*EUFBLGDZ*-]+)";
+// The stroke is the first word on the line; anything after it is a comment
+const char * STENO_CHARS = "#STKPWHRAO*EUFBLGDZ-";
+const char * WHITESPACE  = " \t\r";
 
 C_stroke_feed::C_stroke_feed()
+    : delay_ms_( 0 )
 {
     strokes_ = std::make_unique< std::vector< std::string > >(); 
 }
@@ -39,10 +38,12 @@ C_stroke_feed::~C_stroke_feed()
 }
 
 bool
-C_stroke_feed::initialise( const std::string & filepath )
+C_stroke_feed::initialise( const std::string & filepath, unsigned int delay_ms )
 {
     bool worked = true;
 
+    delay_ms_ = delay_ms;
+
     if ( C_text_file::read( filepath ) )
     {
         text_stream_.seekg( std::ios_base::beg );
@@ -52,9 +53,14 @@ C_stroke_feed::initialise( const std::string & filepath )
 
         while ( C_text_file::get_line( line ) && ( line != "end" ) )
         {
-            if ( parse_line( line, REGEX_STROKE, steno ) )
+            if ( line.length() == 0 )
             {
-                if ( steno.find_first_not_of( "#STKPWHRAO*EUFBLGDZ-" ) == std::string::npos )
+                continue;
+            }
+
+            if ( parse_line( line, steno ) )
+            {
+                if ( steno.find_first_not_of( STENO_CHARS ) == std::string::npos )
                 {
                     strokes_->push_back( steno );
                 }
@@ -71,6 +77,10 @@ C_stroke_feed::initialise( const std::string & filepath )
             }
         }
     }
+    else
+    {
+        worked = false;
+    }
 
     // Free up memory from the vector container now we know how much we need
     strokes_->shrink_to_fit();
@@ -88,7 +98,10 @@ C_stroke_feed::get_steno( std::string & steno )
         steno = *strokes_it_;
         strokes_it_++;
 
-        delay( 100 );
+        if ( delay_ms_ > 0 )
+        {
+            delay( delay_ms_ );
+        }
 
         return true;
     }
@@ -96,30 +109,22 @@ C_stroke_feed::get_steno( std::string & steno )
     return false;
 }
 
+// Extract the first word of a line
 bool
-C_stroke_feed::parse_line( const std::string & line, const char * regex, std::string & param )
+C_stroke_feed::parse_line( const std::string & line, std::string & param )
 {
-    try
-    {
-        std::regex regex_entry( regex );
+    size_t begin = line.find_first_not_of( WHITESPACE );
 
-        std::smatch matches;
-
-        if ( std::regex_search( line, matches, regex_entry ) )
-        {
-            std::ssub_match match = matches[ 1 ];
+    if ( begin == std::string::npos )
+    {
+        return false;
+    }
 
-            param = match.str();
+    size_t end = line.find_first_of( WHITESPACE, begin );
 
-            return true;
-        }
-    }
-    catch ( std::exception & ex )
-    {
-        log_writeln_fmt( C_log::LL_INFO, "Stroke feed: exception parsing line %s: %s ", line.c_str(), ex.what() );
-    }    
+    param.assign( line, begin, ( end == std::string::npos ) ? std::string::npos : ( end - begin ) );
 
-    return false;
+    return true;
 }
 
 }
@@ -20,7 +20,7 @@ public:
     ~C_stroke_feed();
 
     bool
-    initialise( const std::string & filepath );
+    initialise( const std::string & filepath, unsigned int delay_ms );
 
     bool
     get_steno( std::string & steno );
@@ -31,12 +31,14 @@ private:
     check_file();
 
     bool
-    parse_line( const std::string & line, const char * regex, std::string & param );
+    parse_line( const std::string & line, std::string & param );
     
 private:
 
     std::unique_ptr< std::vector< S_geminipr_packet > > packets_; 
 
+    unsigned int delay_ms_;                       // Delay between strokes (0 for full speed)
+
     std::unique_ptr< std::vector< std::string > > strokes_; 
     std::vector< std::string >::iterator          strokes_it_;
 };
@@ -0,0 +1,125 @@
+// strokeframe.cpp
+
+#include <cstdint>
+#include <cstring>
+#include <endian.h>
+#include <string>
+
+#include "geminipr.h"
+#include "strokeframe.h"
+
+
+using namespace stenosys;
+
+namespace stenosys
+{
+
+C_stroke_frame::C_stroke_frame()
+    : data_count_( 0 )
+    , frame_length_( 0 )
+{
+}
+
+// Append a frame to data. A GeminiPR frame's packet is encoded from the chord.
+void
+C_stroke_frame::encode( const S_stroke_frame & frame, std::string & data )
+{
+    uint8_t  header[ STROKE_FRAME_HEADER ] = { frame.type };
+    uint32_t sequence = htobe32( frame.sequence );
+    uint64_t time     = htobe64( frame.time );
+
+    memcpy( &header[ 4 ], &sequence, sizeof( sequence ) );
+    memcpy( &header[ 8 ], &time, sizeof( time ) );
+
+    data.append( ( const char * ) header, sizeof( header ) );
+
+    if ( frame.type == STROKE_FRAME_GEMINI_PR )
+    {
+        S_geminipr_packet packet;
+
+        C_gemini_pr::encode( frame.chord, packet );
+
+        data.append( ( const char * ) packet.data, sizeof( packet.data ) );
+    }
+    else
+    {
+        uint32_t chord = htobe32( frame.chord );
+
+        data.append( ( const char * ) &chord, sizeof( chord ) );
+    }
+}
+
+// returns: true if the byte completes a frame, and frame is set to it
+//          error is set if the stream isn't a stream of frames (nothing more can be decoded)
+bool
+C_stroke_frame::decode( uint8_t byte, S_stroke_frame & frame, bool & error )
+{
+    if ( data_count_ == 0 )
+    {
+        frame_length_ = STROKE_FRAME_HEADER + payload_length( byte );
+
+        if ( frame_length_ == STROKE_FRAME_HEADER )
+        {
+            error = true;
+            return false;
+        }
+    }
+
+    data_[ data_count_++ ] = byte;
+
+    if ( data_count_ < frame_length_ )
+    {
+        return false;
+    }
+
+    data_count_ = 0;
+
+    uint32_t sequence;
+    uint64_t time;
+
+    memcpy( &sequence, &data_[ 4 ], sizeof( sequence ) );
+    memcpy( &time, &data_[ 8 ], sizeof( time ) );
+
+    frame.type     = data_[ 0 ];
+    frame.sequence = be32toh( sequence );
+    frame.time     = be64toh( time );
+
+    if ( frame.type == STROKE_FRAME_GEMINI_PR )
+    {
+        S_geminipr_packet packet;
+
+        memcpy( packet.data, &data_[ STROKE_FRAME_HEADER ], sizeof( packet.data ) );
+
+        if ( ( packet[ 0 ] & 0x80 ) == 0 )
+        {
+            error = true;
+            return false;
+        }
+
+        frame.chord = C_gemini_pr::chord( packet );
+    }
+    else
+    {
+        uint32_t chord;
+
+        memcpy( &chord, &data_[ STROKE_FRAME_HEADER ], sizeof( chord ) );
+
+        frame.chord = be32toh( chord ) & ( ( ( chord_type ) 1 << KEY_COUNT ) - 1 );
+    }
+
+    return true;
+}
+
+// returns: 0 for an unknown frame type
+unsigned int
+C_stroke_frame::payload_length( uint8_t type )
+{
+    switch ( type )
+    {
+        case STROKE_FRAME_GEMINI_PR: return BYTES_PER_STROKE;
+        case STROKE_FRAME_CHORD:     return sizeof( uint32_t );
+        default:                     return 0;
+    }
+}
+
+}
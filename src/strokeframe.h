@@ -0,0 +1,65 @@
+// strokeframe.h
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "chord.h"
+
+namespace stenosys
+{
+
+// Frame types
+#define STROKE_FRAME_GEMINI_PR  'G'     // Payload: a 6-byte GeminiPR packet
+#define STROKE_FRAME_CHORD      'C'     // Payload: a 32-bit chord word (chord.h bits)
+
+#define STROKE_FRAME_HEADER     16      // Bytes before the payload
+#define STROKE_FRAME_MIN        ( STROKE_FRAME_HEADER + 4 )
+#define STROKE_FRAME_MAX        ( STROKE_FRAME_HEADER + 8 )
+
+// A stroke sent over the network by a remote steno machine (see C_stroke_server). Each
+// frame is a 16-byte header, then the payload:
+//
+//      0       type ('G' or 'C')
+//      1-3     zero
+//      4-7     sequence number, counting up from any value
+//      8-15    when the stroke was sent, in ns on the sender's clock (0 if not known)
+//      16-     payload
+//
+// Numbers are big-endian.
+struct S_stroke_frame
+{
+    uint8_t    type;
+    uint32_t   sequence;
+    uint64_t   time;
+    chord_type chord;       // Decoded from the payload, whichever the type
+};
+
+// Encodes frames, and decodes them from a stream a byte at a time
+class C_stroke_frame
+{
+
+public:
+
+    C_stroke_frame();
+    ~C_stroke_frame() {}
+
+    static void
+    encode( const S_stroke_frame & frame, std::string & data );
+
+    bool
+    decode( uint8_t byte, S_stroke_frame & frame, bool & error );
+
+private:
+
+    static unsigned int
+    payload_length( uint8_t type );
+
+private:
+
+    uint8_t      data_[ STROKE_FRAME_MAX ];
+    unsigned int data_count_;
+    unsigned int frame_length_;     // Of the frame being decoded, once its type is known
+};
+
+}
@@ -1,7 +1,6 @@
 
 #include <algorithm>
 
-//TEMP for dict lookup tests
 #include <chrono>
 
 #include <cstdint>
@@ -12,9 +11,11 @@
 #include "dictionary_i.h"
 #include "log.h"
 #include "miscellaneous.h"
+#include "orthography.h"
 #include "stenoflags.h"
 #include "strokes.h"
 #include "symbols.h"
+#include "userdict.h"
 
 
 using namespace stenosys;
@@ -22,12 +23,15 @@ using namespace stenosys;
 namespace stenosys
 {
 
-extern C_log log;
+extern C_log             log;
+extern C_user_dictionary user_dictionary;
 
 C_strokes::C_strokes( C_symbols & symbols )
     : symbols_( symbols )
 {
-    history_ = std::make_unique< C_history< C_stroke, 10 > >();
+    history_     = std::make_unique< C_history< C_stroke, HISTORY_MAX > >();
+    cache_       = std::make_unique< C_lookup_cache >();
+    orthography_ = std::make_unique< C_orthography >();
 }
     
 C_strokes::~C_strokes()
@@ -77,15 +81,19 @@ C_strokes::initialise()
 //}
 
 // Add a steno stroke and look back through the stroke history
-// to find the best dictionary match.
+// to find the best dictionary match. keys is set to the match's keystroke program, or
+// nullptr if it has none.
 void
 C_strokes::add_stroke( const std::string & steno
                      , alphabet_type       alphabet
                      , std::string &       text
                      , uint16_t &          flags
                      , uint16_t &          flags_prev
-                     , bool &              extends )
+                     , bool &              extends
+                     , const char16_t * &  keys )
 {
+    auto start = std::chrono::steady_clock::now();
+
     C_stroke new_stroke( steno );
 
     history_->add( new_stroke );
@@ -93,27 +101,101 @@ C_strokes::add_stroke( const std::string & steno
     std::string key;
 
     text = steno;  // Default to the raw steno
+    keys = nullptr;
 
     C_stroke * stroke = nullptr;
 
-    do
+    // No dictionary entry is longer than this, so there is no point looking back further
+    int16_t levels = std::max( dictionary_strokes_max, user_dictionary.strokes_max() );
+
+    // The result of the lookback depends only on the strokes it covers and the alphabet,
+    // so it is cached against them
+    std::string history_key( 1, ( alphabet == AT_SHAVIAN ) ? 'S' : 'L' );
+
+    stroke = history_->curr();
+
+    for ( int16_t level = 0; level < levels; level++ )
     {
-        key = ( key.length() == 0 ) ? steno : stroke->steno() + std::string( "/" ) + key;
-     
-        std::string latin;
-        std::string shavian;
+        history_key += '/';
+        history_key += stroke->steno();
+
+        if ( ! history_->go_back( stroke ) )
+        {
+            break;
+        }
+    }
+
+    cache_->validate( user_dictionary.generation() );
+
+    std::string      cached_text;
+    uint16_t         cached_flags = 0;
+    const char16_t * cached_keys  = nullptr;
+    int16_t          depth        = -1;
+
+    bool hit = cache_->find( history_key, cached_text, cached_flags, cached_keys, depth );
+
+    history_->reset_lookback();
 
-        // Do dictionary lookup
-        if ( lookup( key, alphabet, text, flags ) )
+    if ( hit )
+    {
+        if ( depth >= 0 )
         {
+            text  = cached_text;
+            flags = cached_flags;
+            keys  = cached_keys;
+
             history_->curr()->translation( text );
             history_->curr()->flags( flags );
 
-            // Set best match so far
+            for ( int16_t level = 0; ( level < depth ) && history_->go_back( stroke ); level++ )
+            {
+            }
+
             history_->set_bookmark();
         }
+    }
+    else
+    {
+        // Suffix folding is only tried if no key matches as it stands, so that it never
+        // overrides an entry in the dictionary
+        for ( int16_t pass = 0; ( pass < 2 ) && ( depth < 0 ); pass++ )
+        {
+            int16_t level = 0;
 
-    } while ( history_->go_back( stroke ) );
+            key.clear();
+
+            history_->reset_lookback();
+
+            do
+            {
+                key = ( key.length() == 0 ) ? steno : stroke->steno() + std::string( "/" ) + key;
+             
+                // Do dictionary lookup
+                bool found = ( pass == 0 ) ? lookup( key, alphabet, text, flags, keys )
+                                           : lookup_folded( key, alphabet, text, flags, keys );
+
+                if ( found )
+                {
+                    history_->curr()->translation( text );
+                    history_->curr()->flags( flags );
+
+                    // Set best match so far
+                    history_->set_bookmark();
+
+                    depth = level;
+                }
+
+                level++;
+
+            } while ( ( level < levels ) && history_->go_back( stroke ) );
+        }
+
+        cache_->insert( history_key, ( depth >= 0 ) ? text : std::string(), flags, ( depth >= 0 ) ? keys : nullptr, depth );
+    }
+
+    auto end = std::chrono::steady_clock::now();
+
+    cache_->record( hit, std::chrono::duration_cast< std::chrono::nanoseconds >( end - start ).count() );
 
     // Work forward from the history bookmark (best match) and fix up the stroke sequence numbers
     history_->goto_bookmark();
@@ -175,13 +257,24 @@ C_strokes::clear()
     }
 }
 
+// Return to a new, initialised history. The lookup cache is kept.
+void
+C_strokes::reset()
+{
+    history_ = std::make_unique< C_history< C_stroke, HISTORY_MAX > >();
+
+    initialise();
+}
+
 
-// Output: text and flags are only set if the dictionary entry is found
+// Output: text, flags and keys are only set if the dictionary entry is found. keys is the
+// text's keystroke program, or nullptr for a user dictionary entry.
 bool
 C_strokes::lookup( const std::string & steno
                  , alphabet_type       alphabet
                  , std::string &       text
-                 , uint16_t &          flags )
+                 , uint16_t &          flags
+                 , const char16_t * &  keys )
 {
     const uint16_t * latin_flags   = nullptr;
     const uint16_t * shavian_flags = nullptr;
@@ -189,12 +282,25 @@ C_strokes::lookup( const std::string & steno
     const char * latin   = nullptr;
     const char * shavian = nullptr;
 
+    const char16_t * latin_keys   = nullptr;
+    const char16_t * shavian_keys = nullptr;
+
+    // Runtime definitions take precedence over the compiled-in dictionary
+    if ( ( ! user_dictionary.empty() ) && user_dictionary.lookup( steno, alphabet, text, flags ) )
+    {
+        keys = nullptr;
+        return true;
+    }
+
     // Look up entry in hashed dictionary
-    if ( dictionary_lookup( steno.c_str(), latin, latin_flags, shavian, shavian_flags ) )
+    if ( dictionary_lookup( steno.c_str(), latin, latin_flags, shavian, shavian_flags, latin_keys, shavian_keys ) )
     {
         // If configured for Shavian, use the Shavian entry if it's not empty; otherwise use
         // the Latin alphabet entry.
-        text  = ( alphabet == AT_SHAVIAN ) ? ( ( strlen( shavian ) > 0 ) ? shavian : latin ) : latin;
+        bool use_shavian = ( alphabet == AT_SHAVIAN ) && ( strlen( shavian ) > 0 );
+
+        text  = use_shavian ? shavian      : latin;
+        keys  = use_shavian ? shavian_keys : latin_keys;
         flags = ( alphabet == AT_SHAVIAN ) ? *shavian_flags : *latin_flags;
     
         return true;
@@ -203,6 +309,36 @@ C_strokes::lookup( const std::string & steno
     return false;
 }
 
+// A key which is not in the dictionary but ends in a suffix key is looked up without it,
+// and the suffix added to the word found. Output: text, flags and keys are only set if the
+// dictionary entry is found; an inflected word has no keystroke program.
+bool
+C_strokes::lookup_folded( const std::string & steno
+                        , alphabet_type       alphabet
+                        , std::string &       text
+                        , uint16_t &          flags
+                        , const char16_t * &  keys )
+{
+    std::string      base;
+    std::string      word;
+    uint16_t         base_flags = 0;
+    const char16_t * base_keys  = nullptr;
+    char             suffix     = '\0';
+
+    // Only plain words are inflected, not prefixes, suffixes or commands
+    if ( C_orthography::fold( steno, base, suffix ) && lookup( base, alphabet, word, base_flags, base_keys )
+                                                    && ( base_flags == 0 )
+                                                    && orthography_->inflect( word, suffix, text ) )
+    {
+        flags = base_flags;
+        keys  = nullptr;
+
+        return true;
+    }
+
+    return false;
+}
+
 void
 C_strokes::translation( const std::string translation )
 {
@@ -239,6 +375,49 @@ C_strokes::extends()
     return history_->curr()->extends();
 }
 
+C_stroke *
+C_strokes::current()
+{
+    return history_->curr();
+}
+
+// The earlier strokes of the multi-stroke word ending at the current stroke, most
+// recent first.
+void
+C_strokes::group( std::vector< C_stroke * > & strokes )
+{
+    strokes.clear();
+
+    history_->reset_lookback();
+
+    C_stroke * stroke = nullptr;
+
+    for ( uint16_t seqnum = history_->curr()->seqnum(); ( seqnum > 1 ) && history_->go_back( stroke ); seqnum-- )
+    {
+        strokes.push_back( stroke );
+    }
+}
+
+// Total output added by the strokes in the history: the furthest back into the output
+// text that undoing or extending them can reach.
+uint32_t
+C_strokes::reach()
+{
+    uint32_t reach = 0;
+
+    history_->reset_lookback();
+
+    C_stroke * stroke = history_->curr();
+
+    do
+    {
+        reach += stroke->inserted();
+
+    } while ( history_->go_back( stroke ) );
+
+    return reach;
+}
+
 void
 C_strokes::dump()
 {
@@ -274,6 +453,51 @@ C_strokes::dump()
         log_writeln_fmt( C_log::LL_INFO, "%s", line );
     
     } while ( history_->go_back( stroke ) );
+
+    C_lookup_cache::report( cache_->stats() );
+}
+
+// FNV-1a hash step
+static void
+hash_bytes( uint64_t & hash, const void * data, size_t length )
+{
+    const uint8_t * bytes = ( const uint8_t * ) data;
+
+    for ( size_t ii = 0; ii < length; ii++ )
+    {
+        hash = ( hash ^ bytes[ ii ] ) * 0x100000001b3;
+    }
+}
+
+// Hash of the complete stroke history. Two instances with the same hash will produce the
+// same translations for any following strokes.
+uint64_t
+C_strokes::state_hash()
+{
+    uint64_t hash = 0xcbf29ce484222325;
+
+    history_->reset_lookback();
+
+    C_stroke * stroke = history_->curr();
+
+    do
+    {
+        uint16_t flags  = stroke->flags();
+        uint16_t seqnum = stroke->seqnum();
+
+        hash_bytes( hash, stroke->steno().c_str(), stroke->steno().length() + 1 );
+        hash_bytes( hash, stroke->translation().c_str(), stroke->translation().length() + 1 );
+        hash_bytes( hash, &flags, sizeof( flags ) );
+        hash_bytes( hash, &seqnum, sizeof( seqnum ) );
+
+        uint32_t inserted = stroke->inserted();
+
+        hash_bytes( hash, stroke->replaced().c_str(), stroke->replaced().length() + 1 );
+        hash_bytes( hash, &inserted, sizeof( inserted ) );
+
+    } while ( history_->go_back( stroke ) );
+
+    return hash;
 }
 
 }
@@ -4,8 +4,11 @@
 #include <cstdint>
 #include <string>
 #include <memory>
+#include <vector>
 
 #include "history.h"
+#include "lookupcache.h"
+#include "orthography.h"
 #include "stenoflags.h"
 #include "stroke.h"
 #include "symbols.h"
@@ -17,6 +20,7 @@ namespace stenosys
 
 #define STROKE_BUFFER_MAX 12
 #define LOOKBACK_MAX      6
+#define HISTORY_MAX       10    // Strokes held in the history (and so the maximum lookback)
 
 class C_strokes
 {
@@ -35,7 +39,8 @@ public:
               , std::string &       text
               , uint16_t &          flags
               , uint16_t &          flags_prev 
-              , bool &              extends );
+              , bool &              extends
+              , const char16_t * &  keys );
 
     void
     add_stroke( const std::string & steno
@@ -50,7 +55,8 @@ public:
     lookup( const std::string & steno
           , alphabet_type       alphabet
           , std::string &       text
-          , uint16_t &          flags );
+          , uint16_t &          flags
+          , const char16_t * &  keys );
 
     void
     translation( const std::string translation );
@@ -70,14 +76,39 @@ public:
     bool
     extends();
 
+    C_stroke *
+    current();
+
+    void
+    group( std::vector< C_stroke * > & strokes );
+
+    uint32_t
+    reach();
+
     void
     clear();
 
+    void
+    reset();
+
     void 
     dump();
+
+    uint64_t
+    state_hash();
+
+    const S_lookup_stats &
+    lookup_stats() { return cache_->stats(); }
     
 private:
 
+    bool
+    lookup_folded( const std::string & steno
+                 , alphabet_type       alphabet
+                 , std::string &       text
+                 , uint16_t &          flags
+                 , const char16_t * &  keys );
+
     void
     find_best_match( uint16_t                          level
                    , const std::string &               steno_key
@@ -93,7 +124,9 @@ private:
 
     C_symbols    & symbols_;
 
-    std::unique_ptr< C_history< C_stroke, 10 > > history_;
+    std::unique_ptr< C_history< C_stroke, HISTORY_MAX > > history_;
+    std::unique_ptr< C_lookup_cache >                      cache_;
+    std::unique_ptr< C_orthography >                       orthography_;
 };
 
 }
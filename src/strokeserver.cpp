@@ -0,0 +1,438 @@
+// strokeserver.cpp
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "geminipr.h"
+#include "log.h"
+#include "strokeserver.h"
+
+
+using namespace stenosys;
+
+namespace stenosys
+{
+
+extern C_log log;
+
+C_stroke_server::C_stroke_server()
+    : abort_( false )
+    , tcp_listener_( -1 )
+    , unix_listener_( -1 )
+{
+    for ( S_stroke_client & client : clients_ )
+    {
+        client.fd = -1;
+    }
+
+    buffer_ = std::make_unique< C_spsc_ring< S_steno_stroke, 64 > >();
+}
+
+C_stroke_server::~C_stroke_server()
+{
+    for ( S_stroke_client & client : clients_ )
+    {
+        if ( client.fd >= 0 )
+        {
+            close( client.fd );
+        }
+    }
+
+    if ( tcp_listener_ >= 0 )
+    {
+        close( tcp_listener_ );
+    }
+
+    if ( unix_listener_ >= 0 )
+    {
+        close( unix_listener_ );
+        unlink( socket_path_.c_str() );
+    }
+}
+
+// -----------------------------------------------------------------------------------
+// Foreground thread code
+// -----------------------------------------------------------------------------------
+
+// port       : TCP port, or 0 for none
+// socket_path: Unix socket, or "" for none
+bool
+C_stroke_server::initialise( int port, const std::string & address, const std::string & socket_path )
+{
+    if ( port > 0 )
+    {
+        tcp_listener_ = listen_tcp( port, address );
+
+        if ( tcp_listener_ < 0 )
+        {
+            return false;
+        }
+
+        log_writeln_fmt( C_log::LL_INFO, "Stroke server listening on %s port %d", address.c_str(), port );
+    }
+
+    if ( socket_path.length() > 0 )
+    {
+        unix_listener_ = listen_unix( socket_path );
+
+        if ( unix_listener_ < 0 )
+        {
+            return false;
+        }
+
+        socket_path_ = socket_path;
+
+        log_writeln_fmt( C_log::LL_INFO, "Stroke server listening on %s", socket_path.c_str() );
+    }
+
+    return true;
+}
+
+bool
+C_stroke_server::start()
+{
+    return thread_start();
+}
+
+void
+C_stroke_server::stop()
+{
+    abort_ = true;
+    wake_.signal();
+
+    thread_await_exit();
+}
+
+bool
+C_stroke_server::read_stroke( S_steno_stroke & stroke )
+{
+    return buffer_->get( stroke );
+}
+
+// Signalled when strokes may have been added since read_stroke() last emptied the buffer
+int
+C_stroke_server::stroke_event_fd()
+{
+    return buffer_->event_fd();
+}
+
+std::string
+C_stroke_server::stroke_source_name()
+{
+    return "network";
+}
+
+int
+C_stroke_server::listen_tcp( int port, const std::string & address_text )
+{
+    struct sockaddr_in address;
+
+    memset( &address, 0, sizeof( address ) );
+
+    address.sin_family = AF_INET;
+    address.sin_port   = htons( port );
+
+    if ( inet_pton( AF_INET, address_text.c_str(), &address.sin_addr ) != 1 )
+    {
+        log_writeln_fmt( C_log::LL_ERROR, "Stroke server address is not an IPv4 address: %s", address_text.c_str() );
+        return -1;
+    }
+
+    int listener = socket( AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0 );
+
+    if ( listener < 0 )
+    {
+        log_writeln_fmt( C_log::LL_ERROR, "Stroke server socket() error: %s", strerror( errno ) );
+        return -1;
+    }
+
+    int on = 1;
+
+    setsockopt( listener, SOL_SOCKET, SO_REUSEADDR, &on, sizeof( on ) );
+
+    if ( ( bind( listener, ( struct sockaddr * ) &address, sizeof( address ) ) < 0 ) ||
+         ( listen( listener, STROKE_SERVER_CLIENTS ) < 0 ) ||
+         ( ! set_nonblocking( listener ) ) )
+    {
+        log_writeln_fmt( C_log::LL_ERROR, "Stroke server can't listen on port %d: %s", port, strerror( errno ) );
+        close( listener );
+        return -1;
+    }
+
+    return listener;
+}
+
+int
+C_stroke_server::listen_unix( const std::string & socket_path )
+{
+    struct sockaddr_un address;
+
+    if ( socket_path.length() >= sizeof( address.sun_path ) )
+    {
+        log_writeln_fmt( C_log::LL_ERROR, "Stroke server socket path too long: %s", socket_path.c_str() );
+        return -1;
+    }
+
+    int listener = socket( AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0 );
+
+    if ( listener < 0 )
+    {
+        log_writeln_fmt( C_log::LL_ERROR, "Stroke server socket() error: %s", strerror( errno ) );
+        return -1;
+    }
+
+    memset( &address, 0, sizeof( address ) );
+
+    address.sun_family = AF_UNIX;
+    strcpy( address.sun_path, socket_path.c_str() );
+
+    // Left over from an earlier run
+    unlink( socket_path.c_str() );
+
+    // Only the user may connect. Connections can't be made until listen(), so there is no
+    // window in which the socket has the umask's permissions.
+    if ( ( bind( listener, ( struct sockaddr * ) &address, sizeof( address ) ) < 0 ) ||
+         ( chmod( socket_path.c_str(), S_IRUSR | S_IWUSR ) < 0 ) ||
+         ( listen( listener, STROKE_SERVER_CLIENTS ) < 0 ) ||
+         ( ! set_nonblocking( listener ) ) )
+    {
+        log_writeln_fmt( C_log::LL_ERROR, "Stroke server can't listen on %s: %s", socket_path.c_str(), strerror( errno ) );
+        close( listener );
+        return -1;
+    }
+
+    return listener;
+}
+
+bool
+C_stroke_server::set_nonblocking( int fd )
+{
+    int flags = fcntl( fd, F_GETFL );
+
+    return ( flags >= 0 ) && ( fcntl( fd, F_SETFL, flags | O_NONBLOCK ) == 0 );
+}
+
+// -----------------------------------------------------------------------------------
+// Background thread code
+// -----------------------------------------------------------------------------------
+
+void
+C_stroke_server::thread_handler()
+{
+    // The wakeup, the listeners, then the clients
+    struct pollfd fds[ 3 + STROKE_SERVER_CLIENTS ];
+
+    S_stroke_client * fds_client[ 3 + STROKE_SERVER_CLIENTS ];
+
+    while ( ! abort_ )
+    {
+        int fds_count = 0;
+
+        fds[ fds_count++ ] = { wake_.fd(), POLLIN, 0 };
+        fds[ fds_count++ ] = { tcp_listener_, POLLIN, 0 };      // Ignored by poll() if -1
+        fds[ fds_count++ ] = { unix_listener_, POLLIN, 0 };
+
+        // While the queue is full the clients are left unread, until the main loop has
+        // made room (the ring doesn't signal that, so check again shortly)
+        bool full = ( room() == 0 );
+
+        for ( S_stroke_client & client : clients_ )
+        {
+            if ( ( client.fd >= 0 ) && ( ! full ) )
+            {
+                fds_client[ fds_count ] = &client;
+                fds[ fds_count++ ]      = { client.fd, POLLIN, 0 };
+            }
+        }
+
+        if ( ( poll( fds, fds_count, full ? STROKE_SERVER_FULL_MS : -1 ) < 0 ) && ( errno != EINTR ) )
+        {
+            log_writeln_fmt( C_log::LL_ERROR, "Stroke server poll() error: %s", strerror( errno ) );
+            break;
+        }
+
+        for ( int ii = 3; ii < fds_count; ii++ )
+        {
+            if ( ( fds[ ii ].revents != 0 ) && ( ! receive( *fds_client[ ii ] ) ) )
+            {
+                close_client( *fds_client[ ii ] );
+            }
+        }
+
+        if ( fds[ 1 ].revents & POLLIN )
+        {
+            accept_client( tcp_listener_ );
+        }
+
+        if ( fds[ 2 ].revents & POLLIN )
+        {
+            accept_client( unix_listener_ );
+        }
+    }
+
+    for ( S_stroke_client & client : clients_ )
+    {
+        if ( client.fd >= 0 )
+        {
+            close_client( client );
+        }
+    }
+}
+
+void
+C_stroke_server::accept_client( int listener )
+{
+    struct sockaddr_storage address;
+    socklen_t               address_length = sizeof( address );
+
+    int fd = accept4( listener, ( struct sockaddr * ) &address, &address_length, SOCK_NONBLOCK | SOCK_CLOEXEC );
+
+    if ( fd < 0 )
+    {
+        return;
+    }
+
+    for ( S_stroke_client & client : clients_ )
+    {
+        if ( client.fd < 0 )
+        {
+            char peer[ INET6_ADDRSTRLEN ] = "local";
+
+            if ( address.ss_family == AF_INET )
+            {
+                inet_ntop( AF_INET, &( ( struct sockaddr_in * ) &address )->sin_addr, peer, sizeof( peer ) );
+            }
+
+            client.fd            = fd;
+            client.peer          = peer;
+            client.frame         = std::make_unique< C_stroke_frame >();
+            client.sequenced     = false;
+            client.next_sequence = 0;
+            client.strokes       = 0;
+            client.gaps          = 0;
+            client.transit       = std::make_unique< C_latency_histogram >( "  transit" );
+
+            log_writeln_fmt( C_log::LL_INFO, "Remote steno machine connected from %s", peer );
+            return;
+        }
+    }
+
+    log_writeln( C_log::LL_ERROR, "Too many remote steno machines; rejected new connection" );
+
+    close( fd );
+}
+
+// The number of frames which can be received without overfilling the stroke queue. A
+// frame may already be partly received, so this allows for one more stroke than whole
+// frames.
+int
+C_stroke_server::room()
+{
+    return std::max( buffer_->space() - 1, 0 );
+}
+
+// Queue the strokes in the data waiting on a connection, as far as there is room for them
+// returns: false if the connection has closed, or isn't sending frames
+bool
+C_stroke_server::receive( S_stroke_client & client )
+{
+    uint8_t data[ STROKE_SERVER_READ_MAX ];
+
+    while ( room() > 0 )
+    {
+        // Each frame is at least STROKE_FRAME_MIN bytes
+        size_t  size   = std::min< size_t >( sizeof( data ), room() * STROKE_FRAME_MIN );
+        ssize_t length = recv( client.fd, data, size, 0 );
+
+        if ( length < 0 )
+        {
+            return ( errno == EAGAIN ) || ( errno == EWOULDBLOCK ) || ( errno == EINTR );
+        }
+
+        if ( length == 0 )
+        {
+            return false;
+        }
+
+        uint64_t received = C_latency_stats::now();
+
+        for ( ssize_t ii = 0; ii < length; ii++ )
+        {
+            S_stroke_frame frame;
+            bool           error = false;
+
+            if ( ! client.frame->decode( data[ ii ], frame, error ) )
+            {
+                if ( error )
+                {
+                    log_writeln_fmt( C_log::LL_ERROR, "Invalid stroke frame from %s", client.peer.c_str() );
+                    return false;
+                }
+
+                continue;
+            }
+
+            if ( client.sequenced && ( frame.sequence != client.next_sequence ) )
+            {
+                log_writeln_fmt( C_log::LL_VERBOSE_1, "Stroke from %s out of sequence: %u, expected %u"
+                               , client.peer.c_str()
+                               , frame.sequence
+                               , client.next_sequence );
+                client.gaps++;
+            }
+
+            client.sequenced     = true;
+            client.next_sequence = frame.sequence + 1;
+            client.strokes++;
+
+            if ( ( frame.time > 0 ) && ( frame.time <= received ) )
+            {
+                client.transit->add( received - frame.time );
+            }
+
+            S_steno_stroke stroke;
+
+            C_gemini_pr::encode( frame.chord, stroke.packet );
+
+            stroke.times.serial_read     = received;
+            stroke.times.packet_complete = C_latency_stats::now();
+
+            if ( ! buffer_->put( stroke ) )
+            {
+                log_writeln( C_log::LL_ERROR, "Stroke queue full; remote stroke dropped" );
+            }
+        }
+    }
+
+    return true;
+}
+
+void
+C_stroke_server::close_client( S_stroke_client & client )
+{
+    log_writeln_fmt( C_log::LL_INFO, "Remote steno machine %s disconnected: %lu strokes, %lu out of sequence"
+                   , client.peer.c_str()
+                   , ( unsigned long ) client.strokes
+                   , ( unsigned long ) client.gaps );
+
+    if ( client.transit->count() > 0 )
+    {
+        log_writeln( C_log::LL_INFO, C_latency_histogram::report_header().c_str() );
+        log_writeln( C_log::LL_INFO, client.transit->report().c_str() );
+    }
+
+    close( client.fd );
+
+    client.fd = -1;
+}
+
+}
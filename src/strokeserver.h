@@ -0,0 +1,122 @@
+// strokeserver.h
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <poll.h>
+#include <string>
+
+#include "event.h"
+#include "histogram.h"
+#include "latency.h"
+#include "spscring.h"
+#include "strokeframe.h"
+#include "strokesource.h"
+#include "thread.h"
+
+namespace stenosys
+{
+
+#define STROKE_SERVER_CLIENTS   8       // Most remote machines connected at once
+#define STROKE_SERVER_READ_MAX  1024    // Bytes received from a connection in one call
+#define STROKE_SERVER_FULL_MS   5       // Interval to check for room in a full stroke queue
+
+// A remote steno machine's connection
+struct S_stroke_client
+{
+    int          fd;
+    std::string  peer;              // Address, for the log
+
+    std::unique_ptr< C_stroke_frame > frame;
+
+    bool         sequenced;         // A frame has been received, so next_sequence is known
+    uint32_t     next_sequence;
+    uint64_t     strokes;
+    uint64_t     gaps;              // Frames with an unexpected sequence number (lost or out of order)
+
+    std::unique_ptr< C_latency_histogram > transit;  // Sent -> received, if the clocks agree
+};
+
+// Receives strokes from remote steno machines over TCP, or a Unix socket, so that one
+// host can translate for thin clients. Each connection sends a stream of frames (see
+// C_stroke_frame), each a GeminiPR packet or a chord word. The strokes of all the
+// connections are passed to the main loop as one stroke source, queued in the order they
+// arrive, timed from when they were received. Data is only received while there is room
+// to queue its strokes, so a sender which outpaces the main loop is held back by TCP flow
+// control rather than having strokes dropped.
+//
+// Frames carry a sequence number, so that lost or reordered strokes are logged, and the
+// time they were sent. If the sender's clock is this host's CLOCK_MONOTONIC (e.g. a client
+// on the loopback interface) the transit times are logged when the connection closes.
+//
+// There is no authentication: anything which can connect can type into the user's X
+// session. The TCP port is bound to the loopback interface unless another address is
+// configured (strokeaddress), and the Unix socket is only accessible to the user.
+class C_stroke_server : public C_thread, public C_stroke_source
+{
+
+public:
+
+    C_stroke_server();
+    ~C_stroke_server();
+
+    bool
+    initialise( int port, const std::string & address, const std::string & socket_path );
+
+    bool
+    start();
+
+    void
+    stop();
+
+    bool
+    read_stroke( S_steno_stroke & stroke );
+
+    int
+    stroke_event_fd();
+
+    std::string
+    stroke_source_name();
+
+private:
+
+    int
+    listen_tcp( int port, const std::string & address );
+
+    int
+    listen_unix( const std::string & socket_path );
+
+    static bool
+    set_nonblocking( int fd );
+
+    void
+    thread_handler();
+
+    void
+    accept_client( int listener );
+
+    int
+    room();
+
+    bool
+    receive( S_stroke_client & client );
+
+    void
+    close_client( S_stroke_client & client );
+
+private:
+
+    bool abort_;
+
+    int         tcp_listener_;
+    int         unix_listener_;
+    std::string socket_path_;
+
+    C_event     wake_;          // Signalled to stop the server
+
+    S_stroke_client clients_[ STROKE_SERVER_CLIENTS ];
+
+    std::unique_ptr< C_spsc_ring< S_steno_stroke, 64 > > buffer_;
+};
+
+}
@@ -0,0 +1,36 @@
+// strokesource.h
+#pragma once
+
+#include <string>
+
+#include "latency.h"
+
+namespace stenosys
+{
+
+// A source of steno strokes for the translator: a steno machine, or chords made on the raw
+// keyboard. Each source queues its strokes on its own ring from its own thread, and the
+// main loop merges them (see C_steno_keyboard).
+class C_stroke_source
+{
+
+public:
+
+    virtual
+    ~C_stroke_source() {}
+
+    // returns: true if a stroke was waiting, and stroke is set to it
+    virtual bool
+    read_stroke( S_steno_stroke & stroke ) = 0;
+
+    // Signalled when strokes may have been added since read_stroke() last emptied the
+    // queue, and readable until whoever waits on it clears it (an eventfd)
+    virtual int
+    stroke_event_fd() = 0;
+
+    // Short name for the log and the per-source stats, e.g. "ttyACM0"
+    virtual std::string
+    stroke_source_name() = 0;
+};
+
+}
@@ -1,13 +1,14 @@
+#include <array>
 #include <cstddef>
 #include <cstdint>
 #include <cstring>
 #include <stdio.h>
 
+#include "chord.h"
 #include "log.h"
 #include "miscellaneous.h"
 #include "stenoflags.h"
 #include "symbols.h"
-#include "utf8.h"
 
 
 // This class implements a subset of Emily's symbols
@@ -22,77 +23,153 @@ namespace stenosys
 
 extern C_log log;
 
+// Symbol variants, by the right-hand keys which select them. Each has up to four
+// alternatives, chosen with E and U.
+typedef struct
+{
+    const char * steno;
+    const char * variants;
+} S_symbol_variants;
+
+static constexpr S_symbol_variants symbol_variants[] =
+{
+    { "-FR",     "!¬↦¡"  },
+    { "-FP",     "\"“”„" },
+    { "-FRLG",   "#©®™"  },
+    { "-RPBL",   "$¥€£"  },
+    { "-FRPB",   "%‰‱φ"  },
+    { "-FBG",    "&∩∧∈"  },
+    { "-F",      "'‘’‚"  },
+    { "-FPL",    "([<{"  },
+    { "-RBG",    ")]>}"  },
+    { "-L",      "*∏§×"  },
+    { "-G",      "+∑¶±"  },
+    { "-B",      ",∪∨∉"  },
+    { "-PL",     "-−–—"  },
+    { "-R",      ".•·…"  },
+    { "-RP",     "/⇒⇔÷"  },
+    { "-LG",     ":∋∵∴"  },
+    { "-RB",     ";∀∃∄"  },
+    { "-PBLG",   "=≡≈≠"  },
+    { "-FPB",    "?¿∝‽"  },
+    { "-FRPBLG", "@⊕⊗∅"  },
+    { "-FB",     "\\Δ√∞" },
+    { "-RPG",    "^«»°"  },
+    { "-BG",     "_≤≥µ"  },
+    { "-P",      "`⊂⊃π"  },
+    { "-PB",     "|⊤⊥¦"  },
+    { "-FPBG",   "~⊆⊇˜"  },
+    { nullptr,   nullptr }
+};
+
+// Work out the symbol stroke for every combination of the keys after the starter:
+//   Symbol variants: FRPBLG
+//   Attachment     : AO (A: space before, O: space after)
+//   Capitalisation : *
+//   Variant select : EU
+//   Repetition     : TS (S: x2, T: x3, TS: x4)
+// The D and Z keys are ignored.
+static constexpr std::array< S_symbol, SYMBOL_TABLE_SIZE >
+build_symbol_table()
+{
+    std::array< S_symbol, SYMBOL_TABLE_SIZE > table {};
+
+    // The variants by their right-hand keys -FRPBLG, as a 6-bit number
+    const char * variants_by_keys[ 64 ] = {};
+
+    for ( const S_symbol_variants * entry = &symbol_variants[ 0 ]; entry->steno != nullptr; entry++ )
+    {
+        chord_type variant = 0;
+
+        if ( chord_parse( entry->steno, variant ) )
+        {
+            variants_by_keys[ ( variant >> KEY_INDEX_RIGHT ) & 0x3f ] = entry->variants;
+        }
+    }
+
+    for ( uint32_t index = 0; index < SYMBOL_TABLE_SIZE; index++ )
+    {
+        chord_type chord = ( chord_type ) index << SYMBOL_INDEX_SHIFT;
+
+        const char * variants = variants_by_keys[ ( chord >> KEY_INDEX_RIGHT ) & 0x3f ];
+
+        if ( variants == nullptr )
+        {
+            continue;
+        }
+
+        // Skip to the selected variant, counting UTF-8 lead bytes
+        int select = ( ( chord & KEY_VOWEL_E ) ? 1 : 0 ) + ( ( chord & KEY_VOWEL_U ) ? 2 : 0 );
+        int start  = 0;
+
+        for ( int count = 0; count <= select; start++ )
+        {
+            count += ( ( ( uint8_t ) variants[ start ] & 0xc0 ) != 0x80 ) ? 1 : 0;
+        }
+
+        int end = start--;
+
+        while ( ( ( ( uint8_t ) variants[ end ] ) & 0xc0 ) == 0x80 )
+        {
+            end++;
+        }
+
+        int repeats = 1 + ( ( chord & KEY__S ) ? 1 : 0 ) + ( ( chord & KEY__T ) ? 2 : 0 );
+        int length  = 0;
+
+        for ( int repeat = 0; repeat < repeats; repeat++ )
+        {
+            for ( int ch = start; ch < end; ch++ )
+            {
+                table[ index ].text[ length++ ] = variants[ ch ];
+            }
+        }
+
+        uint16_t flags = ATTACH_TO_PREVIOUS | ATTACH_TO_NEXT;
+
+        flags &= ( chord & KEY_VOWEL_A ) ? ~ATTACH_TO_PREVIOUS : 0xffff;
+        flags &= ( chord & KEY_VOWEL_O ) ? ~ATTACH_TO_NEXT     : 0xffff;
+        flags |= ( chord & KEY_STAR ) ? CAPITALISE_NEXT  : 0;
+
+        table[ index ].flags = flags;
+        table[ index ].valid = true;
+    }
+
+    return table;
+}
+
+static constexpr std::array< S_symbol, SYMBOL_TABLE_SIZE > symbol_table = build_symbol_table();
+
 C_symbols::C_symbols()
 {
-    symbol_map_ = std::make_unique< std::unordered_map< std::string, std::string > >();
-    
-    symbol_map_->insert( std::make_pair( "FR",     "!¬↦¡"  ) );
-    symbol_map_->insert( std::make_pair( "FP",     "\"“”„" ) );
-    symbol_map_->insert( std::make_pair( "FRLG",   "#©®™"  ) );
-    symbol_map_->insert( std::make_pair( "RPBL",   "$¥€£"  ) );
-    symbol_map_->insert( std::make_pair( "FRPB",   "%‰‱φ"  ) );
-    symbol_map_->insert( std::make_pair( "FBG",    "&∩∧∈"  ) );
-    symbol_map_->insert( std::make_pair( "F",      "'‘’‚"  ) );
-    symbol_map_->insert( std::make_pair( "FPL",    "([<{"  ) );
-    symbol_map_->insert( std::make_pair( "RBG",    ")]>}"  ) );
-    symbol_map_->insert( std::make_pair( "L",      "*∏§×"  ) );
-    symbol_map_->insert( std::make_pair( "G",      "+∑¶±"  ) );
-    symbol_map_->insert( std::make_pair( "B",      ",∪∨∉"  ) );
-    symbol_map_->insert( std::make_pair( "PL",     "-−–—"  ) );
-    symbol_map_->insert( std::make_pair( "R",      ".•·…"  ) );
-    symbol_map_->insert( std::make_pair( "RP",     "/⇒⇔÷"  ) );
-    symbol_map_->insert( std::make_pair( "LG",     ":∋∵∴"  ) );
-    symbol_map_->insert( std::make_pair( "RB",     ";∀∃∄"  ) );
-    symbol_map_->insert( std::make_pair( "PBLG",   "=≡≈≠"  ) );
-    symbol_map_->insert( std::make_pair( "FPB",    "?¿∝‽"  ) );
-    symbol_map_->insert( std::make_pair( "FRPBLG", "@⊕⊗∅"  ) );
-    symbol_map_->insert( std::make_pair( "FB",     "\\Δ√∞" ) );
-    symbol_map_->insert( std::make_pair( "RPG",    "^«»°"  ) );
-    symbol_map_->insert( std::make_pair( "BG",     "_≤≥µ"  ) );
-    symbol_map_->insert( std::make_pair( "P",      "`⊂⊃π"  ) );
-    symbol_map_->insert( std::make_pair( "PB",     "|⊤⊥¦"  ) );
-    symbol_map_->insert( std::make_pair( "FPBG",   "~⊆⊇˜"  ) );
 }
 
 bool
 C_symbols::lookup( const std::string & steno, std::string & text, uint16_t & flags )
 {
-    // TODO
     // - Unique starter : SKWH
-    // - Symbol variants: FRPBLG
-    // - Attachment     : AO   
-    // - Capitalisation : *
-    // - Variant select : EU
-    // - Repetition     : TS (out of scope for Stenosys)
+    // - Everything after it indexes the symbol table
 
     text  = "";
     flags = 0; 
-   
-    // Check for unique starter
-    if ( steno.find( PUNCTUATION_STARTER ) == std::string::npos )
-    {
-        return false;
-    }
-
-    // Steno order: STKPWHRAO*EUFRPBLGTSDZ
 
-    C_utf8 variants;
+    chord_type chord = 0;
 
-    if ( ! get_symbols( steno, variants ) )
+    // Check for unique starter
+    if ( ( ! chord_parse( steno.c_str(), chord ) ) || ( ( chord & SYMBOL_STARTER_MASK ) != SYMBOL_STARTER ) )
     {
         return false;
     }
 
-    std::string variant = variants.at( get_symbol_variant( steno ) );
+    const S_symbol & symbol = symbol_table[ ( chord >> SYMBOL_INDEX_SHIFT ) & ( SYMBOL_TABLE_SIZE - 1 ) ];
 
-    int multiplier = get_multiplier( steno );
-    
-    while ( multiplier-- )
+    if ( ! symbol.valid )
     {
-        text += variant;
+        return false;
     }
 
-    set_flags( steno, flags );
+    text  = symbol.text;
+    flags = symbol.flags;
 
     return true;
 }
@@ -146,100 +223,6 @@ C_symbols::test( const std::string & steno
     }
 }
 
-bool
-C_symbols::get_symbols( const std::string & steno, C_utf8 & variants )
-{
-    // Extract symbol variant from steno string
-    size_t start = steno.find_first_of( PUNCTUATION_VARIANTS, STARTER_LEN );
-    size_t end   = steno.find_last_of( PUNCTUATION_VARIANTS );
-    
-    if ( ( start != std::string::npos ) && ( end != std::string::npos ) )
-    {
-        std::string variant_steno = steno.substr( start, end - start + 1 );
-    
-        // Look up variant
-        auto result = symbol_map_->find( variant_steno );
-
-        if ( ! ( result == symbol_map_->end() ) )
-        {
-            variants = result->second;
-        
-            return true;
-        }
-    }
-
-    return false;
-}
-
-int
-C_symbols::get_symbol_variant( const std::string & steno )
-{
-    // Find symbol variant
-    bool got_e = ( steno.find_first_of( "E", STARTER_LEN ) != std::string::npos );
-    bool got_u = ( steno.find_first_of( "U", STARTER_LEN ) != std::string::npos );
-
-    int variant_index = 0; 
-
-    if ( ( ! got_e ) && ( ! got_u ) )
-    {
-        variant_index = 0;
-    }
-    else if ( got_e && ( ! got_u ) )
-    {
-        variant_index = 1;
-    }
-    else if ( ( ! got_e ) && got_u )
-    {
-        variant_index = 2;
-    }
-    else
-    {
-        variant_index = 3;
-    }
-
-    return variant_index;
-}
-
-int
-C_symbols::get_multiplier( const std::string & steno )
-{
-    // Set multiplier value
-    int multiplier = 1;
-
-    if ( steno.find( "T", STARTER_LEN) != std::string::npos )
-    {
-        multiplier = ( steno.find( "S", STARTER_LEN ) != std::string::npos ) ? 4 : 3;
-    }
-    else
-    {
-        multiplier = ( steno.find( "S", STARTER_LEN ) != std::string::npos ) ? 2 : 1;
-    }
-
-    return multiplier;
-}
-    
-void
-C_symbols::set_flags( const std::string & steno, uint16_t & flags )
-{
-    // Set attachment and capitalisation flags as required
-    if ( steno.find( "*", STARTER_LEN ) != std::string::npos )
-    {
-        flags |= CAPITALISE_NEXT;
-    }
-
-    flags |= ( ATTACH_TO_PREVIOUS | ATTACH_TO_NEXT );
-
-    if ( steno.find( "A", STARTER_LEN ) != std::string::npos )
-    {
-        flags &= ( ~ATTACH_TO_PREVIOUS );
-    }
-
-    if ( steno.find( "O", STARTER_LEN ) != std::string::npos )
-    {
-        flags &= ( ~ATTACH_TO_NEXT );
-    }
-}
-
 S_test_entry
 C_symbols::test_entries[] = 
 {   // steno        expected_text expected_flags
@@ -1,12 +1,10 @@
 #pragma once
 
-#include "utf8.h"
 #include <cstdint>
 #include <string>
 #include <stdio.h>
 
-#include <memory>
-#include <unordered_map>
+#include "chord.h"
 
 //using namespace stenosys;
 
@@ -14,8 +12,12 @@ namespace stenosys
 {
 
 #define PUNCTUATION_STARTER  "SKWH"
-#define PUNCTUATION_VARIANTS "FRPBLG"
-#define STARTER_LEN          4
+#define SYMBOL_INDEX_SHIFT   8      // Symbol table index: chord bits A to -S (AO*EU-FRPBLGTS)
+#define SYMBOL_TABLE_SIZE    8192
+
+// The left-hand keys of a symbol stroke
+const chord_type SYMBOL_STARTER_MASK = KEY_S_ | KEY_T_ | KEY_K_ | KEY_P_ | KEY_W_ | KEY_H_ | KEY_R_;
+const chord_type SYMBOL_STARTER      = KEY_S_ | KEY_K_ | KEY_W_ | KEY_H_;
 
 struct S_test_entry
 {
@@ -24,6 +26,13 @@ struct S_test_entry
     uint16_t expected_flags;
 };
 
+struct S_symbol
+{
+    char     text[ 16 ];            // Up to four repeats of a symbol, nul-terminated
+    uint16_t flags;
+    bool     valid;
+};
+
 
 class C_symbols
 {
@@ -48,22 +57,8 @@ private:
         , const std::string & expected_text
         , uint16_t            expected_flags );
 
-    bool
-    get_symbols( const std::string & steno, C_utf8 & text );
-
-    int
-    get_symbol_variant( const std::string & steno );
-
-    int
-    get_multiplier( const std::string & steno );
-
-    void
-    set_flags( const std::string & steno, uint16_t & flags );
-
 private:
 
-    std::unique_ptr< std::unordered_map< std::string, std::string > > symbol_map_;
-
     static S_test_entry test_entries[];
 };
 
@@ -36,10 +36,15 @@ C_tcp_server::C_tcp_server()
     , running_( false )
     , new_connection_( false )
     , listener_( -1 )
-    , fds_count_( 1 )
+    , fds_count_( FDS_CLIENT )
 {
-    ip_buffer_ = std::make_unique< C_buffer< char, 2048 > >();
-    op_buffer_ = std::make_unique< C_buffer< char, 2048 > >();
+    for ( int ii = 0; ii < ( int ) ( sizeof( fds_ ) / sizeof( fds_[ 0 ] ) ); ii++ )
+    {
+        fds_[ ii ].fd = -1;
+    }
+
+    ip_buffer_ = std::make_unique< C_spsc_ring< char, 2048 > >();
+    op_buffer_ = std::make_unique< C_spsc_ring< char, 2048 > >();
 }
 
 C_tcp_server::~C_tcp_server()
@@ -111,12 +116,15 @@ C_tcp_server::initialise( int port, const char * banner )
         return false;
     }
 
-    // Set up the listening socket
+    // Set up the wakeup event and the listening socket
     memset( fds_, 0 , sizeof( fds_ ) ); 
 
-    fds_[ 0 ].fd     = listener_;
-    fds_[ 0 ].events = POLLIN;
-    fds_count_ = 1;
+    fds_[ FDS_WAKE ].fd         = op_buffer_->event_fd();
+    fds_[ FDS_WAKE ].events     = POLLIN;
+    fds_[ FDS_LISTENER ].fd     = listener_;
+    fds_[ FDS_LISTENER ].events = POLLIN;
+    fds_[ FDS_CLIENT ].fd       = -1;
+    fds_count_ = FDS_CLIENT;
 
     log_writeln_fmt( C_log::LL_INFO, "%s server listening on port %d", banner_.c_str(), port_ );
     return true;
@@ -134,6 +142,8 @@ void
 C_tcp_server::stop()
 {
     abort_ = true;
+    op_buffer_->notify();
+
     thread_await_exit();
 }
 
@@ -157,13 +167,13 @@ C_tcp_server::new_connection()
 bool
 C_tcp_server::put_text( const std::string & text )
 {
-    return op_buffer_->put_block( text.c_str(), text.length() );
+    return op_buffer_->put_n( text.c_str(), text.length() ) == ( int ) text.length();
 }
 
 bool
 C_tcp_server::put_char( char ch )
 {
-    return op_buffer_->put(ch );
+    return op_buffer_->put( ch );
 }
 
 bool
@@ -191,7 +201,7 @@ C_tcp_server::get_line( std::string & line, int max_length )
         }
         else 
         {
-            delay( 1 );
+            wait_input();
         }
     }
 
@@ -204,6 +214,18 @@ C_tcp_server::get_char( char & ch )
     return ip_buffer_->get( ch );
 }
 
+// Wait until there may be input: data has been received, a client has connected, or
+// the server has stopped. Call once get_char() has returned false; a new connection or
+// stop since then is seen here, as the flags are set before the input buffer is notified.
+void
+C_tcp_server::wait_input()
+{
+    if ( running_ && ( ! new_connection_ ) )
+    {
+        ip_buffer_->wait( -1 );
+    }
+}
+
 // -----------------------------------------------------------------------------------
 // Background thread code
 // -----------------------------------------------------------------------------------
@@ -218,16 +240,16 @@ C_tcp_server::thread_handler()
     while ( ! abort_ )
     {
         // Check whether we have a client connected and there is data to send
-        if ( ( fds_count_ == 2 ) && ( op_buffer_->count() > 0 ) )
+        if ( ( fds_count_ > FDS_CLIENT ) && ( op_buffer_->count() > 0 ) )
         {
             //log_writeln( C_log::LL_INFO, "got send data" );
 
             // Set event flag so we get notified next time poll() is called
-            fds_[ 1 ].events |= POLLOUT;
+            fds_[ FDS_CLIENT ].events |= POLLOUT;
         }
         
-        // Poll socket/s with a timeout of 100mS
-        rc = poll( fds_, fds_count_, 100 );
+        // Wait for socket activity, or to be woken to send data or stop
+        rc = poll( fds_, fds_count_, -1 );
 
         //log_writeln_fmt( C_log::LL_INFO, "Return from poll() %d", rc );
         
@@ -237,12 +259,6 @@ C_tcp_server::thread_handler()
             break;
         }
 
-        if ( rc == 0 )
-        {
-            // Poll timed out. Check for abort and carry on.
-            continue;
-        }
-
         // fds_count_ may increase if there's an incoming connection, but we must not
         // include a new entry into the event checks loop until poll() above has been called.
         int fds_count_curr = fds_count_;
@@ -255,9 +271,15 @@ C_tcp_server::thread_handler()
             {
                 continue;
             }
+
+            if ( fds_idx == FDS_WAKE )
+            {
+                // Queued output is picked up and abort_ checked at the top of the loop
+                op_buffer_->wait( 0 );
+                continue;
+            }
             
-            char ch     = '\0';
-            int  send_len = 0;
+            int send_len = 0;
 
             if ( fds_[ fds_idx ].revents & POLLIN )
             { 
@@ -285,7 +307,7 @@ C_tcp_server::thread_handler()
                         }
 
                         // If we already have one connection made, reject this new connection
-                        if  ( fds_count_ >= 2 )
+                        if  ( fds_count_ > FDS_CLIENT )
                         {
                             close( new_client );
 
@@ -313,6 +335,7 @@ C_tcp_server::thread_handler()
                         fds_count_++;              
 
                         new_connection_ = true;
+                        ip_buffer_->notify();
 
                     } while ( new_client != -1 );
                 }
@@ -360,10 +383,7 @@ C_tcp_server::thread_handler()
                             //log_writeln_fmt( C_log::LL_INFO, "Data received: %d bytes", len  );
 
                             // Put the received data into the ring buffer
-                            for ( int ii = 0; ii < len; ii++ )
-                            {
-                                ip_buffer_->put( buffer[ ii ] );
-                            }
+                            ip_buffer_->put_n( buffer, len );
                         }
                     }
 
@@ -382,20 +402,7 @@ C_tcp_server::thread_handler()
                 
                 char buffer[ 256 ];
 
-                send_len = 0;
-
-                for ( size_t ii = 0; ii < sizeof( buffer ); ii++ )
-                {
-                    if ( op_buffer_->get( ch ) )
-                    {
-                        buffer[ ii ] = ch;
-                        send_len++;
-                    }
-                    else
-                    {
-                        break;
-                    }
-                }
+                send_len = op_buffer_->get_n( buffer, sizeof( buffer ) );
 
                 //log_writeln_fmt( C_log::LL_INFO, "before send(), send_len: %d", send_len );
 
@@ -408,7 +415,7 @@ C_tcp_server::thread_handler()
         
                 // Clear event flag. NB: this is based on the assumption that all the data
                 // was successfully sent. Review TBD.
-                fds_[ 1 ].events &= ( ~POLLOUT );
+                fds_[ FDS_CLIENT ].events &= ( ~POLLOUT );
             }
             
             if ( fds_[ fds_idx ].revents & ( ~ ( POLLIN | POLLOUT ) ) )
@@ -423,12 +430,15 @@ C_tcp_server::thread_handler()
     log_writeln_fmt( C_log::LL_INFO, "Shutting down '%s' socket server thread", banner_.c_str() );
 
     running_ = false;
+    ip_buffer_->notify();
 }     
 
 void
 C_tcp_server::cleanup()
 {
-    for ( int ii = 0; ii < fds_count_; ii++ )
+    // fds_[ FDS_WAKE ] is the output ring's event descriptor, op_buffer_->event_fd(), which the
+    // ring owns, so it is not closed here
+    for ( int ii = FDS_LISTENER; ii < fds_count_; ii++ )
     {
         if ( fds_[ ii ].fd != -1 )
         {
@@ -437,7 +447,7 @@ C_tcp_server::cleanup()
         }
     }
     
-    fds_count_ = 1;
+    fds_count_ = FDS_CLIENT;
 }
 
 }
@@ -6,12 +6,17 @@
 #include <string>
 
 #include "mutex.h"
-#include "buffer.h"
+#include "spscring.h"
 #include "thread.h"
 
 namespace stenosys
 {
 
+// Entries in the poll() descriptor array
+#define FDS_WAKE     0      // Output buffer wakeup: output queued, or the server stopping
+#define FDS_LISTENER 1      // Listening socket
+#define FDS_CLIENT   2      // Connected client, if there is one
+
 class C_tcp_server : public C_thread
 {
 public:
@@ -46,6 +51,9 @@ public:
     bool
     get_char( char & ch );
 
+    void
+    wait_input();
+
 // Foreground
 private:
 
@@ -74,8 +82,8 @@ private:
 
     std::string banner_;
 
-    std::unique_ptr< C_buffer< char, 2048 > > ip_buffer_;
-    std::unique_ptr< C_buffer< char, 2048 > > op_buffer_;
+    std::unique_ptr< C_spsc_ring< char, 2048 > > ip_buffer_;
+    std::unique_ptr< C_spsc_ring< char, 2048 > > op_buffer_;
 
 };
 
@@ -0,0 +1,539 @@
+// transcriber.cpp
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <stdio.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "log.h"
+#include "lookupcache.h"
+#include "miscellaneous.h"
+#include "orthography.h"
+#include "retranslator.h"
+#include "strokefeed.h"
+#include "strokes.h"
+#include "transcriber.h"
+#include "translator.h"
+#include "userdict.h"
+
+
+using namespace stenosys;
+
+namespace stenosys
+{
+
+extern C_log             log;
+extern C_user_dictionary user_dictionary;
+
+C_transcriber::C_transcriber()
+    : jobs_( 0 )
+    , load_sec_( 0.0 )
+{
+    stroke_feed_  = std::make_unique< C_stroke_feed >();
+    retranslator_ = std::make_unique< C_retranslator >();
+    translator_   = std::make_unique< C_translator >( AT_LATIN );
+}
+
+C_transcriber::~C_transcriber()
+{
+}
+
+bool
+C_transcriber::initialise( const std::string & steno_path )
+{
+    auto start = std::chrono::steady_clock::now();
+
+    // No delay between strokes: run at full speed
+    if ( ! stroke_feed_->initialise( steno_path, 0 ) )
+    {
+        log_writeln_fmt( C_log::LL_ERROR, "Error loading stroke file %s", steno_path.c_str() );
+        return false;
+    }
+
+    std::string steno;
+
+    strokes_.clear();
+
+    while ( stroke_feed_->get_steno( steno ) )
+    {
+        strokes_.push_back( steno );
+    }
+
+    auto end = std::chrono::steady_clock::now();
+
+    load_sec_ = std::chrono::duration< double >( end - start ).count();
+
+    return translator_->initialise();
+}
+
+// jobs: number of translation threads, or 0 for one per CPU
+bool
+C_transcriber::run( unsigned int jobs )
+{
+    jobs_ = jobs;
+
+    auto start = std::chrono::steady_clock::now();
+
+    if ( ! translate_all() )
+    {
+        return false;
+    }
+
+    auto end = std::chrono::steady_clock::now();
+
+    report( std::chrono::duration< double >( end - start ).count() );
+
+    index();
+
+    return true;
+}
+
+// Translate the whole journal (in parallel) and rebuild the document from the output
+bool
+C_transcriber::translate_all()
+{
+    if ( ! retranslator_->retranslate( strokes_, jobs_ ) )
+    {
+        return false;
+    }
+
+    outputs_.swap( retranslator_->outputs() );
+    hashes_.swap( retranslator_->hashes() );
+
+    lengths_.resize( outputs_.size() );
+    lows_.resize( outputs_.size() );
+
+    document_.clear();
+
+    for ( size_t index = 0; index < outputs_.size(); index++ )
+    {
+        lows_[ index ]    = apply( outputs_[ index ], document_ );
+        lengths_[ index ] = document_.length();
+    }
+
+    return true;
+}
+
+// Add a runtime dictionary definition and bring the transcript up to date with it
+bool
+C_transcriber::define( const std::string & steno, const std::string & text )
+{
+    if ( ! user_dictionary.define( steno, text, "" ) )
+    {
+        return false;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    uint32_t retranslated = update( steno );
+
+    auto end = std::chrono::steady_clock::now();
+
+    log_writeln_fmt( C_log::LL_INFO, "Defined         : %s -> %s", steno.c_str(), text.c_str() );
+    log_writeln_fmt( C_log::LL_INFO, "Retranslated    : %u strokes", retranslated );
+    log_writeln_fmt( C_log::LL_INFO, "Update          : %.3f ms", std::chrono::duration< double, std::milli >( end - start ).count() );
+
+    return true;
+}
+
+// Write the transcribed text to a file, or to stdout if no path is given
+bool
+C_transcriber::write( const std::string & output_path )
+{
+    if ( output_path.length() == 0 )
+    {
+        fprintf( stdout, "%s\n", document_.c_str() );
+        return true;
+    }
+
+    FILE * output_stream = fopen( output_path.c_str(), "w" );
+
+    if ( output_stream == nullptr )
+    {
+        log_writeln_fmt( C_log::LL_ERROR, "Error accessing output file %s", output_path.c_str() );
+        return false;
+    }
+
+    fprintf( output_stream, "%s\n", document_.c_str() );
+    fclose( output_stream );
+
+    log_writeln_fmt( C_log::LL_INFO, "Transcript written to %s", output_path.c_str() );
+
+    return true;
+}
+
+// Apply translator output to a document. A backspace removes the last UTF-8 character;
+// anything else is appended. Returns the shortest length the document reached.
+size_t
+C_transcriber::apply( const std::string & output, std::string & document )
+{
+    size_t lowest = document.length();
+
+    for ( char ch : output )
+    {
+        if ( ch == '\b' )
+        {
+            // Remove any UTF-8 continuation bytes, then the lead byte
+            while ( ( document.length() > 0 ) && ( ( document.back() & 0xc0 ) == 0x80 ) )
+            {
+                document.pop_back();
+            }
+
+            if ( document.length() > 0 )
+            {
+                document.pop_back();
+            }
+
+            lowest = std::min( lowest, document.length() );
+        }
+        else
+        {
+            document += ch;
+        }
+    }
+
+    return lowest;
+}
+
+// Index the journal: the positions at which each chord occurs, and the mode strokes with
+// the modes they leave in effect
+void
+C_transcriber::index()
+{
+    positions_.clear();
+    mode_positions_.clear();
+    modes_.clear();
+
+    S_translator_modes modes = { AT_LATIN, SP_BEFORE, false };
+
+    for ( size_t index = 0; index < strokes_.size(); index++ )
+    {
+        positions_[ strokes_[ index ] ].push_back( index );
+
+        if ( C_translator::mode_stroke( strokes_[ index ] ) )
+        {
+            C_translator::track_mode( strokes_[ index ], modes );
+
+            mode_positions_.push_back( index );
+            modes_.push_back( modes );
+        }
+    }
+}
+
+// The modes in effect before the stroke at position
+S_translator_modes
+C_transcriber::modes_before( size_t position )
+{
+    auto it = std::lower_bound( mode_positions_.begin(), mode_positions_.end(), ( uint32_t ) position );
+
+    if ( it == mode_positions_.begin() )
+    {
+        S_translator_modes modes = { AT_LATIN, SP_BEFORE, false };
+
+        return modes;
+    }
+
+    return modes_[ ( it - mode_positions_.begin() ) - 1 ];
+}
+
+// Retranslate the parts of the journal affected by a change to the dictionary entry for
+// key, and splice the results into the document. A key can only change the translation
+// of a stroke whose lookback includes it, i.e. a stroke matching the key's last chord
+// which follows strokes matching the rest of it. Returns the number of strokes translated.
+uint32_t
+C_transcriber::update( const std::string & key )
+{
+    std::vector< std::string > chords;
+
+    size_t begin = 0;
+    size_t slash;
+
+    while ( ( slash = key.find( '/', begin ) ) != std::string::npos )
+    {
+        chords.push_back( key.substr( begin, slash - begin ) );
+        begin = slash + 1;
+    }
+
+    chords.push_back( key.substr( begin ) );
+
+    // The key is also looked up for strokes which add a suffix key to its last chord
+    std::vector< std::string > lasts( 1, chords.back() );
+
+    for ( const char * suffix = "GSDZ"; *suffix != '\0'; suffix++ )
+    {
+        std::string suffixed;
+
+        if ( C_orthography::unfold( chords.back(), *suffix, suffixed ) )
+        {
+            lasts.push_back( suffixed );
+        }
+    }
+
+    std::vector< uint32_t > candidates;
+
+    for ( const std::string & last : lasts )
+    {
+        auto it = positions_.find( last );
+
+        if ( it != positions_.end() )
+        {
+            candidates.insert( candidates.end(), it->second.begin(), it->second.end() );
+        }
+    }
+
+    if ( candidates.empty() )
+    {
+        return 0;
+    }
+
+    std::sort( candidates.begin(), candidates.end() );
+
+    std::vector< uint32_t > affected;
+
+    for ( uint32_t position : candidates )
+    {
+        if ( matches( position, chords ) )
+        {
+            affected.push_back( position );
+        }
+    }
+
+    if ( ( affected.size() * WINDOW_STROKES * C_retranslator::threads( jobs_ ) ) > strokes_.size() )
+    {
+        // The key is common enough that translating the whole journal in parallel is quicker
+        return translate_all() ? strokes_.size() : 0;
+    }
+
+    std::vector< std::pair< size_t, size_t > > spans;
+
+    uint32_t retranslated = 0;
+    size_t   next         = 0;      // First stroke not yet brought up to date
+
+    for ( uint32_t position : affected )
+    {
+        if ( position < next )
+        {
+            continue;
+        }
+
+        size_t last = retranslate_from( position );
+
+        spans.push_back( std::make_pair( ( size_t ) position, last ) );
+
+        retranslated += last - position + 1;
+        next          = last + 1;
+    }
+
+    if ( spans.size() > 0 )
+    {
+        splice( spans );
+    }
+
+    return retranslated;
+}
+
+// Check whether the strokes in the history at position match the key's chords, allowing
+// for undo strokes. Mode and other command strokes do not enter the history.
+bool
+C_transcriber::matches( size_t position, const std::vector< std::string > & chords )
+{
+    size_t index = position;
+
+    for ( size_t chord = chords.size() - 1; chord > 0; chord-- )
+    {
+        uint32_t undos = 0;
+        bool     found = false;
+
+        while ( ( index > 0 ) && ( ! found ) )
+        {
+            index--;
+
+            const std::string & steno = strokes_[ index ];
+
+            if ( steno[ 0 ] == '#' )
+            {
+                continue;
+            }
+            else if ( steno == "*" )
+            {
+                undos++;
+            }
+            else if ( undos > 0 )
+            {
+                undos--;
+            }
+            else
+            {
+                found = true;
+            }
+        }
+
+        if ( ( ! found ) || ( strokes_[ index ] != chords[ chord - 1 ] ) )
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Translate from position until the translator state agrees with that of the last run,
+// after which the remaining output is unchanged. Returns the last stroke translated.
+size_t
+C_transcriber::retranslate_from( size_t position )
+{
+    std::string output;
+
+    // Rebuild the translator state before position: modes, then the stroke history. The
+    // oldest stroke in the history was itself translated with a full history behind it,
+    // hence twice HISTORY_MAX. If the state still differs from the last run's, the history
+    // or the text it can reach goes back past the warm-up (e.g. after a run of undo
+    // strokes, or a space mode stroke), so warm up again from further back.
+    size_t span = 2 * HISTORY_MAX;
+
+    for ( ;; )
+    {
+        size_t warmup = ( position > span ) ? ( position - span ) : 0;
+
+        translator_->reset( modes_before( warmup ) );
+
+        for ( size_t index = warmup; index < position; index++ )
+        {
+            translator_->translate( strokes_[ index ], output );
+        }
+
+        if ( ( warmup == 0 ) || ( translator_->state_hash() == hashes_[ position - 1 ] ) )
+        {
+            break;
+        }
+
+        span *= 4;
+    }
+
+    size_t index = position;
+
+    for ( ; index < strokes_.size(); index++ )
+    {
+        translator_->translate( strokes_[ index ], outputs_[ index ] );
+
+        uint64_t hash   = translator_->state_hash();
+        bool     agreed = ( hash == hashes_[ index ] );
+
+        hashes_[ index ] = hash;
+
+        if ( agreed )
+        {
+            break;
+        }
+    }
+
+    return std::min( index, strokes_.size() - 1 );
+}
+
+// Splice the output of the retranslated spans into the document in a single pass. For
+// each span, replay starts after the last stroke before it that no later stroke backspaced
+// into, since the document up to that point is known, and runs to the first stroke from
+// the end of the span with the same property. The old document between replayed regions
+// is copied across unchanged.
+void
+C_transcriber::splice( const std::vector< std::pair< size_t, size_t > > & spans )
+{
+    size_t count = strokes_.size();
+
+    // Shortest the document gets from each stroke onwards
+    std::vector< uint32_t > floors( count + 1 );
+
+    floors[ count ] = UINT32_MAX;
+
+    for ( size_t index = count; index > 0; index-- )
+    {
+        floors[ index - 1 ] = std::min( floors[ index ], lows_[ index - 1 ] );
+    }
+
+    std::string document;
+
+    size_t   copied = 0;    // Old document copied (or replaced) up to here
+    size_t   next   = 0;    // First stroke not yet replayed or shifted
+    uint32_t delta  = 0;    // Change in document length so far (modulo 2^32)
+
+    for ( const auto & span : spans )
+    {
+        if ( span.second < next )
+        {
+            continue;       // Already replayed with the previous span
+        }
+
+        size_t from = std::max( span.first, next );
+        size_t to   = span.second;
+
+        while ( ( from > next ) && ( lengths_[ from - 1 ] > floors[ from ] ) )
+        {
+            from--;
+        }
+
+        while ( ( ( to + 1 ) < count ) && ( lengths_[ to ] > floors[ to + 1 ] ) )
+        {
+            to++;
+        }
+
+        if ( from > next )
+        {
+            size_t start = lengths_[ from - 1 ];
+
+            document.append( document_, copied, start - copied );
+            copied = start;
+
+            for ( size_t index = next; index < from; index++ )
+            {
+                lengths_[ index ] += delta;
+                lows_[ index ]    += delta;
+            }
+        }
+
+        size_t old_end = lengths_[ to ];
+
+        for ( size_t index = from; index <= to; index++ )
+        {
+            lows_[ index ]    = apply( outputs_[ index ], document );
+            lengths_[ index ] = document.length();
+        }
+
+        delta  = document.length() - old_end;
+        copied = old_end;
+        next   = to + 1;
+    }
+
+    document.append( document_, copied, std::string::npos );
+    document_.swap( document );
+
+    for ( size_t index = next; index < count; index++ )
+    {
+        lengths_[ index ] += delta;
+        lows_[ index ]    += delta;
+    }
+}
+
+void
+C_transcriber::report( double elapsed_sec )
+{
+    uint32_t stroke_count    = strokes_.size();
+    double   strokes_per_sec = ( elapsed_sec > 0.0 ) ? ( ( double ) stroke_count / elapsed_sec ) : 0.0;
+    double   overall_sec     = load_sec_ + elapsed_sec;
+    double   overall_rate    = ( overall_sec > 0.0 ) ? ( ( double ) stroke_count / overall_sec ) : 0.0;
+
+    log_writeln_fmt( C_log::LL_INFO, "Strokes         : %u", stroke_count );
+    log_writeln_fmt( C_log::LL_INFO, "Chunks          : %u", retranslator_->chunks() );
+    log_writeln_fmt( C_log::LL_INFO, "Resync strokes  : %u", retranslator_->resync_strokes() );
+    log_writeln_fmt( C_log::LL_INFO, "Load            : %.3f s", load_sec_ );
+    log_writeln_fmt( C_log::LL_INFO, "Elapsed         : %.3f s", elapsed_sec );
+    log_writeln_fmt( C_log::LL_INFO, "Strokes/sec     : %.0f", strokes_per_sec );
+    log_writeln_fmt( C_log::LL_INFO, "Overall         : %.0f strokes/sec, including the load", overall_rate );
+
+    C_lookup_cache::report( retranslator_->lookup_stats() );
+}
+
+}
@@ -0,0 +1,105 @@
+// transcriber.h
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "retranslator.h"
+#include "strokefeed.h"
+#include "strokes.h"
+#include "translator.h"
+
+namespace stenosys
+{
+
+// Headless batch transcription of a stroke file (.steno) at full speed. Strokes are run
+// through the translator and its output (backspaces plus text) is applied to an
+// in-memory document rather than being sent to the X Window system. Long stroke files
+// are split across threads by C_retranslator.
+//
+// The per-stroke output and translator state of the last run are kept, together with an
+// index of where each chord occurs, so that after a dictionary edit only the strokes the
+// edit affects need to be translated again.
+class C_transcriber
+{
+
+public:
+
+    C_transcriber();
+    ~C_transcriber();
+
+    bool
+    initialise( const std::string & steno_path );
+
+    bool
+    run( unsigned int jobs );
+
+    bool
+    define( const std::string & steno, const std::string & text );
+
+    bool
+    write( const std::string & output_path );
+
+    const std::string &
+    text() { return document_; }
+
+    static size_t
+    apply( const std::string & output, std::string & document );
+
+private:
+
+    void
+    report( double elapsed_sec );
+
+    void
+    index();
+
+    uint32_t
+    update( const std::string & key );
+
+    bool
+    matches( size_t position, const std::vector< std::string > & chords );
+
+    bool
+    translate_all();
+
+    S_translator_modes
+    modes_before( size_t position );
+
+    size_t
+    retranslate_from( size_t position );
+
+    void
+    splice( const std::vector< std::pair< size_t, size_t > > & spans );
+
+private:
+
+    std::string document_;
+
+    std::vector< std::string > strokes_;
+    std::vector< std::string > outputs_;        // Translator output for each stroke
+    std::vector< uint64_t >    hashes_;         // Translator state after each stroke
+    std::vector< uint32_t >    lengths_;        // Document length after each stroke
+    std::vector< uint32_t >    lows_;           // Shortest the document got during each stroke
+    std::vector< uint32_t >    mode_positions_; // Alphabet, space and paper tape mode strokes
+    std::vector< S_translator_modes > modes_;   // Modes in effect after each of them
+
+    unsigned int jobs_;                         // Translation threads for a full run
+    double       load_sec_;                     // Time taken to load the stroke file
+
+    std::unordered_map< std::string, std::vector< uint32_t > > positions_;  // Chord -> stroke positions
+
+    std::unique_ptr< C_stroke_feed >  stroke_feed_;
+    std::unique_ptr< C_retranslator > retranslator_;
+    std::unique_ptr< C_translator >   translator_;      // Retranslates the strokes an edit affects
+
+    // Rough cost of bringing the document up to date around one affected position, in
+    // strokes translated: the warm-up plus the strokes until the translator state agrees
+    static const size_t WINDOW_STROKES = 3 * HISTORY_MAX;
+};
+
+}
@@ -27,10 +27,12 @@ C_translator::C_translator( alphabet_type alphabet)
     : alphabet_( alphabet)
     , space_mode_( SP_BEFORE )
     , paper_tape_( false )
+    , keys_( nullptr )
 {
     symbols_    = std::make_unique< C_symbols >();
     strokes_    = std::make_unique< C_strokes >( *symbols_.get() );
     formatter_  = std::make_unique< C_formatter >();
+    shadow_     = std::make_unique< C_shadow >();
 }
 
 C_translator::~C_translator()
@@ -45,13 +47,42 @@ C_translator::initialise()
     return strokes_->initialise();
 }
 
+// Return to the state of a newly initialised translator in the given modes, keeping the
+// lookup cache. Used to translate a stretch of a stroke journal without replaying the mode
+// strokes before it.
+void
+C_translator::reset( const S_translator_modes & modes )
+{
+    alphabet_   = modes.alphabet;
+    space_mode_ = modes.space_mode;
+    paper_tape_ = modes.paper_tape;
+
+    formatter_->space_mode( space_mode_ );
+
+    strokes_->reset();
+    shadow_->reset();
+
+    group_.clear();
+    formatted_.clear();
+    keys_text_.clear();
+
+    keys_ = nullptr;
+}
+
 // Returns true if a translation was made
 void
 C_translator::translate( const S_geminipr_packet & steno_packet, std::string & output )
+{
+    translate( C_gemini_pr::decode( steno_packet ), output );
+}
+
+// Translate a stroke already in steno form (e.g. read from a stroke file)
+void
+C_translator::translate( const std::string & steno, std::string & output )
 {
     output.clear();
 
-    std::string steno = C_gemini_pr::decode( steno_packet );
+    keys_ = nullptr;
 
     if ( steno[ 0 ] == '#' )
     {
@@ -85,12 +116,101 @@ C_translator::translate( const S_geminipr_packet & steno_packet, std::string & o
     }
 }
 
+// Translate several strokes (e.g. a burst queued up by the steno keyboard) and return
+// their combined output as a single edit. Text that one stroke types and a later stroke
+// in the batch erases is never sent. paper_tape is set to whether paper tape was on after
+// each stroke.
+void
+C_translator::translate_batch( const std::vector< S_geminipr_packet > & steno_packets, std::string & output, std::vector< bool > & paper_tape )
+{
+    std::vector< std::string > stenos;
+
+    for ( const S_geminipr_packet & steno_packet : steno_packets )
+    {
+        stenos.push_back( C_gemini_pr::decode( steno_packet ) );
+    }
+
+    translate_batch( stenos, output, paper_tape );
+}
+
+void
+C_translator::translate_batch( const std::vector< std::string > & stenos, std::string & output, std::vector< bool > & paper_tape )
+{
+    paper_tape.clear();
+
+    if ( stenos.size() == 1 )
+    {
+        translate( stenos[ 0 ], output );
+        paper_tape.push_back( paper_tape_ );
+        return;
+    }
+
+    std::string stroke_output;
+
+    shadow_->mark();
+
+    for ( const std::string & steno : stenos )
+    {
+        translate( steno, stroke_output );
+        paper_tape.push_back( paper_tape_ );
+    }
+
+    output = shadow_->since_mark();
+}
+
 bool
 C_translator::paper_tape()
 {
     return paper_tape_;
 }
 
+// The keystrokes precompiled (by dictbuild) for the end of the last output: as much of it
+// as is the dictionary text of the last stroke, unchanged
+void
+C_translator::keystrokes( const std::string & output, S_keystrokes & keystrokes )
+{
+    C_keystrokes::match( output, keys_text_, keys_, keystrokes );
+}
+
+// Returns true if the stroke switches a translator mode (alphabet, spacing or paper tape)
+bool
+C_translator::mode_stroke( const std::string & steno )
+{
+    return ( steno == "#A" ) || ( steno == "#S" ) || ( steno == "#P" );
+}
+
+// Apply a stroke's effect on the modes (if any) to modes, as translating it would
+void
+C_translator::track_mode( const std::string & steno, S_translator_modes & modes )
+{
+    if ( steno == "#A" )
+    {
+        modes.alphabet = ( modes.alphabet == AT_LATIN ) ? AT_SHAVIAN : AT_LATIN;
+    }
+    else if ( steno == "#S" )
+    {
+        modes.space_mode = ( modes.space_mode == SP_BEFORE ) ? SP_AFTER : SP_BEFORE;
+    }
+    else if ( steno == "#P" )
+    {
+        modes.paper_tape = ! modes.paper_tape;
+    }
+}
+
+// Hash of the translator state: stroke history, modes and as much of the shadow text as
+// the history can reach back into. Used to find the point at which two translators fed
+// the same strokes from different starting points agree.
+uint64_t
+C_translator::state_hash()
+{
+    uint64_t modes = ( ( uint64_t ) alphabet_ << 16 ) | ( ( uint64_t ) space_mode_ << 8 ) | ( paper_tape_ ? 1 : 0 );
+
+    // Allow an extra character for a retracted space
+    uint64_t shadow = shadow_->hash( strokes_->reach() + 4 );
+
+    return strokes_->state_hash() ^ ( modes * 0x9e3779b97f4a7c15 ) ^ ( shadow * 0xff51afd7ed558ccd );
+}
+
 void
 C_translator::add_stroke( const std::string & steno, std::string & output )
 {
@@ -103,7 +223,12 @@ C_translator::add_stroke( const std::string & steno, std::string & output )
     if ( steno.find( PUNCTUATION_STARTER ) == std::string::npos  )
     {
         // Normal stroke
-        strokes_->add_stroke( steno, alphabet_, text, flags_curr, flags_prev, extends );
+        strokes_->add_stroke( steno, alphabet_, text, flags_curr, flags_prev, extends, keys_ );
+
+        if ( keys_ != nullptr )
+        {
+            keys_text_ = text;
+        }
     }
     else
     {
@@ -111,30 +236,30 @@ C_translator::add_stroke( const std::string & steno, std::string & output )
         strokes_->add_stroke( steno, text, flags_curr, flags_prev );
     }
 
-    std::string curr = formatter_->format( alphabet_, text, flags_curr, flags_prev, extends );
+    formatter_->format( alphabet_, text, flags_curr, flags_prev, extends, formatted_ );
+
+    strokes_->translation( formatted_ );
 
-    strokes_->translation( curr );
+    // The word replaces whatever the earlier strokes in it produced. The output is the
+    // minimal edit from the text on screen (as held by the shadow) to the new text.
+    strokes_->group( group_ );
 
-    std::string prev = strokes_->previous_translation();
+    // Case changes to the previous word apply to the Latin alphabet only
+    uint16_t format_last = ( alphabet_ == AT_LATIN ) ? ( flags_curr & FORMAT_LAST ) : 0;
 
-    output = formatter_->transition_to( prev, curr, flags_curr, flags_prev, extends, false );
+    output = shadow_->edit( group_
+                          , formatter_->retract_space( flags_prev, flags_curr )
+                          , format_last
+                          , formatted_
+                          , *strokes_->current() );
 }
 
 void
 C_translator::undo_stroke( std::string & output )
 {
-    std::string curr = strokes_->translation();
-
-    if ( curr.length() > 0 )
+    if ( strokes_->current()->steno().length() > 0 )
     {
-        std::string prev = strokes_->previous_translation();
-
-        bool extends = strokes_->extends();
-
-        uint16_t flags_curr = strokes_->flags();
-        uint16_t flags_prev = strokes_->flags_prev();
-
-        output = formatter_->transition_to( prev, curr, flags_curr, flags_prev, extends, true );
+        output = shadow_->undo( *strokes_->current() );
     }
 
     strokes_->undo();
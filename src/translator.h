@@ -4,11 +4,14 @@
 #include <algorithm>
 #include <string>
 #include <memory>
+#include <vector>
 
 #include "dictionary.h"
 #include "formatter.h"
 #include "geminipr.h"
 #include "history.h"
+#include "keystrokes.h"
+#include "shadow.h"
 #include "stenoflags.h"
 #include "strokes.h"
 #include "symbols.h"
@@ -18,6 +21,14 @@ using namespace stenosys;
 namespace stenosys
 {
 
+// The translator modes switched by mode strokes
+struct S_translator_modes
+{
+    alphabet_type alphabet;
+    space_type    space_mode;
+    bool          paper_tape;
+};
+
 class C_translator
 {
 
@@ -29,12 +40,39 @@ public:
     bool
     initialise();
 
+    void
+    reset( const S_translator_modes & modes );
+
     void 
     translate( const S_geminipr_packet & steno_packet, std::string & output );
 
+    void 
+    translate( const std::string & steno, std::string & output );
+
+    void
+    translate_batch( const std::vector< S_geminipr_packet > & steno_packets, std::string & output, std::vector< bool > & paper_tape );
+
+    void
+    translate_batch( const std::vector< std::string > & stenos, std::string & output, std::vector< bool > & paper_tape );
+
     bool
     paper_tape();
 
+    void
+    keystrokes( const std::string & output, S_keystrokes & keystrokes );
+
+    uint64_t
+    state_hash();
+
+    const S_lookup_stats &
+    lookup_stats() { return strokes_->lookup_stats(); }
+
+    static bool
+    mode_stroke( const std::string & steno );
+
+    static void
+    track_mode( const std::string & steno, S_translator_modes & modes );
+
 private:
     
     C_translator(){}
@@ -63,6 +101,13 @@ private:
     std::unique_ptr< C_symbols >    symbols_;
     std::unique_ptr< C_strokes >    strokes_;
     std::unique_ptr< C_formatter >  formatter_;
+    std::unique_ptr< C_shadow >     shadow_;
+
+    std::vector< C_stroke * >       group_;     // Earlier strokes of the current multi-stroke word
+    std::string                     formatted_; // Formatted text of the current stroke
+
+    std::string                     keys_text_; // Dictionary text of the last stroke translated
+    const char16_t *                keys_;      // and its keystroke program (nullptr: none)
 
 };
 
@@ -0,0 +1,104 @@
+// txbolt.cpp
+
+#include <string>
+
+#include "chord.h"
+#include "txbolt.h"
+
+
+using namespace stenosys;
+
+namespace stenosys
+{
+
+C_tx_bolt_protocol::C_tx_bolt_protocol()
+{
+    reset();
+}
+
+bool
+C_tx_bolt_protocol::decode( uint8_t byte, chord_type & chord )
+{
+    int  set      = byte >> 6;
+    bool complete = false;
+
+    if ( ( last_set_ >= 0 ) && ( ( byte == 0 ) || ( set <= last_set_ ) ) )
+    {
+        // The end of the chord, or the start of the next one
+        chord    = chord_;
+        complete = true;
+
+        reset();
+    }
+
+    if ( byte == 0 )
+    {
+        return complete;
+    }
+
+    for ( int bit = 0; bit < TX_BOLT_SET_KEYS; bit++ )
+    {
+        if ( byte & ( 1 << bit ) )
+        {
+            chord_ |= chord_key_number_last( ( set * TX_BOLT_SET_KEYS ) + bit );
+        }
+    }
+
+    last_set_ = set;
+
+    if ( ( set == TX_BOLT_SETS - 1 ) && ( ! complete ) )
+    {
+        // Nothing can follow the last set
+        chord = chord_;
+        reset();
+
+        return true;
+    }
+
+    return complete;
+}
+
+bool
+C_tx_bolt_protocol::end_of_input( chord_type & chord )
+{
+    if ( last_set_ < 0 )
+    {
+        return false;
+    }
+
+    chord = chord_;
+    reset();
+
+    return true;
+}
+
+void
+C_tx_bolt_protocol::reset()
+{
+    chord_    = 0;
+    last_set_ = -1;
+}
+
+void
+C_tx_bolt_protocol::encode( chord_type chord, std::string & data )
+{
+    for ( int set = 0; set < TX_BOLT_SETS; set++ )
+    {
+        uint8_t byte = 0;
+
+        for ( int bit = 0; bit < TX_BOLT_SET_KEYS; bit++ )
+        {
+            if ( chord & chord_key_number_last( ( set * TX_BOLT_SET_KEYS ) + bit ) )
+            {
+                byte |= 1 << bit;
+            }
+        }
+
+        if ( byte != 0 )
+        {
+            data += ( char ) ( ( set << 6 ) | byte );
+        }
+    }
+}
+
+}
@@ -0,0 +1,61 @@
+// txbolt.h
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "chord.h"
+#include "stenoprotocol.h"
+
+namespace stenosys
+{
+
+#define TX_BOLT_SETS      4     // Key sets, one per byte
+#define TX_BOLT_SET_KEYS  6     // Keys per set (the last set has five)
+#define TX_BOLT_BYTE_MS   20    // Gap after which a stroke's bytes have all arrived
+
+// TX Bolt: one byte per set of keys with any held, in set order. The top two bits of a byte
+// are its set and the rest its keys:
+//
+//      set 0:  S- T- K- P- W- H-
+//      set 1:  R- A- O- *  -E -U
+//      set 2:  -F -R -P -B -L -G
+//      set 3:  -T -S -D -Z #
+//
+// Strokes have no end marker (some machines send a zero byte), so as in Plover a stroke is
+// complete when the next one starts (a set which doesn't follow on from the last byte's),
+// at the last set, or when no more bytes arrive for a while: a machine sends a stroke's
+// bytes together, but they can still arrive split across reads.
+class C_tx_bolt_protocol : public C_steno_protocol
+{
+
+public:
+
+    C_tx_bolt_protocol();
+    ~C_tx_bolt_protocol() {}
+
+    bool
+    decode( uint8_t byte, chord_type & chord );
+
+    bool
+    end_of_input( chord_type & chord );
+
+    unsigned int
+    byte_timeout_ms() { return TX_BOLT_BYTE_MS; }
+
+    bool
+    in_chord() { return last_set_ >= 0; }
+
+    void
+    reset();
+
+    void
+    encode( chord_type chord, std::string & data );
+
+private:
+
+    chord_type chord_;
+    int        last_set_;       // Set of the last byte of the chord being decoded (-1 if none)
+};
+
+}
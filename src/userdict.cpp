@@ -0,0 +1,97 @@
+// userdict.cpp
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+
+#include "cmdparser.h"
+#include "log.h"
+#include "userdict.h"
+
+
+using namespace stenosys;
+
+namespace stenosys
+{
+
+extern C_log log;
+
+C_user_dictionary user_dictionary;
+
+C_user_dictionary::C_user_dictionary()
+    : generation_( 0 )
+    , strokes_max_( 0 )
+{
+}
+
+C_user_dictionary::~C_user_dictionary()
+{
+}
+
+// Add or replace an entry. Commands may be written Plover-style in braces (e.g. {^}) or
+// with the dictionary's own delimiter.
+bool
+C_user_dictionary::define( const std::string & steno, const std::string & latin, const std::string & shavian )
+{
+    S_user_entry entry;
+
+    std::string latin_cmd   = latin;
+    std::string shavian_cmd = shavian;
+
+    std::replace( latin_cmd.begin(),   latin_cmd.end(),   '{', CMD_DELIMITER );
+    std::replace( latin_cmd.begin(),   latin_cmd.end(),   '}', CMD_DELIMITER );
+    std::replace( shavian_cmd.begin(), shavian_cmd.end(), '{', CMD_DELIMITER );
+    std::replace( shavian_cmd.begin(), shavian_cmd.end(), '}', CMD_DELIMITER );
+
+    C_cmd_parser parser;
+
+    entry.latin_flags   = 0;
+    entry.shavian_flags = 0;
+
+    if ( ! parser.parse( latin_cmd, entry.latin, entry.latin_flags ) )
+    {
+        log_writeln_fmt( C_log::LL_ERROR, "Invalid definition for %s: %s", steno.c_str(), latin.c_str() );
+        return false;
+    }
+
+    if ( ( shavian_cmd.length() > 0 ) && ( ! parser.parse( shavian_cmd, entry.shavian, entry.shavian_flags ) ) )
+    {
+        log_writeln_fmt( C_log::LL_ERROR, "Invalid Shavian definition for %s: %s", steno.c_str(), shavian.c_str() );
+        return false;
+    }
+
+    entries_[ steno ] = entry;
+
+    uint16_t strokes = std::count( steno.begin(), steno.end(), '/' ) + 1;
+
+    strokes_max_ = std::max( strokes_max_, strokes );
+
+    generation_++;
+
+    return true;
+}
+
+// Output: text and flags are only set if the entry is found
+bool
+C_user_dictionary::lookup( const std::string & steno
+                         , alphabet_type       alphabet
+                         , std::string &       text
+                         , uint16_t &          flags )
+{
+    auto it = entries_.find( steno );
+
+    if ( it == entries_.end() )
+    {
+        return false;
+    }
+
+    // As for the main dictionary, an empty Shavian entry falls back to the Latin one
+    bool shavian = ( alphabet == AT_SHAVIAN ) && ( it->second.shavian.length() > 0 );
+
+    text  = shavian ? it->second.shavian       : it->second.latin;
+    flags = shavian ? it->second.shavian_flags : it->second.latin_flags;
+
+    return true;
+}
+
+}
@@ -0,0 +1,59 @@
+// userdict.h
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+#include "stenoflags.h"
+
+namespace stenosys
+{
+
+// Runtime dictionary entries. These are consulted before the compiled-in dictionary, so a
+// definition made here adds to or overrides it without a rebuild.
+//
+// Entries are only changed while no translation is in progress.
+class C_user_dictionary
+{
+
+public:
+
+    C_user_dictionary();
+    ~C_user_dictionary();
+
+    bool
+    define( const std::string & steno, const std::string & latin, const std::string & shavian );
+
+    bool
+    lookup( const std::string & steno
+          , alphabet_type       alphabet
+          , std::string &       text
+          , uint16_t &          flags );
+
+    bool
+    empty() { return entries_.empty(); }
+
+    uint32_t
+    generation() { return generation_; }
+
+    uint16_t
+    strokes_max() { return strokes_max_; }
+
+private:
+
+    typedef struct
+    {
+        std::string latin;
+        std::string shavian;
+        uint16_t    latin_flags;
+        uint16_t    shavian_flags;
+    } S_user_entry;
+
+    std::unordered_map< std::string, S_user_entry > entries_;
+
+    uint32_t generation_;           // Incremented on every change, so caches can tell they are stale
+    uint16_t strokes_max_;          // Most strokes in any entry
+};
+
+}
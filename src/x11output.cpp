@@ -8,12 +8,14 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string>
+#include <string.h>
 
 #include <X11/X.h>
 #include <X11/Xatom.h>
 #include <X11/Xlib.h>
 
 #include "keyevent.h"
+#include "keystrokes.h"
 #include "log.h"
 #include "miscellaneous.h"
 #include "shaviankeysymdefs.h"
@@ -41,7 +43,11 @@ C_x11_output::C_x11_output()
     , orig_keysyms_per_keycode_( 0 )
     , orig_keycode_low_( 0 )
     , orig_keycode_high_( 0 )
+    , key_delay_ms_( 0 )
+    , keys_queued_( 0 )
 {
+    memset( keycodes_, 0, sizeof( keycodes_ ) );
+
     keysym_replacements_= std::make_unique< std::unordered_map< std::string, keysym_entry > >();
 }
 
@@ -73,6 +79,7 @@ C_x11_output::initialise()
     {
         set_up_data();
         backup_keysyms();
+        build_keycode_cache();
     }
 
     return display_ != NULL;
@@ -84,11 +91,23 @@ C_x11_output::initialise( const std::string & output_device )
     return false;
 }
 
+// Delay between the keys of a translation, for applications which drop keys sent too fast
+void
+C_x11_output::key_delay( unsigned int milliseconds )
+{
+    key_delay_ms_ = milliseconds;
+}
+
 void
 C_x11_output::set_keymapping()
 {
     restore_keysyms();
     set_shavian_keysyms();
+
+    // Let Xlib see the new mapping before the keycodes are looked up again
+    XSync( display_, False );
+    refresh_mapping();
+    build_keycode_cache();
 }
 
 void
@@ -103,64 +122,35 @@ C_x11_output::send( const std::string & str )
     //TEMP
     log_writeln_fmt( C_log::LL_VERBOSE_1, "C_x11_output::send() - str: %s", str.c_str() );
 
-    C_utf8 utf8_str( str );
-
-    uint32_t code = 0;
+    // The whole translation, backspaces included, is sent as one burst of key events
+    begin_output();
+    type( str );
+    end_output();
+}
 
-    if ( utf8_str.get_first( code ) )
+// Send a translation the end of which has been compiled into keystrokes (by dictbuild):
+// the start of it is typed a character at a time, and the keystrokes replayed for the rest
+void
+C_x11_output::send( const std::string & str, const S_keystrokes & keystrokes )
+{
+    if ( keystrokes.keys == nullptr )
     {
-        do
-        {
-            //TEMP
-            log_writeln_fmt( C_log::LL_VERBOSE_1, "  code: %04xh", code );
-        
-            if ( ( int ) code <= 0x7f )
-            {
-                keysym_entry * entry = &ascii_to_keysym[ ( int ) code ];
+        send( str );
+        return;
+    }
 
-                if ( entry->keysym1 != 0 )
-                {
-                    send_key( entry->keysym1, entry->keysym2 );
-                }
-            }
-            else
-            {
-                //TEMP
-                log_writeln_fmt( C_log::LL_VERBOSE_1, "is_shavian_code: %s", is_shavian_code( code ) ? "is shavian" : "is NOT shavian" );
-                
-                if ( is_shavian_code( code ) )
-                {
-                    //TEMP
-                    log_writeln( C_log::LL_VERBOSE_1, "is_shavian_code" );
-                
-                    if ( ( code == XK_namingdot ) || ( code == XK_acroring ) )
-                    {
-                        //TEMP
-                        log_writeln( C_log::LL_VERBOSE_1, "Naming dot or acroring" );
-                        
-                        KeySym keysym = to_keysym( code );
-        
-                        //TEMP
-                        log_writeln_fmt( C_log::LL_VERBOSE_1, "  keysym: %04xh, code: %04xh", keysym, code );
-                        
-                        send_key( keysym, 0 );
-                    }
-                    else
-                    {
-                        int index = code - XK_peep;
-
-                        keysym_entry * entry = &shavian_to_keysym[ index ];
-                        
-                        //TEMP
-                        log_writeln_fmt( C_log::LL_VERBOSE_1, "entry->keysym1: %04xh, entry->keysym2: %04xh", entry->keysym1 , entry->keysym2 );
- 
-                        send_key( to_keysym( entry->keysym1 ), entry->keysym2 );
-                    }
-                }
-            }
+    //TEMP
+    log_writeln_fmt( C_log::LL_VERBOSE_1, "C_x11_output::send() - str: %s, replayed from: %u", str.c_str(), ( unsigned int ) keystrokes.offset );
 
-        } while ( utf8_str.get_next( code ) );
+    begin_output();
+
+    if ( keystrokes.offset > 0 )
+    {
+        type( str.substr( 0, keystrokes.offset ) );
     }
+
+    replay( keystrokes.keys );
+    end_output();
 }
 
 void
@@ -224,10 +214,15 @@ C_x11_output::send( key_event_t key_event, uint8_t scancode )
 
     if ( keysym != 0 )
     {
-        KeyCode keycode = XKeysymToKeycode( display_, keysym );
+        if ( refresh_mapping() )
+        {
+            build_keycode_cache();
+        }
+
+        KeyCode keycode = keysym_to_keycode( keysym );
      
         //TEMP
-        log_writeln( C_log::LL_VERBOSE_1, "  After XKeysymToKeycode()" );
+        log_writeln( C_log::LL_VERBOSE_1, "  After keycode lookup" );
         log_writeln_fmt( C_log::LL_VERBOSE_1, "    keycode: %04xh", keycode );
         
         if ( keycode != 0 )
@@ -266,44 +261,185 @@ C_x11_output::stop()
 {
 }
 
+// Look up the keycode of every keysym stenosys sends, so that sending a key is an array
+// lookup rather than a search of the keymap. Lookups go through XKeysymToKeycode() so that
+// the keycodes chosen are the same as before.
 void
-C_x11_output::send_key( KeySym keysym, KeySym modsym )
+C_x11_output::build_keycode_cache()
+{
+    for ( KeySym keysym = 0x0000; keysym <= 0x00ff; keysym++ )
+    {
+        keycodes_[ KEYCODE_CACHE_LATIN1 + keysym ] = XKeysymToKeycode( display_, keysym );
+    }
+
+    for ( KeySym keysym = 0xff00; keysym <= 0xffff; keysym++ )
+    {
+        keycodes_[ KEYCODE_CACHE_FUNCTION + ( keysym - 0xff00 ) ] = XKeysymToKeycode( display_, keysym );
+    }
+
+    for ( KeySym code = XK_peep; code <= XK_yew; code++ )
+    {
+        keycodes_[ KEYCODE_CACHE_SHAVIAN + ( code - XK_peep ) ] = XKeysymToKeycode( display_, to_keysym( code ) );
+    }
+
+    keycodes_[ KEYCODE_CACHE_ACRORING ] = XKeysymToKeycode( display_, to_keysym( XK_acroring ) );
+
+    log_writeln( C_log::LL_VERBOSE_1, "Keycode cache built" );
+}
+
+// Handle the events that have arrived from the X server. The server sends every client a
+// MappingNotify when the keyboard mapping changes (ours, or e.g. setxkbmap's); Xlib's copy
+// of the mapping is refreshed, and the caller rebuilds the keycode cache.
+// returns: true if the keyboard mapping has changed
+bool
+C_x11_output::refresh_mapping()
+{
+    bool changed = false;
+
+    // Reads whatever the server has sent, without a round trip
+    while ( XEventsQueued( display_, QueuedAfterReading ) > 0 )
+    {
+        XEvent event;
+
+        XNextEvent( display_, &event );
+
+        if ( event.type == MappingNotify )
+        {
+            XRefreshKeyboardMapping( &event.xmapping );
+
+            if ( event.xmapping.request == MappingKeyboard )
+            {
+                changed = true;
+            }
+        }
+    }
+
+    if ( changed )
+    {
+        log_writeln( C_log::LL_INFO, "Keyboard mapping changed" );
+    }
+
+    return changed;
+}
+
+KeyCode
+C_x11_output::keysym_to_keycode( KeySym keysym )
+{
+    int index = C_keystrokes::keycode_cache_index( keysym );
+
+    // Otherwise not a keysym stenosys sends
+    return ( index >= 0 ) ? keycodes_[ index ] : XKeysymToKeycode( display_, keysym );
+}
+
+// Start a burst of fake key events. They are buffered by Xlib until end_output().
+void
+C_x11_output::begin_output()
+{
+    keys_queued_ = 0;
+
+    if ( refresh_mapping() )
+    {
+        build_keycode_cache();
+    }
+
+    XTestGrabControl( display_, True );
+}
+
+// Send the burst, with a single round trip to the X server
+void
+C_x11_output::end_output()
+{
+    XTestGrabControl( display_, False );
+    XSync( display_, False );
+}
+
+// Type text a character at a time (between begin_output() and end_output())
+void
+C_x11_output::type( const std::string & str )
 {
-    KeyCode keycode = 0;
+    C_utf8 utf8_str( str );
+
+    uint32_t code = 0;
+
+    if ( utf8_str.get_first( code ) )
+    {
+        do
+        {
+            //TEMP
+            log_writeln_fmt( C_log::LL_VERBOSE_1, "  code: %04xh", code );
+
+            keystroke_t keystroke = 0;
+
+            if ( C_keystrokes::keystroke( code, keystroke ) )
+            {
+                send_keystroke( keystroke );
+            }
+
+        } while ( utf8_str.get_next( code ) );
+    }
+}
+
+// Replay a keystroke program (between begin_output() and end_output())
+void
+C_x11_output::replay( const keystroke_t * keys )
+{
+    while ( *keys != 0 )
+    {
+        send_keystroke( *keys++ );
+    }
+}
+
+void
+C_x11_output::send_keystroke( keystroke_t keystroke )
+{
+    KeyCode keycode = keycodes_[ keystroke & KEYSTROKE_INDEX ];
     KeyCode modcode = 0;
 
-    keycode = XKeysymToKeycode( display_, keysym );
+    if ( keystroke & KEYSTROKE_SHIFT )
+    {
+        modcode = keycodes_[ KEYCODE_CACHE_FUNCTION + ( XK_Shift_L - 0xff00 ) ];
+    }
 
+    send_keycodes( keycode, modcode );
+}
 
-    log_writeln_fmt( C_log::LL_VERBOSE_1, "send_key()  keycode: %d", keycode );
+void
+C_x11_output::send_key( KeySym keysym, KeySym modsym )
+{
+    send_keycodes( keysym_to_keycode( keysym ), ( modsym != 0 ) ? keysym_to_keycode( modsym ) : 0 );
+}
 
+// Queue a key press and release, with the modifier key (if any) held down for it. Each key
+// after the first since begin_output() is delayed by the key delay, which the X server
+// applies, so the delay costs no round trips.
+void
+C_x11_output::send_keycodes( KeyCode keycode, KeyCode modcode )
+{
+    log_writeln_fmt( C_log::LL_VERBOSE_1, "send_keycodes()  keycode: %d", keycode );
 
     if ( keycode == 0 )
     {
         return;
     }
 
-    XTestGrabControl( display_, True );
+    unsigned long delay = ( keys_queued_++ > 0 ) ? key_delay_ms_ : 0;
 
     // Generate modkey press
-    if ( modsym != 0 )
+    if ( modcode != 0 )
     {
-        modcode = XKeysymToKeycode( display_, modsym );
-        XTestFakeKeyEvent( display_, modcode, True, 0 );
+        XTestFakeKeyEvent( display_, modcode, True, delay );
+        delay = 0;
     }
  
     // Generate regular key press and release
-    XTestFakeKeyEvent( display_, keycode, True, 0 );
+    XTestFakeKeyEvent( display_, keycode, True, delay );
     XTestFakeKeyEvent( display_, keycode, False, 0 ); 
  
     // Generate modkey release
-    if ( modsym != 0 )
+    if ( modcode != 0 )
     {
         XTestFakeKeyEvent( display_, modcode, False, 0 );
     }
- 
-    XSync( display_, False );
-    XTestGrabControl( display_, False );
 }
 
 void
@@ -314,14 +450,11 @@ C_x11_output::send_key( KeyCode keycode )
         return;
     }
 
-    XTestGrabControl( display_, True );
+    unsigned long delay = ( keys_queued_++ > 0 ) ? key_delay_ms_ : 0;
 
     // Generate regular key press and release
-    XTestFakeKeyEvent( display_, keycode, True, 0 );
+    XTestFakeKeyEvent( display_, keycode, True, delay );
     XTestFakeKeyEvent( display_, keycode, False, 0 ); 
- 
-    XSync( display_, False );
-    XTestGrabControl( display_, False );
 }
 
 void
@@ -585,193 +718,6 @@ C_x11_output::scancode_to_keysym[] =
 ,   0                           // KEY_COMPOSE               127
 };
 
-keysym_entry
-C_x11_output::ascii_to_keysym[] =
-{
-    { 0,               0          }     // 0000
-,   { 0,               0          }     // 0001
-,   { 0,               0          }     // 0002
-,   { 0,               0          }     // 0003
-,   { 0,               0          }     // 0004
-,   { 0,               0          }     // 0005
-,   { 0,               0          }     // 0006
-,   { 0,               0          }     // 0007
-,   { XK_BackSpace,    0          }     // 0008
-,   { XK_Tab,          0          }     // 0009
-,   { XK_Linefeed,     0          }     // 000a
-,   { XK_Clear,        0          }     // 000b
-,   { 0,               0          }     // 000c
-,   { XK_Return,       0          }     // 000d
-,   { 0,               0          }     // 000e
-,   { 0,               0          }     // 000f
-,   { 0,               0          }     // 0010
-,   { 0,               0          }     // 0011
-,   { 0,               0          }     // 0012
-,   { XK_Pause,        0          }     // 0013
-,   { XK_Scroll_Lock,  0          }     // 0014
-,   { XK_Sys_Req,      0          }     // 0015
-,   { 0,               0          }     // 0016
-,   { 0,               0          }     // 0017
-,   { 0,               0          }     // 0018
-,   { 0,               0          }     // 0019
-,   { 0,               0          }     // 001a
-,   { XK_Escape,       0          }     // 001b
-,   { 0,               0          }     // 00lc
-,   { 0,               0          }     // 00ld
-,   { 0,               0          }     // 00le
-,   { 0,               0          }     // 00lf
-,   { XK_space,        0          }     // 0020  /* U+0020 SPACE */
-,   { XK_exclam,       XK_Shift_L }     // 0021  /* U+0021 EXCLAMATION MARK */
-,   { XK_quotedbl,     XK_Shift_L }     // 0022  /* U+0022 QUOTATION MARK */
-,   { XK_numbersign,   0          }     // 0023  /* U+0023 NUMBER SIGN */
-,   { XK_dollar,       XK_Shift_L }     // 0024  /* U+0024 DOLLAR SIGN */
-,   { XK_percent,      XK_Shift_L }     // 0025  /* U+0025 PERCENT SIGN */
-,   { XK_ampersand,    XK_Shift_L }     // 0026  /* U+0026 AMPERSAND */
-,   { XK_apostrophe,   0          }     // 0027  /* U+0027 APOSTROPHE */
-,   { XK_parenleft,    XK_Shift_L }     // 0028  /* U+0028 LEFT PARENTHESIS */
-,   { XK_parenright,   XK_Shift_L }     // 0029  /* U+0029 RIGHT PARENTHESIS */
-,   { XK_asterisk,     XK_Shift_L }     // 002a  /* U+002A ASTERISK */
-,   { XK_plus,         XK_Shift_L }     // 002b  /* U+002B PLUS SIGN */
-,   { XK_comma,        0          }     // 002c  /* U+002C COMMA */
-,   { XK_minus,        0          }     // 002d  /* U+002D HYPHEN-MINUS */
-,   { XK_period,       0          }     // 002e  /* U+002E FULL STOP */
-,   { XK_slash,        0          }     // 002f  /* U+002F SOLIDUS */
-,   { XK_0,            0          }     // 0030  /* U+0030 DIGIT ZERO */
-,   { XK_1,            0          }     // 0031  /* U+0031 DIGIT ONE */
-,   { XK_2,            0          }     // 0032  /* U+0032 DIGIT TWO */
-,   { XK_3,            0          }     // 0033  /* U+0033 DIGIT THREE */
-,   { XK_4,            0          }     // 0034  /* U+0034 DIGIT FOUR */
-,   { XK_5,            0          }     // 0035  /* U+0035 DIGIT FIVE */
-,   { XK_6,            0          }     // 0036  /* U+0036 DIGIT SIX */
-,   { XK_7,            0          }     // 0037  /* U+0037 DIGIT SEVEN */
-,   { XK_8,            0          }     // 0038  /* U+0038 DIGIT EIGHT */
-,   { XK_9,            0          }     // 0039  /* U+0039 DIGIT NINE */
-,   { XK_colon,        XK_Shift_L }     // 003a  /* U+003A COLON */
-,   { XK_semicolon,    0          }     // 003b  /* U+003B SEMICOLON */
-,   { XK_less,         XK_Shift_L }     // 003c  /* U+003C LESS-THAN SIGN */
-,   { XK_equal,        0          }     // 003d  /* U+003D EQUALS SIGN */
-,   { XK_greater,      XK_Shift_L }     // 003e  /* U+003E GREATER-THAN SIGN */
-,   { XK_question,     XK_Shift_L }     // 003f  /* U+003F QUESTION MARK */
-,   { XK_at,           0          }     // 0040  /* U+0040 COMMERCIAL AT */
-,   { XK_A,            XK_Shift_L }     // 0041  /* U+0041 LATIN CAPITAL LETTER A */
-,   { XK_B,            XK_Shift_L }     // 0042  /* U+0042 LATIN CAPITAL LETTER B */
-,   { XK_C,            XK_Shift_L }     // 0043  /* U+0043 LATIN CAPITAL LETTER C */
-,   { XK_D,            XK_Shift_L }     // 0044  /* U+0044 LATIN CAPITAL LETTER D */
-,   { XK_E,            XK_Shift_L }     // 0045  /* U+0045 LATIN CAPITAL LETTER E */
-,   { XK_F,            XK_Shift_L }     // 0046  /* U+0046 LATIN CAPITAL LETTER F */
-,   { XK_G,            XK_Shift_L }     // 0047  /* U+0047 LATIN CAPITAL LETTER G */
-,   { XK_H,            XK_Shift_L }     // 0048  /* U+0048 LATIN CAPITAL LETTER H */
-,   { XK_I,            XK_Shift_L }     // 0049  /* U+0049 LATIN CAPITAL LETTER I */
-,   { XK_J,            XK_Shift_L }     // 004a  /* U+004A LATIN CAPITAL LETTER J */
-,   { XK_K,            XK_Shift_L }     // 004b  /* U+004B LATIN CAPITAL LETTER K */
-,   { XK_L,            XK_Shift_L }     // 004c  /* U+004C LATIN CAPITAL LETTER L */
-,   { XK_M,            XK_Shift_L }     // 004d  /* U+004D LATIN CAPITAL LETTER M */
-,   { XK_N,            XK_Shift_L }     // 004e  /* U+004E LATIN CAPITAL LETTER N */
-,   { XK_O,            XK_Shift_L }     // 004f  /* U+004F LATIN CAPITAL LETTER O */
-,   { XK_P,            XK_Shift_L }     // 0050  /* U+0050 LATIN CAPITAL LETTER P */
-,   { XK_Q,            XK_Shift_L }     // 0051  /* U+0051 LATIN CAPITAL LETTER Q */
-,   { XK_R,            XK_Shift_L }     // 0052  /* U+0052 LATIN CAPITAL LETTER R */
-,   { XK_S,            XK_Shift_L }     // 0053  /* U+0053 LATIN CAPITAL LETTER S */
-,   { XK_T,            XK_Shift_L }     // 0054  /* U+0054 LATIN CAPITAL LETTER T */
-,   { XK_U,            XK_Shift_L }     // 0055  /* U+0055 LATIN CAPITAL LETTER U */
-,   { XK_V,            XK_Shift_L }     // 0056  /* U+0056 LATIN CAPITAL LETTER V */
-,   { XK_W,            XK_Shift_L }     // 0057  /* U+0057 LATIN CAPITAL LETTER W */
-,   { XK_X,            XK_Shift_L }     // 0058  /* U+0058 LATIN CAPITAL LETTER X */
-,   { XK_Y,            XK_Shift_L }     // 0059  /* U+0059 LATIN CAPITAL LETTER Y */
-,   { XK_Z,            XK_Shift_L }     // 005a  /* U+005A LATIN CAPITAL LETTER Z */
-,   { XK_bracketleft,  0          }     // 005b  /* U+005B LEFT SQUARE BRACKET */
-,   { XK_backslash,    0          }     // 005c  /* U+005C REVERSE SOLIDUS */
-,   { XK_bracketright, 0          }     // 005d  /* U+005D RIGHT SQUARE BRACKET */
-,   { XK_asciicircum,  XK_Shift_L }     // 005e  /* U+005E CIRCUMFLEX ACCENT */
-,   { XK_underscore,   XK_Shift_L }     // 005f  /* U+005F LOW LINE */
-,   { XK_grave,        0          }     // 0060  /* U+0060 GRAVE ACCENT */
-,   { XK_a,            0          }     // 0061  /* U+0061 LATIN SMALL LETTER A */
-,   { XK_b,            0          }     // 0062  /* U+0062 LATIN SMALL LETTER B */
-,   { XK_c,            0          }     // 0063  /* U+0063 LATIN SMALL LETTER C */
-,   { XK_d,            0          }     // 0064  /* U+0064 LATIN SMALL LETTER D */
-,   { XK_e,            0          }     // 0065  /* U+0065 LATIN SMALL LETTER E */
-,   { XK_f,            0          }     // 0066  /* U+0066 LATIN SMALL LETTER F */
-,   { XK_g,            0          }     // 0067  /* U+0067 LATIN SMALL LETTER G */
-,   { XK_h,            0          }     // 0068  /* U+0068 LATIN SMALL LETTER H */
-,   { XK_i,            0          }     // 0069  /* U+0069 LATIN SMALL LETTER I */
-,   { XK_j,            0          }     // 006a  /* U+006A LATIN SMALL LETTER J */
-,   { XK_k,            0          }     // 006b  /* U+006B LATIN SMALL LETTER K */
-,   { XK_l,            0          }     // 006c  /* U+006C LATIN SMALL LETTER L */
-,   { XK_m,            0          }     // 006d  /* U+006D LATIN SMALL LETTER M */
-,   { XK_n,            0          }     // 006e  /* U+006E LATIN SMALL LETTER N */
-,   { XK_o,            0          }     // 006f  /* U+006F LATIN SMALL LETTER O */
-,   { XK_p,            0          }     // 0070  /* U+0070 LATIN SMALL LETTER P */
-,   { XK_q,            0          }     // 0071  /* U+0071 LATIN SMALL LETTER Q */
-,   { XK_r,            0          }     // 0072  /* U+0072 LATIN SMALL LETTER R */
-,   { XK_s,            0          }     // 0073  /* U+0073 LATIN SMALL LETTER S */
-,   { XK_t,            0          }     // 0074  /* U+0074 LATIN SMALL LETTER T */
-,   { XK_u,            0          }     // 0075  /* U+0075 LATIN SMALL LETTER U */
-,   { XK_v,            0          }     // 0076  /* U+0076 LATIN SMALL LETTER V */
-,   { XK_w,            0          }     // 0077  /* U+0077 LATIN SMALL LETTER W */
-,   { XK_x,            0          }     // 0078  /* U+0078 LATIN SMALL LETTER X */
-,   { XK_y,            0          }     // 0079  /* U+0079 LATIN SMALL LETTER Y */
-,   { XK_z,            0          }     // 007a  /* U+007A LATIN SMALL LETTER Z */
-,   { XK_braceleft,    0          }     // 007b  /* U+007B LEFT CURLY BRACKET */
-,   { XK_bar,          XK_Shift_L }     // 007c  /* U+007C VERTICAL LINE */
-,   { XK_braceright,   0          }     // 007d  /* U+007D RIGHT CURLY BRACKET */
-,   { XK_asciitilde,   XK_Shift_L }     // 007e  /* U+007E TILDE */
-};
-
-keysym_entry
-C_x11_output::shavian_to_keysym[] =
-{
-    { XK_peep,         0          }
-,   { XK_tot,          0          }
-,   { XK_kick,         0          }
-,   { XK_fee,          0          }
-,   { XK_thigh,        0          }
-,   { XK_so,           0          }
-,   { XK_sure,         0          }
-,   { XK_church,       0          }
-,   { XK_yea,          XK_Shift_L }
-,   { XK_hung,         0          }
-,   { XK_bib,          XK_Shift_L }
-,   { XK_dead,         XK_Shift_L }
-,   { XK_gag,          XK_Shift_L }
-,   { XK_vow,          XK_Shift_L }
-,   { XK_they,         XK_Shift_L }
-,   { XK_zoo,          XK_Shift_L }
-
-,   { XK_measure,      XK_Shift_L }
-,   { XK_judge,        XK_Shift_L }
-,   { XK_woe,          0          }
-,   { XK_haha,         XK_Shift_L }
-,   { XK_loll,         0          }
-,   { XK_mime,         0          }
-,   { XK_if,           0          }
-,   { XK_egg,          0          }
-,   { XK_ash,          0          }
-,   { XK_ado,          0          }
-,   { XK_on,           0          }
-,   { XK_wool,         0          }
-,   { XK_out,          0          }
-,   { XK_ah,           0          }
-,   { XK_roar,         XK_Shift_L }
-,   { XK_none,         XK_Shift_L }
-
-,   { XK_eat,          XK_Shift_L }
-,   { XK_age,          XK_Shift_L }
-,   { XK_ice,          XK_Shift_L }
-,   { XK_up,           XK_Shift_L }
-,   { XK_oak,          XK_Shift_L }
-,   { XK_ooze,         XK_Shift_L }
-,   { XK_oil,          XK_Shift_L }
-,   { XK_awe,          XK_Shift_L }
-,   { XK_are,          0          }
-,   { XK_or,           XK_Shift_L }
-,   { XK_air,          0          }
-,   { XK_urge,         XK_Shift_L }
-,   { XK_array,        0          }
-,   { XK_ear,          XK_Shift_L }
-,   { XK_ian,          0          }
-,   { XK_yew,          XK_Shift_L }
-};
-
 // Shavian keysyms in their unshifted form
 const KeySym
 C_x11_output::shavian_keysym[] =
@@ -908,6 +854,8 @@ C_x11_output::test()
 
     uint32_t code;
 
+    begin_output();
+
     if ( shav_test.get_first( code ) )
     {
         do
@@ -950,6 +898,8 @@ C_x11_output::test()
     send_key( XK_exclam, XK_Shift_L );      // gives '1'
     send_key( XK_quotedbl, XK_Shift_L );
     send_key( XK_Return, 0 );
+
+    end_output();
 #endif
 }
 
@@ -15,6 +15,7 @@
 #include <vector>
 
 #include "keyevent.h"
+#include "keystrokes.h"
 
 namespace stenosys
 {
@@ -23,40 +24,6 @@ namespace stenosys
 #define is_shift( x )       ( ( ( x ) == XK_Shift_L ) || ( x == XK_Shift_R ) )
 #define is_shavian_key( x ) ( ( XK_A <= ( x ) ) && ( x <= XK_Z ) )
 
-#define is_shavian_code( x ) ( ( ( XK_peep <= ( x ) ) && ( x <= XK_yew ) ) || \
-                               ( x == XK_namingdot ) || \
-                               ( x == XK_acroring  ) )
-
-// From keysymdef.h:
-// "For any future extension of the keysyms with characters already
-//  found in ISO 10646 / Unicode, the following algorithm shall be
-//  used. The new keysym code position will simply be the character's
-//  Unicode number plus 0x01000000. The keysym values in the range
-//  0x01000100 to 0x0110ffff are reserved to represent Unicode"
-//
-// 0x10450 is the base value of the Shavian code block
-
-#define to_keysym( x ) ( ( ( ( x ) >= XK_peep ) || ( ( x ) == XK_acroring ) ) ? ( ( x ) + 0x1000000 ) : x )
-
-
-struct keysym_entry
-{
-    keysym_entry()
-    {
-        keysym1 = 0;
-        keysym2 = 0;
-    }
-    
-    keysym_entry( KeySym ks1, KeySym ks2 )
-    {
-        keysym1 = ks1;
-        keysym2 = ks2;
-    }
-
-    KeySym keysym1;
-    KeySym keysym2;
-};
-
 class C_x11_output
 {
 
@@ -74,6 +41,9 @@ public:
     virtual void
     send( const std::string & str );
 
+    virtual void
+    send( const std::string & str, const S_keystrokes & keystrokes );
+
     virtual void
     send( key_event_t key_event, uint8_t scancode );
 
@@ -86,6 +56,9 @@ public:
     void
     set_keymapping();
 
+    void
+    key_delay( unsigned int milliseconds );
+
 private:
 
     void
@@ -100,9 +73,36 @@ private:
     void
     restore_keysyms();
 
+    void
+    build_keycode_cache();
+
+    bool
+    refresh_mapping();
+
+    KeyCode
+    keysym_to_keycode( KeySym keysym );
+
+    void
+    begin_output();
+
+    void
+    end_output();
+
+    void
+    type( const std::string & str );
+
+    void
+    replay( const keystroke_t * keys );
+
+    void
+    send_keystroke( keystroke_t keystroke );
+
     void 
     send_key( KeySym keysym, KeySym modsym );
 
+    void
+    send_keycodes( KeyCode keycode, KeyCode modcode );
+
     void
     send_key( KeyCode keycode );
     
@@ -139,15 +139,17 @@ private:
     int orig_keysyms_per_keycode_;
     int orig_keycode_low_;
     int orig_keycode_high_;
+
+    unsigned int key_delay_ms_;     // Delay before each key of a translation but the first
+    unsigned int keys_queued_;      // Keys queued since begin_output()
+
+    KeyCode keycodes_[ KEYCODE_CACHE_SIZE ];    // Keycode of each keysym sent (0: none)
     
     std::unique_ptr< std::unordered_map< std::string, keysym_entry > > keysym_replacements_;
     
     std::vector< std::string > symstrings_;
     
 
-    static keysym_entry ascii_to_keysym[];
-    static keysym_entry shavian_to_keysym[];
-
     static keysym_entry ascii_to_shavian_keysym[];
     static const char * XF86_symstrings[];
     static KeySym       scancode_to_keysym[];